@@ -21,11 +21,12 @@
 #include <ew/transform.h>
 #include <ew/cameraController.h>
 #include <ew/texture.h>
+#include <ew/glResource.h>
 #include <iostream>
 
 
-void render(ew::Shader shader, ew::Model model, GLuint texture, float time);
-void shadowPass(ew::Shader shadowPass, ew::Model model);
+void render(const ew::Shader& shader, const ew::Model& model, GLuint texture, float time);
+void shadowPass(const ew::Shader& shadowPass, const ew::Model& model);
 void calculateCascadeSplits();
 std::vector<glm::mat4> calculateLightSpaceMatrices();
 glm::mat4 calculateLightSpaceWithTexelSnapping(glm::mat4 lightView, glm::vec3 center, float texelSize);
@@ -108,27 +109,25 @@ struct ViewFrustumSettings
 
 struct DepthBuffer
 {
-	GLuint fbo;
-	GLuint depthTextures[MAX_CASCADES];
+	ew::Framebuffer fbo;
+	ew::Texture depthTextures[MAX_CASCADES];
 
 	float width;
 	float height;
 
 	void Initialize(float dWidth, float dHeight)
 	{
-		glGenFramebuffers(1, &fbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		fbo = ew::Framebuffer::create();
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo.get());
 		{
 			width = dWidth;
 			height = dHeight;
 
-			//depth attachment
-			glGenTextures(MAX_CASCADES, depthTextures);
-
-			//for each cascade
+			//depth attachment for each cascade
 			for (int i = 0; i < MAX_CASCADES; i++) 
 			{
-				glBindTexture(GL_TEXTURE_2D, depthTextures[i]);
+				depthTextures[i] = ew::Texture::create();
+				glBindTexture(GL_TEXTURE_2D, depthTextures[i].get());
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, dWidth, dHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -139,7 +138,7 @@ struct DepthBuffer
 			}
 
 			//attach first texture for initial completeness check
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTextures[0], 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTextures[0].get(), 0);
 
 			GLenum fboStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 			if (fboStatus != GL_FRAMEBUFFER_COMPLETE)
@@ -150,10 +149,13 @@ struct DepthBuffer
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
-	void Cleanup() const
+	void Cleanup()
 	{
-		glDeleteTextures(MAX_CASCADES, depthTextures);
-		glDeleteFramebuffers(1, &fbo);
+		for (int i = 0; i < MAX_CASCADES; i++)
+		{
+			depthTextures[i].reset();
+		}
+		fbo.reset();
 	}
 
 }depthBuffer;
@@ -173,8 +175,8 @@ int main()
 	ew::Shader shadow_pass = ew::Shader("assets/shadow_pass.vert", "assets/shadow_pass.frag");
 
 	//model + texture
-	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
+	ew::Model monkeyModel = ew::Model("assets/suzanne.obj", true);
+	ew::Texture brickTexture = ew::loadTexture("assets/brick_color.jpg");
 
 	//init stuff
 	initCamera();
@@ -196,7 +198,7 @@ int main()
 
 		shadowPass(shadow_pass, monkeyModel);
 
-		render(blinnPhongShader, monkeyModel, brickTexture, time);
+		render(blinnPhongShader, monkeyModel, brickTexture.get(), time);
 
 		cameraController.move(window, &camera, deltaTime);
 
@@ -210,7 +212,7 @@ int main()
 	printf("Shutting down...");
 }
 
-void render(ew::Shader shader, ew::Model model, GLuint texture, float time)
+void render(const ew::Shader& shader, const ew::Model& model, GLuint texture, float time)
 {
 	if (light.rotating)
 	{
@@ -238,7 +240,7 @@ void render(ew::Shader shader, ew::Model model, GLuint texture, float time)
 	for (int i = 0; i < debug.num_cascades; i++) 
 	{
 		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, depthBuffer.depthTextures[i]);
+		glBindTexture(GL_TEXTURE_2D, depthBuffer.depthTextures[i].get());
 	}
 
 	shader.use();
@@ -298,10 +300,10 @@ void render(ew::Shader shader, ew::Model model, GLuint texture, float time)
 	plane.draw();
 }
 
-void shadowPass(ew::Shader shadowPass, ew::Model model)
+void shadowPass(const ew::Shader& shadowPass, const ew::Model& model)
 {
 	//shadow pass
-	glBindFramebuffer(GL_FRAMEBUFFER, depthBuffer.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, depthBuffer.fbo.get());
 	{
 		//update light space matrices
 		lightSpaceMatrices = calculateLightSpaceMatrices(); 
@@ -322,7 +324,7 @@ void shadowPass(ew::Shader shadowPass, ew::Model model)
 		for (int i = 0; i < debug.num_cascades; i++) 
 		{
 			//attach texture
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthBuffer.depthTextures[i], 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthBuffer.depthTextures[i].get(), 0);
 
 			glViewport(0, 0, depthBuffer.width, depthBuffer.height);
 			glClear(GL_DEPTH_BUFFER_BIT);
@@ -332,11 +334,11 @@ void shadowPass(ew::Shader shadowPass, ew::Model model)
 
 			//close monkey
 			shadowPass.setMat4("_Model", glm::translate(glm::vec3(0.0f, -3.0f, 0.0f)));
-			model.draw();
+			model.drawDepth();
 			
 			//far monkey
 			shadowPass.setMat4("_Model", glm::translate(glm::vec3(0.0f, -3.0f, -20.0f)));
-			model.draw();
+			model.drawDepth();
 
 			//also render plane
 			//shadowPass.setMat4("_Model", glm::translate(glm::vec3(0.0f, -4.0f, 0.0f)));
@@ -555,7 +557,7 @@ void initCamera()
 
 void initDetails()
 {
-	plane.load(ew::createPlane(60.0f, 60.0f, 100));
+	plane.load(ew::createPlane(60.0f, 60.0f, 100), true);
 	light.position = glm::vec3(1.0f);
 	light.color = glm::vec3(0.5f, 0.5f, 0.5f);
 	light.rotating = false;
@@ -652,7 +654,7 @@ void drawUI() {
 		debug.cascade_to_view = selected_cascade;
 
 		//display chosen cascade shadow map
-		ImGui::Image((ImTextureID)(intptr_t)depthBuffer.depthTextures[debug.cascade_to_view], ImVec2(256, 256));
+		ImGui::Image((ImTextureID)(intptr_t)depthBuffer.depthTextures[debug.cascade_to_view].get(), ImVec2(256, 256));
 	}
 	ImGui::Separator();
 	if (ImGui::CollapsingHeader("Lighting"))
@@ -21,6 +21,8 @@
 #include <ew/transform.h>
 #include <ew/cameraController.h>
 #include <ew/texture.h>
+#include <ew/glResource.h>
+#include <ew/glState.h>
 #include <iostream>
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
@@ -33,8 +35,8 @@ void calculateLightSpaceMatrices();
 std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& proj, const glm::mat4& view);
 void calculateCascadeSplits();
 
-void render(ew::Shader shader, ew::Model model, GLuint texture, float time);
-void shadowPass(ew::Shader shadowPass, ew::Model model);
+void render(const ew::Shader& shader, const ew::Model& model, GLuint texture, float time);
+void shadowPass(const ew::Shader& shadowPass, const ew::Model& model);
 GLenum glCheckError_(const char* file, int line)
 {
 	GLenum errorCode;
@@ -68,6 +70,7 @@ ew::Camera camera;	//our camera
 ew::CameraController cameraController;
 ew::Transform monkeyTransform;
 ew::Mesh plane;
+ew::GLState& glState = ew::GLState::get(); //skips state changes that are already in place
 static glm::vec4 light_orbit_radius = { 2.0f, 2.0f, -2.0f, 1.0f };
 
 struct Material
@@ -106,8 +109,8 @@ struct ViewFrustumSettings
 
 struct DepthBuffer
 {
-	GLuint fbo;
-	GLuint depthTexture;
+	ew::Framebuffer fbo;
+	ew::Texture depthTexture;
 
 	float width;
 	float height;
@@ -117,7 +120,7 @@ struct DepthBuffer
 	glm::mat4 lightViewProj[MAX_CASCADES];  // view-projection matrix for each cascade
 
 	//used for the IMGUI visiualization and nothing else
-	GLuint cascadeVisualizationTextures[MAX_CASCADES];
+	ew::Texture cascadeVisualizationTextures[MAX_CASCADES];
 
 	void Initialize(float dWidth, float dHeight)
 	{
@@ -125,8 +128,8 @@ struct DepthBuffer
 		height = dHeight;
 
 		//create depth texture array
-		glGenTextures(1, &depthTexture);
-		glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+		depthTexture = ew::Texture::create();
+		glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture.get());
 		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, dWidth, dHeight, MAX_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 
 		//texture parameters
@@ -138,7 +141,7 @@ struct DepthBuffer
 		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
 
 		//gen framebuffer
-		glGenFramebuffers(1, &fbo);
+		fbo = ew::Framebuffer::create();
 
 		//init cascade splits values
 		for (int i = 0; i < MAX_CASCADES; i++) 
@@ -153,10 +156,10 @@ struct DepthBuffer
 		//cascadeSplits[2] = 1.0f;   // third cascade covers the rest
 
        //seperate textures for IMGUI showing
-       glGenTextures(MAX_CASCADES, cascadeVisualizationTextures);
        for (int i = 0; i < MAX_CASCADES; i++) 
 	   {
-           glBindTexture(GL_TEXTURE_2D, cascadeVisualizationTextures[i]);
+           cascadeVisualizationTextures[i] = ew::Texture::create();
+           glBindTexture(GL_TEXTURE_2D, cascadeVisualizationTextures[i].get());
            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, dWidth, dHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -179,8 +182,8 @@ int main()
 	ew::Shader shadow_pass = ew::Shader("assets/shadow_pass.vert", "assets/shadow_pass.frag");
 
 	//model + texture
-	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
+	ew::Model monkeyModel = ew::Model("assets/suzanne.obj", true);
+	ew::Texture brickTexture = ew::loadTexture("assets/brick_color.jpg");
 
 	//init stuff
 	initCamera();
@@ -189,8 +192,11 @@ int main()
 
 	depthBuffer.Initialize(screenWidth, screenHeight);
 
+	glState.setEnabled(true);
+
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
+		glState.beginFrame();
 
 		float time = (float)glfwGetTime();
 		deltaTime = time - prevFrameTime;
@@ -198,7 +204,7 @@ int main()
 
 		shadowPass(shadow_pass, monkeyModel);
 
-		render(blinnPhongShader, monkeyModel, brickTexture, time);
+		render(blinnPhongShader, monkeyModel, brickTexture.get(), time);
 
 		cameraController.move(window, &camera, deltaTime);
 
@@ -231,13 +237,13 @@ void initCamera()
 
 void initDetails()
 {
-	plane.load(ew::createPlane(50.0f, 50.0f, 100));
+	plane.load(ew::createPlane(50.0f, 50.0f, 100), true);
 	light.position = glm::vec3(1.0f);
 	light.color = glm::vec3(0.5f, 0.5f, 0.5f);
 	light.rotating = true;
 }
 
-void render(ew::Shader shader, ew::Model model, GLuint texture, float time)
+void render(const ew::Shader& shader, const ew::Model& model, GLuint texture, float time)
 {
 	if (light.rotating)
 	{
@@ -248,17 +254,15 @@ void render(ew::Shader shader, ew::Model model, GLuint texture, float time)
 	const auto camera_view_proj = camera.projectionMatrix() * camera.viewMatrix();
 
 	//render lighting
-	glViewport(0, 0, screenWidth, screenHeight);
+	glState.setViewport(0, 0, screenWidth, screenHeight);
 
 	glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glEnable(GL_DEPTH_TEST);
+	glState.setCullFace(true, ew::CullFace::BACK);
+	glState.setDepthTest(true);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, depthBuffer.depthTexture);
+	glState.bindTexture(0, depthBuffer.depthTexture.get(), GL_TEXTURE_2D_ARRAY);
 
 	shader.use();
 
@@ -311,35 +315,26 @@ void render(ew::Shader shader, ew::Model model, GLuint texture, float time)
 	plane.draw();
 }
 
-void shadowPass(ew::Shader shadowPass, ew::Model model)
+void shadowPass(const ew::Shader& shadowPass, const ew::Model& model)
 {
 	//calc all light view-projection matrices for cascades
 	//called every frame so splits will update as camera moves
 	calculateLightSpaceMatrices();
 
 	//enable depth testing
-	glEnable(GL_DEPTH_TEST);
+	glState.setDepthTest(true);
 
 	//cull facing if needed
-	if (debug.cull_front) 
-	{
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_FRONT);
-	}
-	else 
-	{
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-	}
+	glState.setCullFace(true, debug.cull_front ? ew::CullFace::FRONT : ew::CullFace::BACK);
 
 	//render depth for each cascade
 	for (unsigned int cascade = 0; cascade < debug.num_cascades; cascade++)
 	{
 		//bind framebuffer for this cascade
-		glBindFramebuffer(GL_FRAMEBUFFER, depthBuffer.fbo);
+		glState.bindFramebuffer(depthBuffer.fbo.get());
 
 		//attach layer of depth texture array to this framebuffer depth attachment
-		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthBuffer.depthTexture, 0, cascade);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthBuffer.depthTexture.get(), 0, cascade);
 
 		//disable draw buffer
 		glDrawBuffer(GL_NONE);
@@ -353,7 +348,7 @@ void shadowPass(ew::Shader shadowPass, ew::Model model)
 		}
 
 		//clear depth buffer
-		glViewport(0, 0, depthBuffer.width, depthBuffer.height);
+		glState.setViewport(0, 0, depthBuffer.width, depthBuffer.height);
 		glClear(GL_DEPTH_BUFFER_BIT);
 
 		//use shadow shader
@@ -361,21 +356,20 @@ void shadowPass(ew::Shader shadowPass, ew::Model model)
 		shadowPass.setMat4("_Model", glm::mat4(1.0f));
 		shadowPass.setMat4("_LightViewProjection", depthBuffer.lightViewProj[cascade]);
 
-		model.draw();
+		model.drawDepth();
 
 		shadowPass.setMat4("_Model", glm::translate(glm::vec3(0.0f, -2.0f, 0.0f)));
-		plane.draw();
+		plane.drawDepth();
 
 	    //after rendering copy the depth data to visualization texture for IMGUI
-        glBindTexture(GL_TEXTURE_2D, depthBuffer.cascadeVisualizationTextures[cascade]);
-        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, depthBuffer.width, depthBuffer.height);
+        glCopyTextureSubImage2D(depthBuffer.cascadeVisualizationTextures[cascade].get(), 0, 0, 0, 0, 0, depthBuffer.width, depthBuffer.height);
 	}
 
 	//reset framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState.bindFramebuffer(0);
 
 	//reset face culling
-	glCullFace(GL_BACK);
+	glState.setCullFace(true, ew::CullFace::BACK);
 }
 
 void calculateLightSpaceMatrices()
@@ -606,7 +600,18 @@ void drawUI() {
 		for (int i = 0; i < debug.num_cascades; i++) 
 		{
 			ImGui::Text("Cascade %d:", i);
-			ImGui::Image((ImTextureID)(intptr_t)depthBuffer.cascadeVisualizationTextures[i], ImVec2(256, 256));
+			ImGui::Image((ImTextureID)(intptr_t)depthBuffer.cascadeVisualizationTextures[i].get(), ImVec2(256, 256));
+		}
+	}
+	ImGui::Separator();
+	if (ImGui::CollapsingHeader("GL State"))
+	{
+		const ew::GLStateStats& glStats = glState.getLastFrameStats();
+		ImGui::Text("Calls issued: %d, elided: %d", glStats.issued, glStats.elided);
+		bool validate = glState.isValidating();
+		if (ImGui::Checkbox("Validate against glGet", &validate))
+		{
+			glState.setValidation(validate);
 		}
 	}
 	ImGui::Separator();
@@ -626,7 +631,7 @@ void drawUI() {
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	glState.setViewport(0, 0, width, height);
 	screenWidth = width;
 	screenHeight = height;
 	camera.aspectRatio = (float)screenWidth / screenHeight;
@@ -0,0 +1,83 @@
+#version 450 core
+
+// Compact terrain: each vertex is only a 16-bit height. Position and uv come from
+// gl_VertexID and the chunk's placement, the normal from the height texture.
+layout(location = 0) in float aHeight;
+
+out vec3 WorldPos;
+out vec3 Normal;
+out vec2 TexCoord;
+out vec4 FragPosLightSpace[8]; // For each cascade
+
+uniform mat4 _Model;
+uniform mat4 _ViewProjection;
+uniform mat4 _LightViewProjection[8]; // For each cascade
+uniform int cascade_count;
+uniform int enable_shadows;
+
+// Terrain
+uniform sampler2D _HeightmapTexture;
+uniform vec2 _MapSize;          // Samples along x and z
+uniform vec3 _TerrainScale;
+uniform int _ChunkSize;         // Quads along a chunk edge
+
+// Chunk
+uniform vec2 _ChunkOrigin;      // First sample covered by the chunk
+uniform int _ChunkStep;         // Sample stride
+uniform float _SkirtDepth;
+
+float heightAt(ivec2 texel)
+{
+    return texelFetch(_HeightmapTexture, texel, 0).r;
+}
+
+void main()
+{
+    // Grid vertices come first, then the four skirt edges: first row, last row, first column, last column
+    int side = _ChunkSize + 1;
+    int gridCount = side * side;
+    ivec2 cell;
+    float drop = 0.0;
+    if (gl_VertexID < gridCount)
+    {
+        cell = ivec2(gl_VertexID % side, gl_VertexID / side);
+    }
+    else
+    {
+        int edge = (gl_VertexID - gridCount) / side;
+        int k = (gl_VertexID - gridCount) % side;
+        cell = edge == 0 ? ivec2(k, 0)
+             : edge == 1 ? ivec2(k, side - 1)
+             : edge == 2 ? ivec2(0, k)
+             : ivec2(side - 1, k);
+        drop = _SkirtDepth;
+    }
+
+    // Chunks on the far edges repeat the last row and column of the map
+    ivec2 lastTexel = ivec2(_MapSize) - 1;
+    ivec2 texel = min(ivec2(_ChunkOrigin) + cell * _ChunkStep, lastTexel);
+    vec2 uv = vec2(texel) / vec2(lastTexel);
+    vec3 position = vec3((uv.x - 0.5) * _TerrainScale.x, aHeight * _TerrainScale.y - drop, (uv.y - 0.5) * _TerrainScale.z);
+
+    // Central differences at the chunk's own stride, one-sided along the map edges
+    ivec2 low = max(texel - _ChunkStep, ivec2(0));
+    ivec2 high = min(texel + _ChunkStep, lastTexel);
+    vec2 spacing = vec2(high - low) * _TerrainScale.xz / vec2(lastTexel);
+    float dhdx = (heightAt(ivec2(high.x, texel.y)) - heightAt(ivec2(low.x, texel.y))) * _TerrainScale.y / spacing.x;
+    float dhdz = (heightAt(ivec2(texel.x, high.y)) - heightAt(ivec2(texel.x, low.y))) * _TerrainScale.y / spacing.y;
+
+    WorldPos = vec3(_Model * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(_Model))) * normalize(vec3(-dhdx, 1.0, -dhdz));
+    TexCoord = uv;
+
+    // Calculate light space positions for shadow mapping
+    if (enable_shadows == 1)
+    {
+        for (int i = 0; i < cascade_count; i++)
+        {
+            FragPosLightSpace[i] = _LightViewProjection[i] * vec4(WorldPos, 1.0);
+        }
+    }
+
+    gl_Position = _ViewProjection * vec4(WorldPos, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 450
+
+//Vertex attributes
+layout(location = 0) in vec3 vPos;
+
+//Per-instance data, matches ew::InstanceData
+struct InstanceData
+{
+	mat4 model;
+	vec4 color;
+};
+layout(std430, binding = 0) readonly buffer Instances
+{
+	InstanceData _Instances[];
+};
+
+//uniforms
+uniform mat4 _LightViewProjection;
+
+void main()
+{
+	vec4 worldPos = _Instances[gl_InstanceID].model * vec4(vPos, 1.0);
+	gl_Position = _LightViewProjection * worldPos;
+}
@@ -22,11 +22,23 @@
 #include <ew/cameraController.h>
 #include <ew/texture.h>
 #include <ew/mesh.h>
+#include <ew/glResource.h>
+#include <ew/instanceBuffer.h>
+#include <ew/glState.h>
+#include <ew/culling.h>
+#include <ew/aabbTree.h>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <functional>
+#include <memory>
 
 #include "dh/heightMap.h"
+#include "dh/heightmapImage.h"
+#include "dh/filters.h"
+#include "dh/terrain.h"
+#include "dh/terrainCache.h"
+#include "dh/backgroundBuilder.h"
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
@@ -34,16 +46,16 @@ void drawUI();
 void initCamera();
 void definePipeline();
 void initDetails();
-void initMonkeys();
+void initMonkeys(const ew::Model& monkeyModel);
 void calculateLightSpaceMatrices();
 std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& proj, const glm::mat4& view);
 void calculateCascadeSplits();
 void loadSelectedHeightmap();
-std::vector<float> blurHeightmapData(const std::vector<float>& data, int width, int height, int radius);
 
-void renderHeightmap(ew::Shader shader, ew::Model model, float time);
-void renderMonkeys(ew::Shader shader, float time, GLuint brickTexture, ew::Model monkeyModel); 
-void shadowPass(ew::Shader shadowPass, ew::Model monkeyModel);
+void renderHeightmap(const ew::Shader& shader, const ew::Shader& compactShader, const ew::Model& model, float time);
+void setHeightmapUniforms(const ew::Shader& shader, const glm::mat4& viewProjection);
+void renderMonkeys(const ew::Shader& shader, float time, GLuint brickTexture, const ew::Model& monkeyModel); 
+void shadowPass(const ew::Shader& shadowPass, const ew::Model& monkeyModel);
 GLenum glCheckError_(const char* file, int line);
 
 #define glCheckError() glCheckError_(__FILE__, __LINE__) 
@@ -61,6 +73,9 @@ ew::Camera camera;
 ew::CameraController cameraController;
 ew::Mesh plane;
 
+// Skips state changes that are already in place, everything in the frame goes through it
+ew::GLState& glState = ew::GLState::get();
+
 // Available heightmaps
 struct HeightmapFile 
 {
@@ -72,7 +87,6 @@ struct HeightmapFile
 struct HeightmapSettings 
 {
     glm::vec3 scale = glm::vec3(100.0f, 20.0f, 100.0f);
-    GLuint texture = 0;
     bool wireframe = false;
     float ambientStrength = 0.3f;
     glm::vec3 lightDir = glm::normalize(glm::vec3(1.0f, -1.0f, 1.0f));
@@ -88,6 +102,9 @@ struct HeightmapSettings
     float specularStrength = 0.2f;
     bool useBlur = false;
     int blurRadius = 1;
+    float lodPixelError = 2.0f;
+    int chunkSize = 64;
+    bool compactVertices = true;
 } heightmapSettings;
 
 // Available heightmaps
@@ -99,11 +116,32 @@ std::vector<HeightmapFile> heightmapFiles =
     {"Breath Of The Wild", "assets/Textures/botw.jpg"}
 };
 
+// CPU side of a heightmap rebuild, made on the loader thread and uploaded on the GL thread
+// Terrain is built in normalized space, scale is applied through _Model so it never needs a rebuild.
+struct HeightmapBuild
+{
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int blurRadius = 0;                                         // 0 when the heights are unfiltered
+    std::shared_ptr<const dh::TerrainCache> cache;              // Reused while the path stays the same
+    std::shared_ptr<const std::vector<float>> filteredHeights;  // Reused while the blur stays the same too
+    dh::TerrainData terrain;
+};
+
+// Decodes, filters and meshes off the render loop. Newer requests cancel older ones.
+dh::BackgroundBuilder<HeightmapBuild> heightmapBuilder;
+// Height sources of the applied build, the next rebuild starts from them
+HeightmapBuild loadedHeightmap;
+bool buildHeightmap(const std::string& path, const HeightmapSettings& settings, const HeightmapBuild& previous, HeightmapBuild& build, const std::function<bool()>& isCancelled);
+void applyHeightmap(HeightmapBuild& build);
+
 // Current selected heightmap path
 std::string currentHeightmapPath = "assets/Textures/northamericaHeightMap.png";
 
-// Mesh and dimensions
-ew::Mesh heightmapMesh;
+// Terrain, height texture and dimensions
+dh::Terrain heightmapTerrain;
+ew::Texture heightmapTexture;
 int heightmapWidth = 0;
 int heightmapHeight = 0;
 
@@ -134,6 +172,17 @@ struct Monkey
 
 // Array of monkeys
 std::vector<Monkey> monkeys;
+// Monkey model matrices for instanced depth passes
+ew::InstanceBuffer monkeyInstances;
+// Meshlets that survived culling last frame, across all monkeys
+int monkeyMeshletsDrawn = 0;
+int monkeyMeshletsTotal = 0;
+// Monkeys by world bounds, the view and each cascade query it for the monkeys they draw.
+// Monkeys never move once placed, so their boxes need no margin.
+ew::AabbTree monkeyTree(0.0f);
+std::vector<unsigned int> monkeyQuery;
+int monkeysVisible = 0;
+int monkeyShadowDraws = 0;
 
 struct Debug 
 {
@@ -157,8 +206,8 @@ struct ViewFrustumSettings
 
 struct DepthBuffer 
 {
-    GLuint fbo;
-    GLuint depthTexture;
+    ew::Framebuffer fbo;
+    ew::Texture depthTexture;
 
     float width;
     float height;
@@ -168,7 +217,7 @@ struct DepthBuffer
     glm::mat4 lightViewProj[MAX_CASCADES];   // View-projection matrix for each cascade
 
     // Used for IMGUI visualization
-    GLuint cascadeVisualizationTextures[MAX_CASCADES];
+    ew::Texture cascadeVisualizationTextures[MAX_CASCADES];
 
     void Initialize(float dWidth, float dHeight) 
     {
@@ -176,8 +225,8 @@ struct DepthBuffer
         height = dHeight;
 
         // Create depth texture array
-        glGenTextures(1, &depthTexture);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+        depthTexture = ew::Texture::create();
+        glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture.get());
         glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, dWidth, dHeight, MAX_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 
         // Texture parameters
@@ -189,7 +238,7 @@ struct DepthBuffer
         glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
 
         // Gen framebuffer
-        glGenFramebuffers(1, &fbo);
+        fbo = ew::Framebuffer::create();
 
         // Init cascade splits values
         for (int i = 0; i < MAX_CASCADES; i++) 
@@ -199,11 +248,10 @@ struct DepthBuffer
         }
 
         // Separate textures for IMGUI visualization
-        glGenTextures(MAX_CASCADES, cascadeVisualizationTextures);
-
         for (int i = 0; i < MAX_CASCADES; i++) 
         {
-            glBindTexture(GL_TEXTURE_2D, cascadeVisualizationTextures[i]);
+            cascadeVisualizationTextures[i] = ew::Texture::create();
+            glBindTexture(GL_TEXTURE_2D, cascadeVisualizationTextures[i].get());
             glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, dWidth, dHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -222,11 +270,12 @@ int main()
 
     // Load shaders
     ew::Shader heightmapShader = ew::Shader("assets/Shaders/heightmap.vert", "assets/Shaders/heightmap.frag");
-    ew::Shader shadowPassShader = ew::Shader("assets/Shaders/shadow_pass.vert", "assets/Shaders/shadow_pass.frag");
+    ew::Shader heightmapCompactShader = ew::Shader("assets/Shaders/heightmap_compact.vert", "assets/Shaders/heightmap.frag");
+    ew::Shader shadowPassShader = ew::Shader("assets/Shaders/shadow_pass_instanced.vert", "assets/Shaders/shadow_pass.frag");
 
     //model + texture
-    ew::Model monkeyModel = ew::Model("assets/Models/suzanne.obj");
-    GLuint brickTexture = ew::loadTexture("assets/Textures/brick_color.jpg");
+    ew::Model monkeyModel = ew::Model("assets/Models/suzanne.obj", true);
+    ew::Texture brickTexture = ew::loadTexture("assets/Textures/brick_color.jpg");
 
     // Init camera and pipeline
     initCamera();
@@ -236,21 +285,36 @@ int main()
     // Initialize shadow mapping
     depthBuffer.Initialize(screenWidth, screenHeight);
 
-    // Load initial heightmap
+    // Load initial heightmap, waiting for it since the monkeys are placed on it
     loadSelectedHeightmap();
+    HeightmapBuild initialBuild;
+    if (heightmapBuilder.wait(initialBuild))
+    {
+        applyHeightmap(initialBuild);
+    }
 
     // Init monkeys
-    initMonkeys();
+    initMonkeys(monkeyModel);
+
+    glState.setEnabled(true);
 
     // Main loop
     while (!glfwWindowShouldClose(window)) 
     {
         glfwPollEvents();
+        glState.beginFrame();
 
         float time = (float)glfwGetTime();
         deltaTime = time - prevFrameTime;
         prevFrameTime = time;
 
+        // Swap in a finished heightmap rebuild
+        HeightmapBuild finishedBuild;
+        if (heightmapBuilder.poll(finishedBuild))
+        {
+            applyHeightmap(finishedBuild);
+        }
+
         // Shadow pass (if enabled)
         if (debug.enable_shadows) 
         {
@@ -258,10 +322,10 @@ int main()
         }
 
         // Render scene with heightmap
-        renderHeightmap(heightmapShader, monkeyModel, time);
+        renderHeightmap(heightmapShader, heightmapCompactShader, monkeyModel, time);
 
         // Render monkeys
-        renderMonkeys(heightmapShader, time, brickTexture, monkeyModel);
+        renderMonkeys(heightmapShader, time, brickTexture.get(), monkeyModel);
 
         // Camera movement
         cameraController.move(window, &camera, deltaTime);
@@ -273,12 +337,6 @@ int main()
         glfwSwapBuffers(window);
     }
 
-    // Cleanup
-    glDeleteTextures(1, &heightmapSettings.texture);
-    glDeleteTextures(MAX_CASCADES, depthBuffer.cascadeVisualizationTextures);
-    glDeleteTextures(1, &depthBuffer.depthTexture);
-    glDeleteFramebuffers(1, &depthBuffer.fbo);
-
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -309,7 +367,7 @@ void initCamera()
 
 void initDetails()
 {
-    plane.load(ew::createPlane(50.0f, 50.0f, 100));
+    plane.load(ew::createPlane(50.0f, 50.0f, 100), true);
 	light.position = glm::vec3(0.0f, 50.0f, 5.0f);
 	light.color = glm::vec3(0.5f, 0.5f, 0.5f);
 	light.rotating = false;
@@ -324,10 +382,11 @@ void definePipeline()
     glClearColor(0.2f, 0.3f, 0.4f, 1.0f);
 }
 
-void initMonkeys() 
+void initMonkeys(const ew::Model& monkeyModel) 
 {
     // Clear any existing monkeys
     monkeys.clear();
+    monkeyTree.clear();
 
     // Create 4 monkeys at random positions
     for (int i = 0; i < 4; i++) 
@@ -350,118 +409,141 @@ void initMonkeys()
         // Random scale between 0.5 and 2.0
         monkey.scale = 0.5f + ((float)rand() / RAND_MAX) * 1.5f;
 
+        glm::vec3 boundsMin, boundsMax;
+        ew::transformBox(monkeyModel.getBoundsMin(), monkeyModel.getBoundsMax(),
+            glm::translate(glm::mat4(1.0f), monkey.position) * glm::scale(glm::vec3(monkey.scale)), boundsMin, boundsMax);
+        monkeyTree.insert(boundsMin, boundsMax, (unsigned int)monkeys.size());
+
         monkeys.push_back(monkey);
     }
 }
 
-std::vector<float> blurHeightmapData(const std::vector<float>& data, int width, int height, int radius) 
+bool buildHeightmap(const std::string& path, const HeightmapSettings& settings, const HeightmapBuild& previous, HeightmapBuild& build, const std::function<bool()>& isCancelled)
 {
-    std::vector<float> result(data.size(), 0.0f);
+    build.path = path;
+    build.blurRadius = settings.useBlur ? settings.blurRadius : 0;
 
-    for (int y = 0; y < height; ++y) 
+    // Only go back to disk for a different map
+    if (previous.cache && previous.path == path)
+    {
+        build.cache = previous.cache;
+    }
+    else
     {
-        for (int x = 0; x < width; ++x) 
+        // Map the preprocessed cache, building it from the image the first time or when the image changed
+        std::shared_ptr<dh::TerrainCache> cache = std::make_shared<dh::TerrainCache>();
+        if (!cache->open(path.c_str(), true))
         {
-            float sum = 0.0f;
-            int count = 0;
-            // Box blur kernel
-            for (int ky = -radius; ky <= radius; ++ky) 
+            dh::HeightmapImage image;
+            if (!image.load(path.c_str(), true))
             {
-                for (int kx = -radius; kx <= radius; ++kx) 
-                {
-                    int sx = x + kx;
-                    int sy = y + ky;
-
-                    // Check boundaries
-                    if (sx >= 0 && sx < width && sy >= 0 && sy < height) 
-                    {
-                        sum += data[sy * width + sx];
-                        count++;
-                    }
-                }
+                std::printf("ERROR: Failed to load height data\n");
+                return false;
+            }
+            if (!dh::TerrainCache::write(path.c_str(), image, true) || !cache->open(path.c_str(), true))
+            {
+                std::printf("ERROR: Failed to create terrain cache\n");
+                return false;
             }
-
-            // Average
-            result[y * width + x] = sum / count;
         }
+        build.cache = cache;
     }
-    return result;
-}
 
-void loadSelectedHeightmap() 
-{
-    // Update the current heightmap path
-    currentHeightmapPath = heightmapFiles[heightmapSettings.selectedHeightmap].path;
-    std::printf("\n==== Loading heightmap: %s ====\n", currentHeightmapPath.c_str());
+    build.width = build.cache->getWidth();
+    build.height = build.cache->getHeight();
+    std::printf("Dimensions: %dx%d\n", build.width, build.height);
 
-    // Clean up previous texture
-    if (heightmapSettings.texture) 
+    if (build.width < 16 || build.height < 16) 
     {
-        glDeleteTextures(1, &heightmapSettings.texture);
-        heightmapSettings.texture = 0;
+        std::printf("WARNING: Very small heightmap detected. Quality may be poor.\n");
     }
 
-    // First get dimensions
-    if (!dh::getHeightmapDimensions(currentHeightmapPath.c_str(), heightmapWidth, heightmapHeight)) 
+    // Blurring changes the heights, so it falls back to building from floats
+    if (build.blurRadius > 0) 
     {
-        std::printf("ERROR: Failed to get dimensions\n");
-        return;
+        if (previous.filteredHeights && previous.cache == build.cache && previous.blurRadius == build.blurRadius)
+        {
+            build.filteredHeights = previous.filteredHeights;
+        }
+        else
+        {
+            if (isCancelled())
+            {
+                return false;
+            }
+            std::printf("Applying blur with radius %d\n", build.blurRadius);
+            build.filteredHeights = std::make_shared<const std::vector<float>>(
+                dh::filters::boxBlur(build.cache->copyHeights(), build.width, build.height, build.blurRadius));
+        }
     }
 
-    std::printf("Dimensions: %dx%d\n", heightmapWidth, heightmapHeight);
-
-    // Check for extreme dimensions that might cause issues
-    if (heightmapWidth > 4096 || heightmapHeight > 4096) 
+    if (isCancelled())
     {
-        std::printf("WARNING: Very large heightmap detected. Performance may be impacted.\n");
+        return false;
     }
 
-    if (heightmapWidth < 16 || heightmapHeight < 16) 
-    {
-        std::printf("WARNING: Very small heightmap detected. Quality may be poor.\n");
-    }
+    dh::TerrainSettings terrainSettings;
+    terrainSettings.chunkSize = settings.chunkSize;
+    terrainSettings.pixelError = settings.lodPixelError;
+    terrainSettings.vertexFormat = settings.compactVertices ? dh::TerrainVertexFormat::COMPACT : dh::TerrainVertexFormat::FULL;
 
-    // Load the height data
-    std::vector<float> heightData = dh::loadHeightmapData(currentHeightmapPath.c_str(), true);
+    std::printf("Creating terrain chunks...\n");
+    build.terrain = build.filteredHeights
+        ? dh::createTerrainData(*build.filteredHeights, build.width, build.height, glm::vec3(1.0f), terrainSettings)
+        : dh::createTerrainData(*build.cache, glm::vec3(1.0f), terrainSettings);
+    return !build.terrain.nodes.empty();
+}
 
-    // Verify data
-    if (heightData.empty()) 
+void applyHeightmap(HeightmapBuild& build)
+{
+    // Swap in the new terrain, the old one kept drawing until now
+    std::printf("Uploading terrain...\n");
+    heightmapTerrain.load(build.terrain);
+    build.terrain = dh::TerrainData();
+
+    // The texture only changes with the heights
+    bool heightsChanged = build.cache != loadedHeightmap.cache || build.filteredHeights != loadedHeightmap.filteredHeights;
+    if (heightsChanged || !heightmapTexture)
     {
-        std::printf("ERROR: Failed to load height data\n");
-        return;
-    }
+        heightmapTexture.reset();
 
-    if (heightData.size() != (size_t)(heightmapWidth * heightmapHeight)) 
-    {
-        std::printf("ERROR: Data size mismatch! Expected: %d, Got: %zu\n",
-            heightmapWidth * heightmapHeight, heightData.size());
-        return;
-    }
+        std::printf("Uploading texture...\n");
+        heightmapTexture = build.filteredHeights
+            ? dh::createHeightTexture(*build.filteredHeights, build.width, build.height)
+            : build.cache->createTexture();    // Straight from the mapped 16-bit heights
 
-    // Apply blur if needed
-    if (heightmapSettings.useBlur && heightmapSettings.blurRadius > 0) 
-    {
-        std::printf("Applying blur with radius %d\n", heightmapSettings.blurRadius);
-        heightData = blurHeightmapData(heightData, heightmapWidth, heightmapHeight, heightmapSettings.blurRadius);
+        if (!heightmapTexture) 
+        {
+            std::printf("WARNING: Failed to load texture\n");
+        }
     }
 
-    // Create the mesh
-    std::printf("Creating mesh...\n");
-    heightmapMesh = dh::createHeightmapMesh(heightData, heightmapWidth, heightmapHeight, heightmapSettings.scale);
-
-    // Load the texture for visualization
-    std::printf("Loading texture...\n");
-    heightmapSettings.texture = ew::loadTexture(currentHeightmapPath.c_str());
+    currentHeightmapPath = build.path;
+    heightmapWidth = build.width;
+    heightmapHeight = build.height;
+    loadedHeightmap = std::move(build);
+    std::printf("Heightmap loaded successfully: %s\n", currentHeightmapPath.c_str());
+}
 
-    if (heightmapSettings.texture == 0) 
+void loadSelectedHeightmap() 
+{
+    // The worker gets its own copy of the settings and sources, the UI keeps editing the globals
+    std::string path = heightmapFiles[heightmapSettings.selectedHeightmap].path;
+    HeightmapSettings settings = heightmapSettings;
+    HeightmapBuild previous;
+    previous.path = loadedHeightmap.path;
+    previous.blurRadius = loadedHeightmap.blurRadius;
+    previous.cache = loadedHeightmap.cache;
+    previous.filteredHeights = loadedHeightmap.filteredHeights;
+    std::printf("\n==== Loading heightmap: %s ====\n", path.c_str());
+
+    heightmapBuilder.request([path, settings, previous](HeightmapBuild& build, const std::function<bool()>& isCancelled) 
     {
-        std::printf("WARNING: Failed to load texture\n");
-    }
-
-    std::printf("Heightmap loaded successfully\n");
+        return buildHeightmap(path, settings, previous, build, isCancelled);
+    });
 }
 
-void renderHeightmap(ew::Shader shader, ew::Model model, float time) 
+void renderHeightmap(const ew::Shader& shader, const ew::Shader& compactShader, const ew::Model& model, float time) 
 {
     // Update light position if rotating
     if (light.rotating)
@@ -478,37 +560,49 @@ void renderHeightmap(ew::Shader shader, ew::Model model, float time)
     const auto camera_view_proj = camera.projectionMatrix() * camera.viewMatrix();
 
     // Set viewport and clear buffers
-    glViewport(0, 0, screenWidth, screenHeight);
+    glState.setViewport(0, 0, screenWidth, screenHeight);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Set wireframe mode if enabled
-    if (heightmapSettings.wireframe) 
-    {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    }
-    else 
-    {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    }
+    glState.setPolygonMode(heightmapSettings.wireframe ? ew::PolygonMode::LINE : ew::PolygonMode::FILL);
 
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    glEnable(GL_DEPTH_TEST);
+    glState.setCullFace(true, ew::CullFace::BACK);
+    glState.setDepthTest(true);
 
     // Bind shadow map texture if shadows are enabled
     if (debug.enable_shadows) 
     {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, depthBuffer.depthTexture);
+        glState.bindTexture(1, depthBuffer.depthTexture.get(), GL_TEXTURE_2D_ARRAY);
     }
 
     // Bind heightmap texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, heightmapSettings.texture);
+    glState.bindTexture(0, heightmapTexture.get());
 
     // Use shader and set uniforms
     shader.use();
+    setHeightmapUniforms(shader, camera_view_proj);
 
+    model.draw();
+    const glm::mat4 terrainModel = glm::translate(glm::vec3(0.0f, -2.0f, 0.0f)) * glm::scale(heightmapSettings.scale);
+
+    // Compact terrain rebuilds its vertices in its own vertex shader, with the same fragment stage
+    const ew::Shader& terrainShader = heightmapTerrain.isCompact() ? compactShader : shader;
+    if (heightmapTerrain.isCompact())
+    {
+        terrainShader.use();
+        setHeightmapUniforms(terrainShader, camera_view_proj);
+    }
+    terrainShader.setMat4("_Model", terrainModel);
+
+    //plane.draw();
+    // Pick the visible chunks at the right LOD and draw them
+    heightmapTerrain.setPixelError(heightmapSettings.lodPixelError);
+    heightmapTerrain.select(camera, (float)screenHeight, terrainModel);
+    heightmapTerrain.draw(terrainShader);
+}
+
+void setHeightmapUniforms(const ew::Shader& shader, const glm::mat4& viewProjection)
+{
     // Textures
     shader.setInt("_HeightmapTexture", 0);
 
@@ -548,7 +642,7 @@ void renderHeightmap(ew::Shader shader, ew::Model model, float time)
 
     // Basic scene matrices
     shader.setMat4("_Model", glm::mat4(1.0f));
-    shader.setMat4("_ViewProjection", camera_view_proj);
+    shader.setMat4("_ViewProjection", viewProjection);
 
     // Camera
     shader.setVec3("_CameraPos", camera.position);
@@ -568,22 +662,14 @@ void renderHeightmap(ew::Shader shader, ew::Model model, float time)
     shader.setVec3("_LowlandColor", heightmapSettings.lowlandColor);
     shader.setVec3("_HighlandColor", heightmapSettings.highlandColor);
     shader.setVec3("_MountainColor", heightmapSettings.mountainColor);
-
-    model.draw();
-    shader.setMat4("_Model", glm::translate(glm::vec3(0.0f, -2.0f, 0.0f)));
-
-    //plane.draw();
-    // Draw the heightmap mesh
-    heightmapMesh.draw();
 }
 
-void renderMonkeys(ew::Shader shader, float time, GLuint brickTexture, ew::Model monkeyModel)
+void renderMonkeys(const ew::Shader& shader, float time, GLuint brickTexture, const ew::Model& monkeyModel)
 {
     shader.use();
 
     // Bind the texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, brickTexture);
+    glState.bindTexture(0, brickTexture);
 
     // Set texture uniform
     shader.setInt("_HeightmapTexture", 0);
@@ -592,8 +678,7 @@ void renderMonkeys(ew::Shader shader, float time, GLuint brickTexture, ew::Model
     if (debug.enable_shadows)
     {
         // Bind shadow map texture
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, depthBuffer.depthTexture);
+        glState.bindTexture(1, depthBuffer.depthTexture.get(), GL_TEXTURE_2D_ARRAY);
 
         shader.setInt("shadow_map", 1);
 
@@ -623,9 +708,18 @@ void renderMonkeys(ew::Shader shader, float time, GLuint brickTexture, ew::Model
         shader.setInt("enable_shadows", 0);
     }
 
-    // Draw each monkey
-    for (const auto& monkey : monkeys)
+    // Skip whole monkeys outside the view before testing their meshlets
+    monkeyQuery.clear();
+    monkeyTree.queryFrustum(ew::Frustum(camera), monkeyQuery);
+    monkeysVisible = (int)monkeyQuery.size();
+
+    // Draw each visible monkey
+    monkeyMeshletsDrawn = 0;
+    monkeyMeshletsTotal = 0;
+    for (unsigned int index : monkeyQuery)
     {
+        const Monkey& monkey = monkeys[index];
+
         // Create model matrix for each monkey
         glm::mat4 modelMatrix = glm::mat4(1.0f);
 
@@ -648,39 +742,46 @@ void renderMonkeys(ew::Shader shader, float time, GLuint brickTexture, ew::Model
         shader.setFloat("_SpecularStrength", heightmapSettings.specularStrength);
         shader.setFloat("_Shininess", heightmapSettings.shininess);
 
-        // Draw the monkey model
-        monkeyModel.draw();
+        // Draw the monkey model, skipping meshlets outside the view or facing away
+        monkeyMeshletsDrawn += monkeyModel.drawCulled(camera.projectionMatrix() * camera.viewMatrix(), modelMatrix, camera.position);
+        monkeyMeshletsTotal += monkeyModel.getNumMeshlets();
     }
 }
 
-void shadowPass(ew::Shader shadowPass, ew::Model monkeyModel) 
+void shadowPass(const ew::Shader& shadowPass, const ew::Model& monkeyModel) 
 {
     // Calculate all light view-projection matrices for cascades
     calculateLightSpaceMatrices();
 
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    glState.setDepthTest(true);
 
     // Cull facing if needed
-    if (debug.cull_front) 
-    {
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_FRONT);
-    }
-    else 
-    {
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-    }
+    glState.setCullFace(true, debug.cull_front ? ew::CullFace::FRONT : ew::CullFace::BACK);
 
     // Render depth for each cascade
+    std::vector<ew::InstanceData> instances;
+    monkeyShadowDraws = 0;
     for (unsigned int cascade = 0; cascade < debug.num_cascades; cascade++) 
     {
+        // Each cascade draws the monkeys inside its light frustum with one instanced call.
+        // Uploading orphans the buffer, so earlier cascades keep drawing from their own copy.
+        monkeyQuery.clear();
+        monkeyTree.queryFrustum(ew::Frustum(depthBuffer.lightViewProj[cascade]), monkeyQuery);
+        instances.resize(monkeyQuery.size());
+        for (size_t i = 0; i < monkeyQuery.size(); i++)
+        {
+            const Monkey& monkey = monkeys[monkeyQuery[i]];
+            instances[i].model = glm::translate(glm::mat4(1.0f), monkey.position) * glm::scale(glm::vec3(monkey.scale));
+        }
+        monkeyInstances.upload(instances);
+        monkeyShadowDraws += (int)instances.size();
+
         // Bind framebuffer for this cascade
-        glBindFramebuffer(GL_FRAMEBUFFER, depthBuffer.fbo);
+        glState.bindFramebuffer(depthBuffer.fbo.get());
 
         // Attach layer of depth texture array to this framebuffer depth attachment
-        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthBuffer.depthTexture, 0, cascade);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthBuffer.depthTexture.get(), 0, cascade);
 
         // Disable draw buffer
         glDrawBuffer(GL_NONE);
@@ -694,37 +795,29 @@ void shadowPass(ew::Shader shadowPass, ew::Model monkeyModel)
         }
 
         // Clear depth buffer
-        glViewport(0, 0, depthBuffer.width, depthBuffer.height);
+        glState.setViewport(0, 0, depthBuffer.width, depthBuffer.height);
         glClear(GL_DEPTH_BUFFER_BIT);
 
         // Use shadow shader
         shadowPass.use();
-        shadowPass.setMat4("_Model", glm::mat4(1.0f));
         shadowPass.setMat4("_LightViewProjection", depthBuffer.lightViewProj[cascade]);
 
         // Draw monkeys in shadow pass
-        for (const auto& monkey : monkeys) 
+        if (monkeyInstances.getCount() > 0)
         {
-            glm::mat4 modelMatrix = glm::mat4(1.0f);
-            modelMatrix = glm::translate(modelMatrix, monkey.position);
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(monkey.scale));
-
-            shadowPass.setMat4("_Model", modelMatrix);
-            shadowPass.setMat4("_LightViewProjection", depthBuffer.lightViewProj[cascade]);
-
-            monkeyModel.draw();
+            monkeyInstances.bind();
+            monkeyModel.drawInstanced(monkeyInstances.getCount(), true);
         }
-//        plane.draw();
+//        plane.drawDepth();
         // After rendering copy the depth data to visualization texture for IMGUI
-        glBindTexture(GL_TEXTURE_2D, depthBuffer.cascadeVisualizationTextures[cascade]);
-        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, depthBuffer.width, depthBuffer.height);
+        glCopyTextureSubImage2D(depthBuffer.cascadeVisualizationTextures[cascade].get(), 0, 0, 0, 0, 0, depthBuffer.width, depthBuffer.height);
     }
 
     // Reset framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState.bindFramebuffer(0);
 
     // Reset face culling
-    glCullFace(GL_BACK);
+    glState.setCullFace(true, ew::CullFace::BACK);
 }
 
 void calculateLightSpaceMatrices() 
@@ -945,11 +1038,41 @@ void drawUI()
             ImGui::ColorEdit3("Mountain Color", &heightmapSettings.mountainColor.x);
         }
 
+        // Terrain LOD
+        ImGui::Text("Level of Detail");
+        ImGui::SliderFloat("Pixel Error", &heightmapSettings.lodPixelError, 0.5f, 16.0f, "%.1f");
+        ImGui::SliderInt("Chunk Size", &heightmapSettings.chunkSize, 16, 128);
+        ImGui::Checkbox("Compact Vertices", &heightmapSettings.compactVertices);
+
         if (ImGui::Button("Regenerate Mesh")) 
         {
             loadSelectedHeightmap();
         }
         ImGui::Text("Heightmap: %dx%d", heightmapWidth, heightmapHeight);
+        if (heightmapBuilder.isBusy())
+        {
+            ImGui::Text("Rebuilding terrain...");
+        }
+        ImGui::Text("Chunks drawn: %d / %d", heightmapTerrain.getNumSelected(), heightmapTerrain.getNumNodes());
+        ImGui::Text("Triangles drawn: %d", heightmapTerrain.getNumSelectedIndices() / 3);
+        ImGui::Text("Terrain buffers: %.1f MB", heightmapTerrain.getBufferBytes() / (1024.0f * 1024.0f));
+        ImGui::Text("Monkeys drawn: %d / %d", monkeysVisible, (int)monkeys.size());
+        ImGui::Text("Monkeys in shadow cascades: %d", monkeyShadowDraws);
+        ImGui::Text("Monkey meshlets drawn: %d / %d", monkeyMeshletsDrawn, monkeyMeshletsTotal);
+#ifndef NDEBUG
+        // Live GL objects, these should settle back after switching heightmaps
+        for (int i = 0; i < (int)ew::GLObjectType::COUNT; i++)
+        {
+            ImGui::Text("%s: %d", ew::getGLObjectTypeName((ew::GLObjectType)i), ew::getNumLiveGLObjects((ew::GLObjectType)i));
+        }
+#endif
+        const ew::GLStateStats& glStats = glState.getLastFrameStats();
+        ImGui::Text("GL state calls: %d issued, %d elided", glStats.issued, glStats.elided);
+        bool validateGLState = glState.isValidating();
+        if (ImGui::Checkbox("Validate GL State", &validateGLState))
+        {
+            glState.setValidation(validateGLState);
+        }
     }
 
     // Material settings
@@ -1036,7 +1159,7 @@ void drawUI()
         for (int i = 0; i < debug.num_cascades; i++)
         {
             ImGui::Text("Cascade %d:", i);
-            ImGui::Image((ImTextureID)(intptr_t)depthBuffer.cascadeVisualizationTextures[i], ImVec2(256, 256));
+            ImGui::Image((ImTextureID)(intptr_t)depthBuffer.cascadeVisualizationTextures[i].get(), ImVec2(256, 256));
         }
     }
 
@@ -1078,7 +1201,7 @@ void drawUI()
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    glState.setViewport(0, 0, width, height);
     screenWidth = width;
     screenHeight = height;
     camera.aspectRatio = (float)screenWidth / screenHeight;
@@ -14,6 +14,8 @@
 #include <ew/transform.h>
 #include <ew/cameraController.h>
 #include <ew/texture.h>
+#include <ew/assetManager.h>
+#include <ew/glResource.h>
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
@@ -69,21 +71,21 @@ struct Material
 
 struct FrameBuffer
 {
-	GLuint fbo;
-	GLuint color0;
-	GLuint color1;
-	GLuint depth;
+	ew::Framebuffer fbo;
+	ew::Texture color0;
+	ew::Texture color1;
+	ew::Texture depth;
 }framebuffer;
 
 struct FullScreenQuad
 {
-	GLuint vao;
-	GLuint vbo;
+	ew::VertexArray vao;
+	ew::Buffer vbo;
 }fullscreen_quad;
 
 void render(ew::Shader& shader, ew::Model& model)
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo.get());
 	glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -136,25 +138,27 @@ int main() {
 	// Shader, model, and texture initialization
 	ew::Shader litShader = ew::Shader("assets/lit.vert", "assets/lit.frag");	// Shader for 3D rendering
 
-	// Post-processing shaders
-	ew::Shader fullShader = ew::Shader("assets/full.vert", "assets/full.frag");	// No effect (passthrough)
-	ew::Shader inverseShader = ew::Shader("assets/inverse.vert", "assets/inverse.frag");
-	ew::Shader grayscaleShader = ew::Shader("assets/grayscale.vert", "assets/grayscale.frag");
-	ew::Shader boxBlurShader = ew::Shader("assets/blur.vert", "assets/blur.frag");
-	ew::Shader gaussianBlurShader = ew::Shader("assets/blur.vert", "assets/gaussianBlur.frag");
-	ew::Shader chromaticShader = ew::Shader("assets/chromatic.vert", "assets/chromatic.frag");
-	ew::Shader gammaShader = ew::Shader("assets/blur.vert", "assets/gamma.frag");
-	ew::Shader filmGrainShader = ew::Shader("assets/blur.vert", "assets/filmGrain.frag");
-	ew::Shader sharpenShader = ew::Shader("assets/blur.vert", "assets/sharpen.frag");
-	ew::Shader edgeDetectShader = ew::Shader("assets/blur.vert", "assets/edgeDetect.frag");
-	ew::Shader hdrShader = ew::Shader("assets/blur.vert", "assets/HDR.frag");
-	ew::Shader vignetteShader = ew::Shader("assets/blur.vert", "assets/vignette.frag");
-	ew::Shader lensDistortionShader = ew::Shader("assets/blur.vert", "assets/lensDistortion.frag");
-	ew::Shader fogShader = ew::Shader("assets/blur.vert", "assets/fog.frag");
+	// Post-processing shaders, the shared blur.vert stage is only compiled once
+	ew::AssetManager assets;
+	std::shared_ptr<const ew::Shader> fullShader = assets.getShader("assets/full.vert", "assets/full.frag");	// No effect (passthrough)
+	std::shared_ptr<const ew::Shader> inverseShader = assets.getShader("assets/inverse.vert", "assets/inverse.frag");
+	std::shared_ptr<const ew::Shader> grayscaleShader = assets.getShader("assets/grayscale.vert", "assets/grayscale.frag");
+	std::shared_ptr<const ew::Shader> boxBlurShader = assets.getShader("assets/blur.vert", "assets/blur.frag");
+	std::shared_ptr<const ew::Shader> gaussianBlurShader = assets.getShader("assets/blur.vert", "assets/gaussianBlur.frag");
+	std::shared_ptr<const ew::Shader> chromaticShader = assets.getShader("assets/chromatic.vert", "assets/chromatic.frag");
+	std::shared_ptr<const ew::Shader> gammaShader = assets.getShader("assets/blur.vert", "assets/gamma.frag");
+	std::shared_ptr<const ew::Shader> filmGrainShader = assets.getShader("assets/blur.vert", "assets/filmGrain.frag");
+	std::shared_ptr<const ew::Shader> sharpenShader = assets.getShader("assets/blur.vert", "assets/sharpen.frag");
+	std::shared_ptr<const ew::Shader> edgeDetectShader = assets.getShader("assets/blur.vert", "assets/edgeDetect.frag");
+	std::shared_ptr<const ew::Shader> hdrShader = assets.getShader("assets/blur.vert", "assets/HDR.frag");
+	std::shared_ptr<const ew::Shader> vignetteShader = assets.getShader("assets/blur.vert", "assets/vignette.frag");
+	std::shared_ptr<const ew::Shader> lensDistortionShader = assets.getShader("assets/blur.vert", "assets/lensDistortion.frag");
+	std::shared_ptr<const ew::Shader> fogShader = assets.getShader("assets/blur.vert", "assets/fog.frag");
+	printf("Post-processing: %d programs from %d compiled stages\n", assets.getStats().loads, assets.getStats().shaderStagesCompiled);
 
 	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");					// Model
 
-	GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");		// Texture
+	ew::Texture brickTexture = ew::loadTexture("assets/brick_color.jpg");		// Texture
 
 	camera.position = glm::vec3(0.0f, 0.0f, 5.0f);
 	camera.target = glm::vec3(0.0f, 0.0f, 0.0f);	// Look at center of scene
@@ -162,11 +166,11 @@ int main() {
 	camera.fov = 60.0f;								// Vertical field of view in degrees
 
 	// Full-screen quad setup
-	glGenVertexArrays(1, &fullscreen_quad.vao);
-	glBindVertexArray(fullscreen_quad.vao);
+	fullscreen_quad.vao = ew::VertexArray::create();
+	glBindVertexArray(fullscreen_quad.vao.get());
 
-	glGenBuffers(1, &fullscreen_quad.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, fullscreen_quad.vbo);
+	fullscreen_quad.vbo = ew::Buffer::create();
+	glBindBuffer(GL_ARRAY_BUFFER, fullscreen_quad.vbo.get());
 	glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
 
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
@@ -179,23 +183,23 @@ int main() {
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
 	// Initialize framebuffer
-	glGenFramebuffers(1, &framebuffer.fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+	framebuffer.fbo = ew::Framebuffer::create();
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo.get());
 
-	glGenTextures(1, &framebuffer.color0);
-	glBindTexture(GL_TEXTURE_2D, framebuffer.color0);
+	framebuffer.color0 = ew::Texture::create();
+	glBindTexture(GL_TEXTURE_2D, framebuffer.color0.get());
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 800, 600, 0, GL_RGB, GL_FLOAT, nullptr); // Changed to GL_RGB16F for HDR
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebuffer.color0, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebuffer.color0.get(), 0);
 
 	// Change depth attachment to a texture for post-processing
-	glGenTextures(1, &framebuffer.depth);
-	glBindTexture(GL_TEXTURE_2D, framebuffer.depth);
+	framebuffer.depth = ew::Texture::create();
+	glBindTexture(GL_TEXTURE_2D, framebuffer.depth.get());
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, 800, 600, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, framebuffer.depth, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, framebuffer.depth.get(), 0);
 
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
 		printf("Framebuffer incomplete:\n");
@@ -221,7 +225,7 @@ int main() {
 		cameraController.move(window, &camera, deltaTime);
 
 		glActiveTexture(GL_TEXTURE0);  // Activate texture unit 0
-		glBindTexture(GL_TEXTURE_2D, brickTexture);  // Bind the texture
+		glBindTexture(GL_TEXTURE_2D, brickTexture.get());  // Bind the texture
 
 		// Render the 3D scene to framebuffer (always do this for consistency)
 		render(litShader, monkeyModel);
@@ -238,7 +242,7 @@ int main() {
 			glEnable(GL_DEPTH_TEST);
 
 			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, brickTexture);
+			glBindTexture(GL_TEXTURE_2D, brickTexture.get());
 
 			litShader.use();
 			litShader.setInt("_MainTexture", 0);
@@ -253,50 +257,50 @@ int main() {
 		}
 		else {
 			// Apply the selected post-processing effect
-			ew::Shader* currentShader = &fullShader; // Default to full shader if something goes wrong
+			const ew::Shader* currentShader = fullShader.get(); // Default to full shader if something goes wrong
 
 			switch (currentEffect) {
 			case 1: // Inverse
-				currentShader = &inverseShader;
+				currentShader = inverseShader.get();
 				break;
 			case 2: // Grayscale
-				currentShader = &grayscaleShader;
+				currentShader = grayscaleShader.get();
 				break;
 			case 3: // Blur
 				// Select blur type based on user selection
 				if (blurType == 0) {
-					currentShader = &boxBlurShader;
+					currentShader = boxBlurShader.get();
 				}
 				else {
-					currentShader = &gaussianBlurShader;
+					currentShader = gaussianBlurShader.get();
 				}
 				break;
 			case 4: // Chromatic Aberration
-				currentShader = &chromaticShader;
+				currentShader = chromaticShader.get();
 				break;
 			case 5: // Gamma Correction
-				currentShader = &gammaShader;
+				currentShader = gammaShader.get();
 				break;
 			case 6: // Film Grain
-				currentShader = &filmGrainShader;
+				currentShader = filmGrainShader.get();
 				break;
 			case 7: // Sharpen
-				currentShader = &sharpenShader;
+				currentShader = sharpenShader.get();
 				break;
 			case 8: // Edge Detection
-				currentShader = &edgeDetectShader;
+				currentShader = edgeDetectShader.get();
 				break;
 			case 9: // HDR Tone Mapping
-				currentShader = &hdrShader;
+				currentShader = hdrShader.get();
 				break;
 			case 10: // Vignette
-				currentShader = &vignetteShader;
+				currentShader = vignetteShader.get();
 				break;
 			case 11: // Lens Distortion
-				currentShader = &lensDistortionShader;
+				currentShader = lensDistortionShader.get();
 				break;
 			case 12: // Fog
-				currentShader = &fogShader;
+				currentShader = fogShader.get();
 				break;
 			}
 
@@ -345,16 +349,16 @@ int main() {
 
 				// Set depth texture
 				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, framebuffer.depth);
+				glBindTexture(GL_TEXTURE_2D, framebuffer.depth.get());
 				currentShader->setInt("_DepthTexture", 1);
 			}
 
 			glBindFramebuffer(GL_FRAMEBUFFER, 0);
 			glDisable(GL_DEPTH_TEST);
 
-			glBindVertexArray(fullscreen_quad.vao);
+			glBindVertexArray(fullscreen_quad.vao.get());
 			glActiveTexture(GL_TEXTURE0);  // Activate texture unit 0
-			glBindTexture(GL_TEXTURE_2D, framebuffer.color0);  // Bind the framebuffer texture
+			glBindTexture(GL_TEXTURE_2D, framebuffer.color0.get());  // Bind the framebuffer texture
 			glDrawArrays(GL_TRIANGLES, 0, 6);
 		}
 
@@ -365,13 +369,6 @@ int main() {
 		glfwSwapBuffers(window);
 	}
 
-	// Clean up resources
-	glDeleteVertexArrays(1, &fullscreen_quad.vao);
-	glDeleteBuffers(1, &fullscreen_quad.vbo);
-	glDeleteFramebuffers(1, &framebuffer.fbo);
-	glDeleteTextures(1, &framebuffer.color0);
-	glDeleteTextures(1, &framebuffer.depth);
-
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -483,7 +480,7 @@ void drawUI() {
 		}
 	}
 
-	ImGui::Image((ImTextureID)(intptr_t)framebuffer.color0, ImVec2(800, 600), ImVec2(0, 1), ImVec2(1, 0));
+	ImGui::Image((ImTextureID)(intptr_t)framebuffer.color0.get(), ImVec2(800, 600), ImVec2(0, 1), ImVec2(1, 0));
 
 	ImGui::End();
 
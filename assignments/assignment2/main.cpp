@@ -19,6 +19,8 @@
 #include <ew/cameraController.h>
 #include <ew/texture.h>
 #include <ew/procGen.h>
+#include <ew/drawList.h>
+#include <ew/glResource.h>
 
 const int SHADOW_WIDTH = 2048;
 const int SHADOW_HEIGHT = 2048;
@@ -40,6 +42,9 @@ ew::Transform monkeyTransform;
 ew::Transform planeTransform;
 ew::Mesh plane;
 
+// Sorts the scene's draws and skips redundant binds
+ew::DrawList drawList;
+
 // Shadow mapping structs and variables
 struct DirectionalLight {
     glm::vec3 direction = glm::vec3(-0.2f, -1.0f, -0.3f);
@@ -53,14 +58,14 @@ struct DirectionalLight {
 } directionalLight;
 
 struct ShadowMap {
-    GLuint fbo;
-    GLuint depthTexture;
+    ew::Framebuffer fbo;
+    ew::Texture depthTexture;
 
     void init() {
-        glGenFramebuffers(1, &fbo);
-        glGenTextures(1, &depthTexture);
+        fbo = ew::Framebuffer::create();
+        depthTexture = ew::Texture::create();
 
-        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glBindTexture(GL_TEXTURE_2D, depthTexture.get());
         glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT,
             0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 
@@ -71,8 +76,8 @@ struct ShadowMap {
         float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
         glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo.get());
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture.get(), 0);
         glDrawBuffer(GL_NONE);
         glReadBuffer(GL_NONE);
 
@@ -117,7 +122,7 @@ glm::mat4 calculateLightSpaceMatrix() {
 
 void renderShadowMap(ew::Shader& depthShader, ew::Model& monkeyModel, ew::Mesh& planeMesh) {
     glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.fbo.get());
     glClear(GL_DEPTH_BUFFER_BIT);
     glCullFace(GL_BACK);
 
@@ -128,12 +133,12 @@ void renderShadowMap(ew::Shader& depthShader, ew::Model& monkeyModel, ew::Mesh&
 
     // Render monkey
     depthShader.setMat4("_Model", monkeyTransform.modelMatrix());
-    monkeyModel.draw();
+    monkeyModel.drawDepth();
 
     // Render plane
     glm::mat4 planeModel = glm::mat4(1.0f);
     depthShader.setMat4("_Model", planeModel);
-    //planeMesh.draw();
+    //planeMesh.drawDepth();
 	//glCullFace(GL_BACK);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
@@ -141,15 +146,13 @@ void renderShadowMap(ew::Shader& depthShader, ew::Model& monkeyModel, ew::Mesh&
 void renderScene(ew::Shader& shader, ew::Model& monkeyModel, ew::Mesh& planeMesh, GLuint texture) {
     shader.use();
 
-    // Texture
+    // Texture, bound to unit 0 by the draw list
     shader.setInt("_MainTexture", 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
 
     // Shadow map
     shader.setInt("_ShadowMap", 1);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, shadowMap.depthTexture);
+    glBindTexture(GL_TEXTURE_2D, shadowMap.depthTexture.get());
 
     // Light space matrix
     glm::mat4 lightSpaceMatrix = calculateLightSpaceMatrix();
@@ -171,14 +174,11 @@ void renderScene(ew::Shader& shader, ew::Model& monkeyModel, ew::Mesh& planeMesh
     shader.setFloat("_Material.Ks", material.Ks);
     shader.setFloat("_Material.Shininess", material.Shininess);
 
-    // Render monkey
-    shader.setMat4("_Model", monkeyTransform.modelMatrix());
-    monkeyModel.draw();
-
-    // Render plane
-    glm::mat4 planeModel = glm::mat4(1.0f);
-    shader.setMat4("_Model", planeTransform.modelMatrix());
-    planeMesh.draw();
+    // Render monkey and plane
+    drawList.begin(camera.viewMatrix(), camera.nearPlane, camera.farPlane);
+    drawList.add(shader, texture, monkeyModel, monkeyTransform.modelMatrix());
+    drawList.add(shader, texture, planeMesh, planeTransform.modelMatrix());
+    drawList.submit();
 }
 
 void drawUI() {
@@ -210,9 +210,16 @@ void drawUI() {
         ImGui::SliderFloat("Shininess", &material.Shininess, 2.0f, 256.0f);
     }
 
+    if (ImGui::CollapsingHeader("Draw Stats")) {
+        const ew::DrawStats& stats = drawList.getStats();
+        ImGui::Text("Draws: %d", stats.draws);
+        ImGui::Text("Binds: %d (%d unsorted)", stats.binds.total(), stats.unsortedBinds.total());
+        ImGui::Text("Programs: %d, Textures: %d, Vertex arrays: %d", stats.binds.programs, stats.binds.textures, stats.binds.vertexArrays);
+    }
+
     // Shadow map debug view
     ImGui::Text("Shadow Map Debug View");
-    ImGui::Image((ImTextureID)(intptr_t)shadowMap.depthTexture, ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
+    ImGui::Image((ImTextureID)(intptr_t)shadowMap.depthTexture.get(), ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
 
     ImGui::End();
 
@@ -273,8 +280,8 @@ int main() {
     ew::Shader depthShader = ew::Shader("assets/depthmap.vert", "assets/depthmap.frag");
 
     // Model and texture loading
-    ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
-    GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
+    ew::Model monkeyModel = ew::Model("assets/suzanne.obj", true);
+    ew::Texture brickTexture = ew::loadTexture("assets/brick_color.jpg");
 
     // Camera setup
     camera.position = glm::vec3(0.0f, 3.0f, 5.0f);
@@ -286,7 +293,7 @@ int main() {
     shadowMap.init();
 
     // Create ground plane
-    ew::Mesh plane = ew::createPlane(20, 20, 10);
+    ew::Mesh plane = ew::Mesh(ew::createPlane(20, 20, 10), true);
     planeTransform.position = glm::vec3(0.0f, -5.0f, 0.0f);
 
     // Main render loop
@@ -311,7 +318,7 @@ int main() {
         glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        renderScene(newShader, monkeyModel, plane, brickTexture);
+        renderScene(newShader, monkeyModel, plane, brickTexture.get());
 
         // Draw UI
         drawUI();
@@ -0,0 +1,6 @@
+#version 450
+
+void main()
+{
+    // Only depth is written, which the rasterizer does without any output here
+}
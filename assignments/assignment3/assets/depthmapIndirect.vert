@@ -0,0 +1,32 @@
+#version 450
+#extension GL_ARB_shader_draw_parameters : require
+
+layout(location = 0) in vec3 aPosition;
+
+struct InstanceData
+{
+    mat4 model;
+    vec4 color;
+};
+layout(std430, binding = 0) readonly buffer Instances
+{
+    InstanceData _Instances[];
+};
+struct DrawData
+{
+    uint transformIndex;
+    uint materialIndex;
+};
+layout(std430, binding = 1) readonly buffer Draws
+{
+    DrawData _Draws[];
+};
+
+uniform mat4 _LightSpaceMatrix;
+
+void main()
+{
+    mat4 model = _Instances[_Draws[gl_BaseInstanceARB + gl_InstanceID].transformIndex].model;
+    // Transform vertex to light space
+    gl_Position = _LightSpaceMatrix * model * vec4(aPosition, 1.0);
+}
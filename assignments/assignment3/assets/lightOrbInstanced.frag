@@ -0,0 +1,9 @@
+#version 450
+in vec3 fragNormal;
+in vec3 fragColor;
+out vec4 FragColor;
+void main() {
+    vec3 normal = normalize(fragNormal);
+    float intensity = max(0.5, dot(normal, vec3(0.0, 0.0, 1.0)));
+    FragColor = vec4(fragColor * intensity, 0.7);
+}
@@ -0,0 +1,19 @@
+#version 450
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+struct InstanceData {
+    mat4 model;
+    vec4 color;
+};
+layout(std430, binding = 0) readonly buffer Instances {
+    InstanceData _Instances[];
+};
+uniform mat4 _ViewProjection;
+out vec3 fragNormal;
+out vec3 fragColor;
+void main() {
+    mat4 model = _Instances[gl_InstanceID].model;
+    fragNormal = mat3(transpose(inverse(model))) * aNormal;
+    fragColor = _Instances[gl_InstanceID].color.rgb;
+    gl_Position = _ViewProjection * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 450
+#extension GL_ARB_shader_draw_parameters : require
+
+//Same as lit.vert, with the model matrix picked by the render queue's draw data
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vTextureCoord;
+
+out Surface
+{
+	vec3 WorldPosition;	//vertex position in world space
+	vec3 WorldNormal;	//vertex normal in world space
+	vec2 TextCoord;
+}vs_out;
+
+struct InstanceData
+{
+	mat4 model;
+	vec4 color;
+};
+layout(std430, binding = 0) readonly buffer Instances
+{
+	InstanceData _Instances[];
+};
+struct DrawData
+{
+	uint transformIndex;
+	uint materialIndex;
+};
+layout(std430, binding = 1) readonly buffer Draws
+{
+	DrawData _Draws[];
+};
+
+uniform mat4 _ViewProjection; //Combined View->Projection Matrix
+
+void main()
+{
+	mat4 model = _Instances[_Draws[gl_BaseInstanceARB + gl_InstanceID].transformIndex].model;
+	vs_out.WorldPosition = vec3(model * vec4(vPos, 1.0));
+	vs_out.WorldNormal = transpose(inverse(mat3(model))) * vNormal;
+	vs_out.TextCoord = vTextureCoord;
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPosition, 1.0);
+}
@@ -19,8 +19,17 @@
 #include <ew/cameraController.h>
 #include <ew/texture.h>
 #include <ew/mesh.h>
+#include <ew/geometryPool.h>
+#include <ew/instanceBuffer.h>
+#include <ew/renderQueue.h>
+#include <ew/glState.h>
+#include <ew/glResource.h>
+#include <ew/culling.h>
+#include <ew/aabbTree.h>
+#include <ew/jobs.h>
 #include <vector>
 #include <ew/procGen.h>
+#include <ew/hiZPyramid.h>
 
 const int SHADOW_WIDTH = 2048;
 const int SHADOW_HEIGHT = 2048;
@@ -32,6 +41,38 @@ float prevFrameTime = 0.0f;
 float deltaTime = 0.0f;
 ew::Mesh sphereMesh;
 
+// Per-instance model matrices and colors, rebuilt every frame
+ew::InstanceBuffer sceneTransforms;
+ew::InstanceBuffer lightInstances;
+// Monkeys and plane, drawn with one indirect call per pass.
+// The scene queue has what the camera sees, the shadow queue what the light sees, which can be outside the view.
+ew::RenderQueue sceneQueue;
+ew::RenderQueue shadowQueue;
+// Monkeys and the plane by world bounds, with their transform index as user data
+ew::AabbTree sceneTree;
+std::vector<int> monkeyProxies;
+// World space bounds of every monkey, and what the last tree query found
+std::vector<glm::vec4> monkeySpheres;
+std::vector<unsigned int> sceneQuery;
+int numVisibleMonkeys = 0;
+int numShadowCasters = 0;
+// Tree leaves carry a margin, so the monkeys a query finds are narrowed by their exact spheres.
+// Counts the monkeys the tree let through that the sphere test then dropped, for both passes.
+std::vector<glm::vec4> candidateSpheres;
+std::vector<unsigned int> candidateMonkeys;
+std::vector<unsigned int> sphereSurvivors;
+int numSphereCulled = 0;
+// With GPU culling the queues hold everything and a compute pass drops what the frustums exclude,
+// plus, for the camera, what the last frame's depth pyramid shows to be hidden. The tree is only used without it.
+bool gpuCulling = true;
+// Queues filled for GPU culling keep everything, so they only need filling again after the CPU path used them
+bool gpuQueuesFilled = false;
+ew::HiZPyramid hiZ;
+glm::mat4 hiZViewProjection;
+// Skips state changes that are already in place, everything in the frame goes through it
+ew::GLState& glState = ew::GLState::get();
+std::vector<ew::InstanceData> instanceScratch;
+
 // Visualization mode for display (NEW)
 enum class VisualizationMode {
     FINAL_RENDER,
@@ -48,10 +89,11 @@ bool showDebugUI = true;  // Toggle for debug UI
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
 void drawUI();
-void renderShadowMap(ew::Shader& depthShader, ew::Model& model, ew::Mesh& planeMesh);
+void renderShadowMap(ew::Shader& depthShader);
+void cullQueryBySphere(const ew::Frustum& frustum, std::vector<unsigned int>& query);
 void renderScene(ew::Shader& shader, ew::Model& monkeyModel, ew::Mesh& planeMesh, GLuint texture);
-void drawScene(ew::Camera& camera, ew::Shader& shader, ew::Model& model, ew::Mesh& planeMesh);
-void drawLights(ew::Shader& shader, ew::Mesh& sphereMesh);
+void drawScene(ew::Camera& camera, ew::Shader& shader);
+void drawLights(ew::Shader& instancedShader, ew::Mesh& sphereMesh, float sizeScale, float brightness);
 void drawDebugView(ew::Shader& shader, GLuint textureID); // NEW: For visualization modes
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods); // NEW: Key handler
 
@@ -119,11 +161,12 @@ void distributePointLights() {
         pointLights[i].radius = 5.0f;
     }
 }struct FrameBuffer {
-    GLuint fbo;
-    GLuint colorBuffers[3]; // For GBuffer implementation
-    GLuint color0;          // For shadow frame buffer
-    GLuint color1;          // For shadow frame buffer
-    GLuint depth;           // For shadow frame buffer
+    ew::Framebuffer fbo;
+    ew::Texture colorBuffers[3];        // For GBuffer implementation
+    ew::Texture color0;                 // For shadow frame buffer
+    ew::Texture color1;                 // For shadow frame buffer
+    ew::Texture depth;                  // Depth attachment that gets sampled
+    ew::Renderbuffer depthRenderbuffer; // Depth attachment that is only tested against
     unsigned int width;     // Buffer dimensions
     unsigned int height;    // Buffer dimensions
 };
@@ -133,8 +176,8 @@ FrameBuffer createGBuffer(unsigned int width, unsigned int height) {
     framebuffer.width = width;
     framebuffer.height = height;
 
-    glCreateFramebuffers(1, &framebuffer.fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+    framebuffer.fbo = ew::Framebuffer::create();
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo.get());
 
     int formats[3] = {
         GL_RGB32F, //0 = World Position 
@@ -144,8 +187,8 @@ FrameBuffer createGBuffer(unsigned int width, unsigned int height) {
     //Create 3 color textures
     for (size_t i = 0; i < 3; i++)
     {
-        glGenTextures(1, &framebuffer.colorBuffers[i]);
-        glBindTexture(GL_TEXTURE_2D, framebuffer.colorBuffers[i]);
+        framebuffer.colorBuffers[i] = ew::Texture::create();
+        glBindTexture(GL_TEXTURE_2D, framebuffer.colorBuffers[i].get());
         glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], width, height);
         //Clamp to border so we don't wrap when sampling for post processing
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -154,7 +197,7 @@ FrameBuffer createGBuffer(unsigned int width, unsigned int height) {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         //Attach each texture to a different slot.
         //GL_COLOR_ATTACHMENT0 + 1 = GL_COLOR_ATTACHMENT1, etc
-        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, framebuffer.colorBuffers[i], 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, framebuffer.colorBuffers[i].get(), 0);
     }
     //Explicitly tell OpenGL which color attachments we will draw to
     const GLenum drawBuffers[3] = {
@@ -162,6 +205,14 @@ FrameBuffer createGBuffer(unsigned int width, unsigned int height) {
     };
     glDrawBuffers(3, drawBuffers);
 
+    //Depth, so the scene is depth tested and the Hi-Z pyramid can be built from it
+    framebuffer.depth = ew::Texture::create();
+    glBindTexture(GL_TEXTURE_2D, framebuffer.depth.get());
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, framebuffer.depth.get(), 0);
+
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     return framebuffer;
@@ -193,14 +244,14 @@ struct DirectionalLight {
 FrameBuffer framebuffer;
 
 struct ShadowMap {
-    GLuint fbo;
-    GLuint depthTexture;
+    ew::Framebuffer fbo;
+    ew::Texture depthTexture;
 
     void init() {
-        glGenFramebuffers(1, &fbo);
-        glGenTextures(1, &depthTexture);
+        fbo = ew::Framebuffer::create();
+        depthTexture = ew::Texture::create();
 
-        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glBindTexture(GL_TEXTURE_2D, depthTexture.get());
         glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT,
             0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 
@@ -211,8 +262,8 @@ struct ShadowMap {
         float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
         glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo.get());
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture.get(), 0);
         glDrawBuffer(GL_NONE);
         glReadBuffer(GL_NONE);
 
@@ -264,32 +315,49 @@ glm::mat4 calculateLightSpaceMatrix() {
     return lightProjection * lightView;
 }
 
-void renderShadowMap(ew::Shader& depthShader, ew::Model& model, ew::Mesh& planeMesh) {
-    glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.fbo);
+void renderShadowMap(ew::Shader& depthShader) {
+    glState.setViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+    glState.bindFramebuffer(shadowMap.fbo.get());
     glClear(GL_DEPTH_BUFFER_BIT);
 
-    glDisable(GL_CULL_FACE);
+    glState.setCullFace(false);
 
     glm::mat4 lightSpaceMatrix = calculateLightSpaceMatrix();
+
+    // Render the casters the light sees
     depthShader.use();
     depthShader.setMat4("_LightSpaceMatrix", lightSpaceMatrix);
+    sceneTransforms.bind();
+    shadowQueue.submit(true);
 
-    // Render all monkeys
-    for (size_t i = 0; i < monkeyTransforms.size(); i++) {
-        depthShader.setMat4("_Model", monkeyTransforms[i].modelMatrix());
-        model.draw();
-    }
+    glState.bindFramebuffer(0);
 
-    // Render plane
-    depthShader.setMat4("_Model", planeTransform.modelMatrix());
-    planeMesh.draw();
+    // Restore culling state for regular rendering
+    glState.setCullFace(true, ew::CullFace::BACK);
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+// Keeps the queried monkeys whose sphere is inside the frustum, everything else in the query stays
+void cullQueryBySphere(const ew::Frustum& frustum, std::vector<unsigned int>& query) {
+    candidateSpheres.clear();
+    candidateMonkeys.clear();
+    size_t numKept = 0;
+    for (unsigned int i : query) {
+        if (i < monkeySpheres.size()) {
+            candidateSpheres.push_back(monkeySpheres[i]);
+            candidateMonkeys.push_back(i);
+        }
+        else {
+            query[numKept++] = i;
+        }
+    }
 
-    // Restore culling state for regular rendering
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    sphereSurvivors.resize(candidateSpheres.size());
+    int numVisible = ew::cullSpheres(frustum, candidateSpheres.data(), (int)candidateSpheres.size(), sphereSurvivors.data());
+    query.resize(numKept);
+    for (int v = 0; v < numVisible; v++) {
+        query.push_back(candidateMonkeys[sphereSurvivors[v]]);
+    }
+    numSphereCulled += (int)candidateSpheres.size() - numVisible;
 }
 
 void setupCulling() {
@@ -298,23 +366,33 @@ void setupCulling() {
     glFrontFace(GL_CCW);
 }
 
-void drawScene(ew::Camera& camera, ew::Shader& shader, ew::Model& model, ew::Mesh& planeMesh) {
+void drawScene(ew::Camera& camera, ew::Shader& shader) {
     shader.use();
 
     // Camera and view
     shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
     shader.setVec3("camera_pos", camera.position);
 
-    // Render plane
-    shader.setMat4("_Model", planeTransform.modelMatrix());
-    planeMesh.draw();
+    glState.setDepthTest(true);
+    // Render the plane and all monkeys
+    sceneTransforms.bind();
+    sceneQueue.submit();
+}
 
-    glEnable(GL_DEPTH_TEST);
-    // Render all monkeys
-    for (size_t i = 0; i < monkeyTransforms.size(); i++) {
-        shader.setMat4("_Model", monkeyTransforms[i].modelMatrix());
-        model.draw();
+// Draws every active point light as an orb with one instanced draw
+void drawLights(ew::Shader& instancedShader, ew::Mesh& sphereMesh, float sizeScale, float brightness) {
+    instanceScratch.resize(currentPointLightCount);
+    for (int i = 0; i < currentPointLightCount; i++) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), pointLights[i].position);
+        instanceScratch[i].model = glm::scale(model, glm::vec3(pointLights[i].radius * sizeScale));
+        instanceScratch[i].color = glm::vec4(glm::vec3(pointLights[i].color) * brightness, 1.0f);
     }
+    lightInstances.upload(instanceScratch);
+
+    instancedShader.use();
+    instancedShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+    lightInstances.bind();
+    sphereMesh.drawInstanced(lightInstances.getCount());
 }
 
 void renderScene(ew::Shader& shader, ew::Model& monkeyModel, ew::Mesh& planeMesh, GLuint texture) {
@@ -328,7 +406,7 @@ void renderScene(ew::Shader& shader, ew::Model& monkeyModel, ew::Mesh& planeMesh
     // Shadow map
     shader.setInt("_ShadowMap", 1);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, shadowMap.depthTexture);
+    glBindTexture(GL_TEXTURE_2D, shadowMap.depthTexture.get());
 
     // Light space matrix
     glm::mat4 lightSpaceMatrix = calculateLightSpaceMatrix();
@@ -363,22 +441,20 @@ void renderScene(ew::Shader& shader, ew::Model& monkeyModel, ew::Mesh& planeMesh
 
 // NEW: Function to draw a fullscreen quad for debug visualization
 void drawDebugView(ew::Shader& shader, GLuint textureID) {
-    static GLuint debugVAO = 0;
+    static ew::VertexArray debugVAO;
 
     // Create VAO for fullscreen quad if it doesn't exist
-    if (debugVAO == 0) {
-        glGenVertexArrays(1, &debugVAO);
+    if (!debugVAO) {
+        debugVAO = ew::VertexArray::create();
     }
 
     shader.use();
     shader.setInt("_MainTexture", 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    glState.bindTexture(0, textureID);
 
     // Draw a fullscreen triangle
-    glBindVertexArray(debugVAO);
+    glState.bindVertexArray(debugVAO.get());
     glDrawArrays(GL_TRIANGLES, 0, 3);
-    glBindVertexArray(0);
 }
 
 void drawUI() {
@@ -391,7 +467,7 @@ void drawUI() {
             ImVec2 texSize = ImVec2(gBuffer.width / 4, gBuffer.height / 4);
             for (size_t i = 0; i < 3; i++)
             {
-                ImGui::Image((ImTextureID)gBuffer.colorBuffers[i], texSize, ImVec2(0, 1), ImVec2(1, 0));
+                ImGui::Image((ImTextureID)(intptr_t)gBuffer.colorBuffers[i].get(), texSize, ImVec2(0, 1), ImVec2(1, 0));
             }
         }
         ImGui::End();
@@ -458,9 +534,13 @@ void drawUI() {
             ImGui::SliderFloat("Shininess", &material.Shininess, 2.0f, 256.0f);
         }
 
+        if (ImGui::CollapsingHeader("Culling")) {
+            ImGui::Checkbox("GPU Culling", &gpuCulling);
+        }
+
         // Shadow map debug view
         ImGui::Text("Shadow Map Debug View");
-        ImGui::Image((ImTextureID)(intptr_t)shadowMap.depthTexture, ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
+        ImGui::Image((ImTextureID)(intptr_t)shadowMap.depthTexture.get(), ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
 
         ImGui::End();
     }
@@ -499,6 +579,18 @@ void drawUI() {
 
             ImGui::SameLine(500);
             ImGui::Text("Active Lights: %d", currentPointLightCount);
+
+            ImGui::SameLine(650);
+            if (gpuCulling) {
+                ImGui::Text("Monkeys: %d, culled on the GPU", (int)monkeyTransforms.size());
+            }
+            else {
+                ImGui::Text("Monkeys: %d/%d visible, casters: %d, sphere culled: %d", numVisibleMonkeys, (int)monkeyTransforms.size(), numShadowCasters, numSphereCulled);
+            }
+
+            ImGui::SameLine(1000);
+            const ew::GLStateStats& glStats = glState.getLastFrameStats();
+            ImGui::Text("GL calls: %d issued, %d elided", glStats.issued, glStats.elided);
         }
         ImGui::End();
     }
@@ -541,7 +633,7 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 }
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
+    glState.setViewport(0, 0, width, height);
     screenWidth = width;
     screenHeight = height;
     camera.aspectRatio = (float)screenWidth / screenHeight;
@@ -570,6 +662,13 @@ GLFWwindow* initWindow(const char* title, int width, int height) {
         glfwTerminate();
         return nullptr;
     }
+    // The scene and shadow passes pick their draws with the base instance
+    if (!ew::RenderQueue::isSupported()) {
+        printf("Needs OpenGL 4.6 or GL_ARB_shader_draw_parameters\n");
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return nullptr;
+    }
 
     // Enable depth testing and culling
     glEnable(GL_DEPTH_TEST);
@@ -597,17 +696,26 @@ int main() {
 
     // Shader initialization
     ew::Shader newShader = ew::Shader("assets/full.vert", "assets/full.frag");
-    ew::Shader depthShader = ew::Shader("assets/depthmap.vert", "assets/depthmap.frag");
-    ew::Shader gBufferShader = ew::Shader("assets/lit.vert", "assets/geometryPass.frag");
+    // The scene passes fetch their model matrices through the render queue's draw data
+    ew::Shader depthShader = ew::Shader("assets/depthmapIndirect.vert", "assets/depthmap.frag");
+    ew::Shader gBufferShader = ew::Shader("assets/litIndirect.vert", "assets/geometryPass.frag");
     ew::Shader deferredShader = ew::Shader("assets/fsTriangle.vert", "assets/deferredLit.frag");
+    // GPU culling, see gpuCulling
+    ew::Shader hiZShader = ew::Shader("assets/hiZBuild.comp");
+    ew::Shader cullShader = ew::Shader("assets/cullDraws.comp");
 
     ew::Shader lightOrbShader = ew::Shader("assets/lightOrb.vert", "assets/lightOrb.frag");
 
+    // Instanced version that reads model matrices and colors from an instance buffer
+    ew::Shader lightOrbInstancedShader = ew::Shader("assets/lightOrbInstanced.vert", "assets/lightOrbInstanced.frag");
+
     // Model and texture loading
-    ew::Model monkeyModel("assets/suzanne.obj");
-    GLuint brickTexture = ew::loadTexture("assets/brick_color.jpg");
+    // Every mesh shares one set of buffers, so drawing the grid, plane and lights never switches vertex arrays
+    ew::GeometryPool geometryPool(ew::VertexFormat(), true);
+    ew::Model monkeyModel("assets/suzanne.obj", geometryPool);
+    ew::Texture brickTexture = ew::loadTexture("assets/brick_color.jpg");
 
-    sphereMesh.load(ew::createSphere(0.5f, 20));
+    sphereMesh.load(ew::createSphere(0.5f, 20), geometryPool);
     // Camera setup
     camera.position = glm::vec3(0.0f, 10.0f, 20.0f);
     camera.target = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -641,22 +749,22 @@ int main() {
     // Create a framebuffer for deferred lighting output
     framebuffer.width = screenWidth;
     framebuffer.height = screenHeight;
-    glGenFramebuffers(1, &framebuffer.fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+    framebuffer.fbo = ew::Framebuffer::create();
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo.get());
 
     // Create color attachment
-    glGenTextures(1, &framebuffer.color0);
-    glBindTexture(GL_TEXTURE_2D, framebuffer.color0);
+    framebuffer.color0 = ew::Texture::create();
+    glBindTexture(GL_TEXTURE_2D, framebuffer.color0.get());
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, framebuffer.width, framebuffer.height, 0, GL_RGBA, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebuffer.color0, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebuffer.color0.get(), 0);
 
     // Create depth attachment
-    glGenRenderbuffers(1, &framebuffer.depth);
-    glBindRenderbuffer(GL_RENDERBUFFER, framebuffer.depth);
+    framebuffer.depthRenderbuffer = ew::Renderbuffer::create();
+    glBindRenderbuffer(GL_RENDERBUFFER, framebuffer.depthRenderbuffer.get());
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, framebuffer.width, framebuffer.height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebuffer.depth);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebuffer.depthRenderbuffer.get());
 
     // Check framebuffer completeness
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
@@ -665,19 +773,33 @@ int main() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // Create ground plane
-    ew::Mesh plane = ew::createPlane(30, 30, 10);
+    ew::Mesh plane = ew::Mesh(ew::createPlane(30, 30, 10), geometryPool);
     planeTransform.position = glm::vec3(0.0f, -5.0f, -5.0f);
 
+    // Transform i is monkey i, the plane comes last. Monkeys are indexed by the box around their sphere,
+    // which turning in place never changes.
+    const unsigned int planeIndex = (unsigned int)monkeyTransforms.size();
+    const glm::vec4 monkeySphere = monkeyModel.getBoundingSphere();
+    for (size_t i = 0; i < monkeyTransforms.size(); i++) {
+        glm::vec4 sphere = ew::transformSphere(monkeySphere, monkeyTransforms[i]);
+        monkeyProxies.push_back(sceneTree.insert(glm::vec3(sphere) - glm::vec3(sphere.w), glm::vec3(sphere) + glm::vec3(sphere.w), (unsigned int)i));
+    }
+    glm::vec3 planeMin, planeMax;
+    ew::transformBox(plane.getBoundsMin(), plane.getBoundsMax(), planeTransform.modelMatrix(), planeMin, planeMax);
+    sceneTree.insert(planeMin, planeMax, planeIndex);
+
     // Create fullscreen quad (using a single triangle that covers the screen)
-    GLuint dummyVAO;
-    glGenVertexArrays(1, &dummyVAO);
+    ew::VertexArray dummyVAO = ew::VertexArray::create();
 
     // Distribute point lights
     distributePointLights();
 
+    glState.setEnabled(true);
+
     // Main render loop
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
+        glState.beginFrame();
 
         float time = (float)glfwGetTime();
         deltaTime = time - prevFrameTime;
@@ -686,39 +808,129 @@ int main() {
         // Camera movement
         cameraController.move(window, &camera, deltaTime);
 
-        // Update monkey rotations
-        for (size_t i = 0; i < monkeyTransforms.size(); i++) {
-            // Alternate rotation directions based on position in grid
-            float rotationDirection = ((i % 2) == 0) ? 1.0f : -1.0f;
+        // Rotate the monkeys and build their matrices and bounds on the job system,
+        // each range only writes its own monkeys so they need no locking
+        instanceScratch.resize(monkeyTransforms.size() + 1);
+        monkeySpheres.resize(monkeyTransforms.size());
+        ew::jobs::parallelFor(0, (int)monkeyTransforms.size(), [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                // Alternate rotation directions based on position in grid
+                float rotationDirection = ((i % 2) == 0) ? 1.0f : -1.0f;
+
+                monkeyTransforms[i].rotation = glm::rotate(
+                    monkeyTransforms[i].rotation,
+                    deltaTime * rotationDirection,
+                    glm::vec3(0.0f, 1.0f, 0.0f)
+                );
+                instanceScratch[i].model = monkeyTransforms[i].modelMatrix();
+                monkeySpheres[i] = ew::transformSphere(monkeySphere, monkeyTransforms[i]);
+            }
+        }, 256);
+
+        // Upload this frame's matrices, every pass below draws from the same buffer
+        instanceScratch.back().model = planeTransform.modelMatrix();
+        sceneTransforms.upload(instanceScratch);
+
+        glm::mat4 view = camera.viewMatrix();
+        glm::mat4 lightSpaceMatrix = calculateLightSpaceMatrix();
+        if (gpuCulling) {
+            // Queue everything once, the cull pass below decides what gets drawn and only the transforms change.
+            // Survivors of a mesh are packed in the order the GPU finds them, so there is no point sorting by depth
+            if (!gpuQueuesFilled) {
+                sceneQueue.clear();
+                shadowQueue.clear();
+                for (size_t i = 0; i < monkeyTransforms.size(); i++) {
+                    sceneQueue.add(monkeyModel, (unsigned int)i);
+                    shadowQueue.add(monkeyModel, (unsigned int)i);
+                }
+                sceneQueue.add(plane, planeIndex);
+                shadowQueue.add(plane, planeIndex);
+                gpuQueuesFilled = true;
+            }
+
+            // The transforms the cull shader reads are the ones the passes draw with
+            sceneTransforms.bind();
+            ew::GpuCullSettings sceneCull;
+            sceneCull.frustum = ew::Frustum(camera);
+            sceneCull.hiZ = &hiZ;
+            sceneCull.hiZViewProjection = hiZViewProjection;
+            sceneQueue.cull(cullShader, sceneCull);
+            // The shadow map has no pyramid of its own, only the light's box culls casters
+            ew::GpuCullSettings shadowCull;
+            shadowCull.frustum = ew::Frustum(lightSpaceMatrix);
+            shadowQueue.cull(cullShader, shadowCull);
+        }
+        else {
+            // The pyramid stops following the camera, it must not cull anything once GPU culling is back on
+            hiZ.invalidate();
+            gpuQueuesFilled = false;
+
+            // Only monkeys that left the margin around their old box get reinserted
+            for (size_t i = 0; i < monkeySpheres.size(); i++) {
+                glm::vec3 center = glm::vec3(monkeySpheres[i]);
+                sceneTree.update(monkeyProxies[i], center - glm::vec3(monkeySpheres[i].w), center + glm::vec3(monkeySpheres[i].w));
+            }
 
-            monkeyTransforms[i].rotation = glm::rotate(
-                monkeyTransforms[i].rotation,
-                deltaTime * rotationDirection,
-                glm::vec3(0.0f, 1.0f, 0.0f)
-            );
+            // Requeue what the camera sees so the monkeys go front to back for early depth rejection
+            numSphereCulled = 0;
+            ew::Frustum cameraFrustum(camera);
+            sceneQuery.clear();
+            sceneTree.queryFrustum(cameraFrustum, sceneQuery);
+            cullQueryBySphere(cameraFrustum, sceneQuery);
+            sceneQueue.clear();
+            numVisibleMonkeys = 0;
+            for (unsigned int i : sceneQuery) {
+                if (i == planeIndex) {
+                    sceneQueue.add(plane, i);
+                    continue;
+                }
+                float depth = -(view * glm::vec4(monkeyTransforms[i].position, 1.0f)).z;
+                sceneQueue.add(monkeyModel, i, 0, ew::quantizeDepth(depth, camera.nearPlane, camera.farPlane));
+                numVisibleMonkeys++;
+            }
+
+            // Shadow casters are whatever is inside the light's box, seen by the camera or not
+            ew::Frustum lightFrustum(lightSpaceMatrix);
+            sceneQuery.clear();
+            sceneTree.queryFrustum(lightFrustum, sceneQuery);
+            cullQueryBySphere(lightFrustum, sceneQuery);
+            shadowQueue.clear();
+            for (unsigned int i : sceneQuery) {
+                if (i == planeIndex) {
+                    shadowQueue.add(plane, i);
+                }
+                else {
+                    shadowQueue.add(monkeyModel, i);
+                }
+            }
+            numShadowCasters = (int)sceneQuery.size();
         }
 
         // 1. Render scene to G-Buffer
-        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.fbo);
-        glViewport(0, 0, gBuffer.width, gBuffer.height);
+        glState.bindFramebuffer(gBuffer.fbo.get());
+        glState.setViewport(0, 0, gBuffer.width, gBuffer.height);
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+        glState.setCullFace(true, ew::CullFace::BACK);
 
         gBufferShader.use();
         gBufferShader.setInt("_MainTexture", 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, brickTexture);
-        drawScene(camera, gBufferShader, monkeyModel, plane);
+        glState.bindTexture(0, brickTexture.get());
+        drawScene(camera, gBufferShader);
+
+        // Next frame culls against this frame's depth
+        if (gpuCulling) {
+            hiZ.build(hiZShader, gBuffer.depth.get(), gBuffer.width, gBuffer.height);
+            hiZViewProjection = camera.projectionMatrix() * view;
+        }
 
         // 2. Render depth map from light's perspective
-        renderShadowMap(depthShader, monkeyModel, plane);
+        renderShadowMap(depthShader);
 
         // 3. LIGHTING PASS - Apply deferred lighting using G-Buffer data
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
-        glViewport(0, 0, framebuffer.width, framebuffer.height);
+        glState.bindFramebuffer(framebuffer.fbo.get());
+        glState.setViewport(0, 0, framebuffer.width, framebuffer.height);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         deferredShader.use();
@@ -758,28 +970,27 @@ int main() {
             deferredShader.setVec4(prefix + "color", pointLights[i].color);
         }
 
-        glBindTextureUnit(0, gBuffer.colorBuffers[0]);  // Position
-        glBindTextureUnit(1, gBuffer.colorBuffers[1]);  // Normal
-        glBindTextureUnit(2, gBuffer.colorBuffers[2]);  // Albedo
-        glBindTextureUnit(3, shadowMap.depthTexture);   // Shadow map
+        glState.bindTexture(0, gBuffer.colorBuffers[0].get());  // Position
+        glState.bindTexture(1, gBuffer.colorBuffers[1].get());  // Normal
+        glState.bindTexture(2, gBuffer.colorBuffers[2].get());  // Albedo
+        glState.bindTexture(3, shadowMap.depthTexture.get());   // Shadow map
 
         // Draw fullscreen triangle
-        glBindVertexArray(dummyVAO);
+        glState.bindVertexArray(dummyVAO.get());
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
         // 4. Handle visualization modes (NEW)
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0, 0, screenWidth, screenHeight);
+        glState.bindFramebuffer(0);
+        glState.setViewport(0, 0, screenWidth, screenHeight);
         glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Choose what to display based on current visualization mode
         switch (currentVisualizationMode) {
         case VisualizationMode::FINAL_RENDER:
-            // Blit the final image from the lighting pass to the default framebuffer
-            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.fbo);
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-            glBlitFramebuffer(
+            // Blit the final image from the lighting pass to the default framebuffer, without rebinding either
+            glBlitNamedFramebuffer(
+                framebuffer.fbo.get(), 0,
                 0, 0, framebuffer.width, framebuffer.height,
                 0, 0, screenWidth, screenHeight,
                 GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST
@@ -788,28 +999,28 @@ int main() {
             // Draw light orbs when in final render mode
             if (currentVisualizationMode == VisualizationMode::FINAL_RENDER ||
                 currentVisualizationMode == VisualizationMode::LIGHT_VISUALIZATION) {
-                drawLights(lightOrbShader, sphereMesh);
+                drawLights(lightOrbInstancedShader, sphereMesh, 0.1f, 1.0f);
             }
             break;
 
         case VisualizationMode::POSITION_BUFFER:
             // Draw the position buffer
-            drawDebugView(debugViewShader, gBuffer.colorBuffers[0]);
+            drawDebugView(debugViewShader, gBuffer.colorBuffers[0].get());
             break;
 
         case VisualizationMode::NORMAL_BUFFER:
             // Draw the normal buffer
-            drawDebugView(debugViewShader, gBuffer.colorBuffers[1]);
+            drawDebugView(debugViewShader, gBuffer.colorBuffers[1].get());
             break;
 
         case VisualizationMode::ALBEDO_BUFFER:
             // Draw the albedo buffer
-            drawDebugView(debugViewShader, gBuffer.colorBuffers[2]);
+            drawDebugView(debugViewShader, gBuffer.colorBuffers[2].get());
             break;
 
         case VisualizationMode::SHADOW_MAP:
             // Draw the shadow map
-            drawDebugView(debugViewShader, shadowMap.depthTexture);
+            drawDebugView(debugViewShader, shadowMap.depthTexture.get());
             break;
 
         case VisualizationMode::LIGHT_VISUALIZATION:
@@ -818,9 +1029,9 @@ int main() {
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             // Use blending for additive light effects
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-            glDisable(GL_DEPTH_TEST); // No depth testing for pure light viz
+            glState.setBlend(true);
+            glState.setBlendFunc(GL_SRC_ALPHA, GL_ONE);
+            glState.setDepthTest(false); // No depth testing for pure light viz
 
             // Draw the light orbs with more intensity
             lightOrbShader.use();
@@ -835,21 +1046,12 @@ int main() {
             lightOrbShader.setVec3("_Color", directionalLight.color * 2.0f); // Make it brighter
             sphereMesh.draw();
 
-            // Draw all active point lights with exaggerated brightness
-            for (int i = 0; i < currentPointLightCount; i++) {
-                glm::mat4 model = glm::translate(glm::mat4(1.0f), pointLights[i].position);
-                model = glm::scale(model, glm::vec3(pointLights[i].radius * 0.3f)); // Bigger for visualization
-
-                lightOrbShader.setMat4("_Model", model);
-                glm::vec3 lightColor = glm::vec3(pointLights[i].color) * 3.0f; // Exaggerate brightness
-                lightOrbShader.setVec3("_Color", lightColor);
-
-                sphereMesh.draw();
-            }
+            // Draw all active point lights bigger and with exaggerated brightness
+            drawLights(lightOrbInstancedShader, sphereMesh, 0.3f, 3.0f);
 
             // Restore state
-            glEnable(GL_DEPTH_TEST);
-            glDisable(GL_BLEND);
+            glState.setDepthTest(true);
+            glState.setBlend(false);
             break;
         }
 
@@ -861,7 +1063,7 @@ int main() {
     }
 
     // Cleanup
-    glDeleteVertexArrays(1, &dummyVAO);
+    sphereMesh = ew::Mesh(); // Gives its range back before the pool goes away
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -18,10 +18,17 @@
 #include <ew/cameraController.h>
 #include <ew/texture.h>
 #include <ew/mesh.h>
+#include <ew/meshOptimizer.h>
+#include <ew/glResource.h>
 #include <vector>
 #include <string>
+#include <functional>
+#include <memory>
 
 #include "dh/heightMap.h"
+#include "dh/heightmapImage.h"
+#include "dh/filters.h"
+#include "dh/backgroundBuilder.h"
 
 // Global state
 int screenWidth = 1080;
@@ -36,7 +43,6 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 GLFWwindow* initWindow(const char* title, int width, int height);
 void drawUI();
 void loadSelectedHeightmap();
-std::vector<float> blurHeightmapData(const std::vector<float>& data, int width, int height, int radius);
 // Camera and transforms
 ew::Camera camera;
 ew::CameraController cameraController;
@@ -50,7 +56,6 @@ struct HeightmapFile {
 // Heightmap settings
 struct HeightmapSettings {
     glm::vec3 scale = glm::vec3(100.0f, 20.0f, 100.0f);
-    GLuint texture = 0;
     bool wireframe = false;
     float ambientStrength = 0.3f;
     glm::vec3 lightDir = glm::normalize(glm::vec3(1.0f, -1.0f, 1.0f));
@@ -80,11 +85,29 @@ std::vector<HeightmapFile> heightmapFiles = {
 // Current selected heightmap path
 std::string currentHeightmapPath = "assets/Textures/northamericaHeightMap.png";
 
-// Mesh and dimensions
+// Mesh, height texture and dimensions
 ew::Mesh heightmapMesh;
+ew::Texture heightmapTexture;
 int heightmapWidth = 0;
 int heightmapHeight = 0;
 
+// CPU side of a heightmap rebuild, made on the loader thread and uploaded on the GL thread
+// The mesh is built in normalized space, scale is applied through _Model so it never needs a rebuild.
+struct HeightmapBuild {
+    std::string path;
+    int blurRadius = 0;                                     // 0 when the heights are unfiltered
+    std::shared_ptr<const dh::HeightmapImage> image;        // Reused while the path stays the same
+    std::shared_ptr<const std::vector<float>> heights;      // Reused while the blur stays the same too
+    ew::MeshData mesh;
+};
+
+// Decodes, filters and meshes off the render loop. Newer requests cancel older ones.
+dh::BackgroundBuilder<HeightmapBuild> heightmapBuilder;
+// Height sources of the applied build, the next rebuild starts from them
+HeightmapBuild loadedHeightmap;
+bool buildHeightmap(const std::string& path, const HeightmapSettings& settings, const HeightmapBuild& previous, HeightmapBuild& build, const std::function<bool()>& isCancelled);
+void applyHeightmap(HeightmapBuild& build);
+
 // Helper Functions
 void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
     camera->position = glm::vec3(0, 50.0f, 50.0f);
@@ -93,94 +116,108 @@ void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
     controller->pitch = -45.0f;
 }
 
-std::vector<float> blurHeightmapData(const std::vector<float>& data, int width, int height, int radius) {
-    std::vector<float> result(data.size(), 0.0f);
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            float sum = 0.0f;
-            int count = 0;
-            // Box blur kernel
-            for (int ky = -radius; ky <= radius; ++ky) {
-                for (int kx = -radius; kx <= radius; ++kx) {
-                    int sx = x + kx;
-                    int sy = y + ky;
-
-                    // Check boundaries
-                    if (sx >= 0 && sx < width && sy >= 0 && sy < height) {
-                        sum += data[sy * width + sx];
-                        count++;
-                    }
-                }
-            }
-            // Average
-            result[y * width + x] = sum / count;
-        }
-    }
-    return result;
-}
+bool buildHeightmap(const std::string& path, const HeightmapSettings& settings, const HeightmapBuild& previous, HeightmapBuild& build, const std::function<bool()>& isCancelled) {
+    build.path = path;
+    build.blurRadius = settings.useBlur ? settings.blurRadius : 0;
 
-void loadSelectedHeightmap() {
-    // Update the current heightmap path
-    currentHeightmapPath = heightmapFiles[heightmapSettings.selectedHeightmap].path;
-    std::printf("\n==== Loading heightmap: %s ====\n", currentHeightmapPath.c_str());
-
-    // Clean up previous texture
-    if (heightmapSettings.texture) {
-        glDeleteTextures(1, &heightmapSettings.texture);
-        heightmapSettings.texture = 0;
+    // Only decode again for a different map
+    if (previous.image && previous.path == path) {
+        build.image = previous.image;
     }
-
-    // First get dimensions
-    if (!dh::getHeightmapDimensions(currentHeightmapPath.c_str(), heightmapWidth, heightmapHeight)) {
-        std::printf("ERROR: Failed to get dimensions\n");
-        return;
+    else {
+        std::shared_ptr<dh::HeightmapImage> image = std::make_shared<dh::HeightmapImage>();
+        if (!image->load(path.c_str(), true)) {
+            std::printf("ERROR: Failed to load height data\n");
+            return false;
+        }
+        build.image = image;
     }
 
-    std::printf("Dimensions: %dx%d\n", heightmapWidth, heightmapHeight);
+    int width = build.image->getWidth();
+    int height = build.image->getHeight();
+    std::printf("Dimensions: %dx%d\n", width, height);
 
     // Check for extreme dimensions that might cause issues
-    if (heightmapWidth > 4096 || heightmapHeight > 4096) {
+    if (width > 4096 || height > 4096) {
         std::printf("WARNING: Very large heightmap detected. Performance may be impacted.\n");
     }
 
-    if (heightmapWidth < 16 || heightmapHeight < 16) {
+    if (width < 16 || height < 16) {
         std::printf("WARNING: Very small heightmap detected. Quality may be poor.\n");
     }
 
-    // Load the height data
-    std::vector<float> heightData = dh::loadHeightmapData(currentHeightmapPath.c_str(), true);
-
-    // Verify data
-    if (heightData.empty()) {
-        std::printf("ERROR: Failed to load height data\n");
-        return;
+    // Apply blur if needed, unfiltered heights share the decoded image's storage
+    if (previous.heights && previous.image == build.image && previous.blurRadius == build.blurRadius) {
+        build.heights = previous.heights;
     }
-
-    if (heightData.size() != (size_t)(heightmapWidth * heightmapHeight)) {
-        std::printf("ERROR: Data size mismatch! Expected: %d, Got: %zu\n",
-            heightmapWidth * heightmapHeight, heightData.size());
-        return;
+    else if (build.blurRadius > 0) {
+        if (isCancelled()) {
+            return false;
+        }
+        std::printf("Applying blur with radius %d\n", build.blurRadius);
+        build.heights = std::make_shared<const std::vector<float>>(
+            dh::filters::boxBlur(build.image->getHeights(), width, height, build.blurRadius));
     }
-
-    // Apply blur if needed
-    if (heightmapSettings.useBlur && heightmapSettings.blurRadius > 0) {
-        std::printf("Applying blur with radius %d\n", heightmapSettings.blurRadius);
-        heightData = blurHeightmapData(heightData, heightmapWidth, heightmapHeight, heightmapSettings.blurRadius);
+    else {
+        build.heights = std::shared_ptr<const std::vector<float>>(build.image, &build.image->getHeights());
     }
 
     // Create the mesh
+    if (isCancelled()) {
+        return false;
+    }
     std::printf("Creating mesh...\n");
-    heightmapMesh = dh::createHeightmapMesh(heightData, heightmapWidth, heightmapHeight, heightmapSettings.scale);
+    build.mesh = dh::createHeightmapMeshData(*build.heights, width, height);
+    if (build.mesh.vertices.empty() || isCancelled()) {
+        return false;
+    }
+
+    // Scanline grids miss the vertex cache on almost every row, reorder while still off the render loop
+    ew::MeshOptimizeStats stats = ew::optimizeMesh(build.mesh);
+    std::printf("Optimized mesh: ACMR %.3f -> %.3f\n", stats.acmrBefore, stats.acmrAfter);
+    return true;
+}
+
+void applyHeightmap(HeightmapBuild& build) {
+    // Swap in the new mesh, the old one kept drawing until now
+    std::printf("Uploading mesh...\n");
+    // Heightmap meshes get big, quantized positions and packed normals keep them at 20 bytes a vertex
+    heightmapMesh.load(build.mesh, false, ew::VertexFormat::compact());
+    build.mesh = ew::MeshData();
 
-    // Load the texture for visualization
-    std::printf("Loading texture...\n");
-    heightmapSettings.texture = ew::loadTexture(currentHeightmapPath.c_str());
+    // Upload the same heights the mesh was built from as a single channel texture, only when they changed
+    if (build.heights != loadedHeightmap.heights || !heightmapTexture) {
+        heightmapTexture.reset();
 
-    if (heightmapSettings.texture == 0) {
-        std::printf("WARNING: Failed to load texture\n");
+        std::printf("Uploading texture...\n");
+        heightmapTexture = dh::createHeightTexture(*build.heights, build.image->getWidth(), build.image->getHeight());
+
+        if (!heightmapTexture) {
+            std::printf("WARNING: Failed to load texture\n");
+        }
     }
 
-    std::printf("Heightmap loaded successfully\n");
+    currentHeightmapPath = build.path;
+    heightmapWidth = build.image->getWidth();
+    heightmapHeight = build.image->getHeight();
+    loadedHeightmap = std::move(build);
+    std::printf("Heightmap loaded successfully: %s\n", currentHeightmapPath.c_str());
+}
+
+void loadSelectedHeightmap() {
+    // The worker gets its own copy of the settings and sources, the UI keeps editing the globals
+    std::string path = heightmapFiles[heightmapSettings.selectedHeightmap].path;
+    HeightmapSettings settings = heightmapSettings;
+    HeightmapBuild previous;
+    previous.path = loadedHeightmap.path;
+    previous.blurRadius = loadedHeightmap.blurRadius;
+    previous.image = loadedHeightmap.image;
+    previous.heights = loadedHeightmap.heights;
+    std::printf("\n==== Loading heightmap: %s ====\n", path.c_str());
+
+    heightmapBuilder.request([path, settings, previous](HeightmapBuild& build, const std::function<bool()>& isCancelled) {
+        return buildHeightmap(path, settings, previous, build, isCancelled);
+    });
 }
 void drawUI() {
     ImGui_ImplGlfw_NewFrame();
@@ -269,8 +306,17 @@ void drawUI() {
     }
 
     ImGui::Text("Heightmap: %dx%d", heightmapWidth, heightmapHeight);
+    if (heightmapBuilder.isBusy()) {
+        ImGui::Text("Rebuilding mesh...");
+    }
     ImGui::Text("Frame Time: %.2f ms", deltaTime * 1000.0f);
     ImGui::Text("FPS: %.1f", 1.0f / deltaTime);
+#ifndef NDEBUG
+    // Live GL objects, these should settle back after switching heightmaps
+    for (int i = 0; i < (int)ew::GLObjectType::COUNT; i++) {
+        ImGui::Text("%s: %d", ew::getGLObjectTypeName((ew::GLObjectType)i), ew::getNumLiveGLObjects((ew::GLObjectType)i));
+    }
+#endif
 
     ImGui::End();
 
@@ -336,13 +382,23 @@ int main() {
     camera.fov = 60.0f;
     resetCamera(&camera, &cameraController);
 
-    // Load the initial heightmap
+    // Load the initial heightmap, waiting for it so the first frames have something to draw
     loadSelectedHeightmap();
+    HeightmapBuild initialBuild;
+    if (heightmapBuilder.wait(initialBuild)) {
+        applyHeightmap(initialBuild);
+    }
 
     // Main render loop
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
 
+        // Swap in a finished heightmap rebuild
+        HeightmapBuild finishedBuild;
+        if (heightmapBuilder.poll(finishedBuild)) {
+            applyHeightmap(finishedBuild);
+        }
+
         float time = (float)glfwGetTime();
         deltaTime = time - prevFrameTime;
         prevFrameTime = time;
@@ -365,7 +421,7 @@ int main() {
         // Set shader uniforms
         heightmapShader.use();
         heightmapShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-        heightmapShader.setMat4("_Model", glm::mat4(1.0f)); // Identity matrix
+        heightmapShader.setMat4("_Model", glm::scale(glm::mat4(1.0f), heightmapSettings.scale) * heightmapMesh.getPositionDecode()); // Mesh is in normalized space
         heightmapShader.setInt("_HeightmapTexture", 0);
 
 		heightmapShader.setVec3("_CameraPos", camera.position);
@@ -393,7 +449,7 @@ int main() {
 
         // Bind the texture
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, heightmapSettings.texture);
+        glBindTexture(GL_TEXTURE_2D, heightmapTexture.get());
 
         // Render the heightmap
         heightmapMesh.draw();
@@ -405,9 +461,6 @@ int main() {
         glfwSwapBuffers(window);
     }
 
-    // Cleanup
-    glDeleteTextures(1, &heightmapSettings.texture);
-
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -0,0 +1,131 @@
+#pragma once
+#include "../ew/jobs.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace dh {
+
+    // Runs rebuild jobs on one worker thread, for work like decoding and meshing that must not
+    // stall the render loop. Their parallel loops still go to the job system. A new request supersedes
+    // every job that hasn't finished: a queued one is dropped, and a running one sees isCancelled()
+    // return true so it can stop early.
+    // Results are handed back through poll() on the GL thread, where they get uploaded.
+    template<typename Result>
+    class BackgroundBuilder {
+    public:
+        // Fills in the result and returns true, or returns false if it failed or was cancelled
+        using Job = std::function<bool(Result& result, const std::function<bool()>& isCancelled)>;
+
+        BackgroundBuilder() {};
+        BackgroundBuilder(const BackgroundBuilder&) = delete;
+        BackgroundBuilder& operator=(const BackgroundBuilder&) = delete;
+        ~BackgroundBuilder()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+                m_generation++;
+            }
+            m_wake.notify_all();
+            if (m_worker.joinable()) {
+                m_worker.join();
+            }
+        }
+
+        void request(Job job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_pending = std::move(job);
+                m_generation++;
+                m_hasResult = false;
+                if (!m_worker.joinable()) {
+                    m_worker = std::thread(&BackgroundBuilder::run, this);
+                }
+            }
+            m_wake.notify_all();
+        }
+
+        // Moves out the result of the latest request once it has finished successfully
+        bool poll(Result& result)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_hasResult) {
+                return false;
+            }
+            result = std::move(m_result);
+            m_result = Result();
+            m_hasResult = false;
+            return true;
+        }
+
+        // Blocks until the latest request is done, then polls it. Runs the build's jobs
+        // in the meantime instead of sleeping through it.
+        bool wait(Result& result)
+        {
+            while (isBusy()) {
+                if (!ew::jobs::runPendingJob()) {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_idle.wait_for(lock, std::chrono::milliseconds(1), [this]() { return !m_pending && !m_running; });
+                }
+            }
+            return poll(result);
+        }
+
+        inline bool isBusy() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_pending || m_running;
+        }
+
+    private:
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true) {
+                m_wake.wait(lock, [this]() { return m_stopping || m_pending; });
+                if (m_stopping) {
+                    return;
+                }
+
+                Job job = std::move(m_pending);
+                m_pending = nullptr;
+                unsigned int generation = m_generation;
+                m_running = true;
+                lock.unlock();
+
+                // Only the mutex guards the counter, reading it is cheap next to the work between checks
+                std::function<bool()> isCancelled = [this, generation]() {
+                    std::lock_guard<std::mutex> cancelLock(m_mutex);
+                    return m_generation != generation;
+                };
+                Result result;
+                bool succeeded = job(result, isCancelled);
+
+                lock.lock();
+                m_running = false;
+                if (succeeded && m_generation == generation) {
+                    m_result = std::move(result);
+                    m_hasResult = true;
+                }
+                if (!m_pending) {
+                    m_idle.notify_all();
+                }
+            }
+        }
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_idle;
+        std::thread m_worker;
+        Job m_pending;
+        Result m_result;
+        unsigned int m_generation = 0;
+        bool m_running = false;
+        bool m_hasResult = false;
+        bool m_stopping = false;
+    };
+}
@@ -0,0 +1,150 @@
+#include "filters.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace dh {
+    namespace filters {
+
+        // Window sums are kept in double so the running add/subtract doesn't drift across long rows
+        static void blurRow(const float* in, float* out, int width, int radius) {
+            double sum = 0.0;
+            for (int x = 0; x < std::min(radius, width); x++) {
+                sum += in[x];
+            }
+            for (int x = 0; x < width; x++) {
+                if (x + radius < width) {
+                    sum += in[x + radius];
+                }
+                if (x - radius - 1 >= 0) {
+                    sum -= in[x - radius - 1];
+                }
+                int count = std::min(x + radius, width - 1) - std::max(x - radius, 0) + 1;
+                out[x] = static_cast<float>(sum / count);
+            }
+        }
+
+        // Fixed radii unroll to a handful of taps, only the clamped ends need the general path
+        template<int Radius>
+        static void blurRowFixed(const float* in, float* out, int width) {
+            if (width <= 2 * Radius) {
+                blurRow(in, out, width, Radius);
+                return;
+            }
+            const float scale = 1.0f / (2 * Radius + 1);
+            for (int x = 0; x < Radius; x++) {
+                float sum = 0.0f;
+                for (int k = 0; k <= x + Radius; k++) {
+                    sum += in[k];
+                }
+                out[x] = sum / (x + Radius + 1);
+            }
+            for (int x = Radius; x < width - Radius; x++) {
+                float sum = 0.0f;
+                for (int k = -Radius; k <= Radius; k++) {
+                    sum += in[x + k];
+                }
+                out[x] = sum * scale;
+            }
+            for (int x = width - Radius; x < width; x++) {
+                float sum = 0.0f;
+                for (int k = x - Radius; k < width; k++) {
+                    sum += in[k];
+                }
+                out[x] = sum / (width - x + Radius);
+            }
+        }
+
+        static void blurRows(const float* in, float* out, int width, int height, int radius) {
+            parallelFor(0, height, [=](int yBegin, int yEnd) {
+                for (int y = yBegin; y < yEnd; y++) {
+                    const float* row = in + (size_t)y * width;
+                    float* result = out + (size_t)y * width;
+                    switch (radius) {
+                    case 1: blurRowFixed<1>(row, result, width); break;
+                    case 2: blurRowFixed<2>(row, result, width); break;
+                    case 3: blurRowFixed<3>(row, result, width); break;
+                    case 4: blurRowFixed<4>(row, result, width); break;
+                    default: blurRow(row, result, width, radius); break;
+                    }
+                }
+            }, 16);
+        }
+
+        // Slides the window down a band of columns a whole row at a time, so every read is contiguous
+        static void blurColumns(const float* in, float* out, int width, int height, int radius) {
+            parallelFor(0, width, [=](int xBegin, int xEnd) {
+                int bandWidth = xEnd - xBegin;
+                std::vector<double> sums(bandWidth, 0.0);
+                auto addRow = [&](int y, double sign) {
+                    const float* row = in + (size_t)y * width + xBegin;
+                    for (int i = 0; i < bandWidth; i++) {
+                        sums[i] += sign * row[i];
+                    }
+                };
+
+                for (int y = 0; y < std::min(radius, height); y++) {
+                    addRow(y, 1.0);
+                }
+                for (int y = 0; y < height; y++) {
+                    if (y + radius < height) {
+                        addRow(y + radius, 1.0);
+                    }
+                    if (y - radius - 1 >= 0) {
+                        addRow(y - radius - 1, -1.0);
+                    }
+                    double scale = 1.0 / (std::min(y + radius, height - 1) - std::max(y - radius, 0) + 1);
+                    float* result = out + (size_t)y * width + xBegin;
+                    for (int i = 0; i < bandWidth; i++) {
+                        result[i] = static_cast<float>(sums[i] * scale);
+                    }
+                }
+            }, 64);
+        }
+
+        std::vector<float> boxBlur(const std::vector<float>& data, int width, int height, int radius) {
+            if (data.size() != (size_t)width * height || data.empty()) {
+                std::printf("ERROR in boxBlur: Data size (%zu) doesn't match dimensions (%d x %d)\n",
+                    data.size(), width, height);
+                return data;
+            }
+            if (radius <= 0) {
+                return data;
+            }
+
+            // The window is clamped to the map on each axis independently, so the 2D mean
+            // is exactly a horizontal mean followed by a vertical one
+            std::vector<float> rows(data.size());
+            std::vector<float> result(data.size());
+            blurRows(data.data(), rows.data(), width, height, radius);
+            blurColumns(rows.data(), result.data(), width, height, radius);
+            return result;
+        }
+
+        std::vector<float> gaussianBlur(const std::vector<float>& data, int width, int height, float sigma) {
+            if (sigma <= 0.0f) {
+                return data;
+            }
+
+            // Box radii whose three passes add up to the Gaussian's variance (Kovesi)
+            const int numPasses = 3;
+            float idealWidth = std::sqrt(12.0f * sigma * sigma / numPasses + 1.0f);
+            int lowerWidth = (int)std::floor(idealWidth);
+            if (lowerWidth % 2 == 0) {
+                lowerWidth--;
+            }
+            int upperWidth = lowerWidth + 2;
+            float idealLower = (12.0f * sigma * sigma - numPasses * lowerWidth * lowerWidth - 4.0f * numPasses * lowerWidth - 3.0f * numPasses)
+                / (-4.0f * lowerWidth - 4.0f);
+            int numLower = (int)std::round(idealLower);
+
+            std::vector<float> result = data;
+            for (int pass = 0; pass < numPasses; pass++) {
+                int boxWidth = pass < numLower ? lowerWidth : upperWidth;
+                result = boxBlur(result, width, height, (boxWidth - 1) / 2);
+            }
+            return result;
+        }
+    }
+}
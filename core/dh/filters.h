@@ -0,0 +1,14 @@
+#pragma once
+#include <vector>
+
+namespace dh {
+    namespace filters {
+
+        // Mean of the in-bounds samples in the (2 * radius + 1) square around each sample. Runs as
+        // two separable sliding-window passes, so the cost per sample doesn't depend on the radius.
+        std::vector<float> boxBlur(const std::vector<float>& data, int width, int height, int radius);
+
+        // Approximates a Gaussian with standard deviation sigma by three box blurs
+        std::vector<float> gaussianBlur(const std::vector<float>& data, int width, int height, float sigma);
+    }
+}
@@ -9,6 +9,17 @@ namespace dh {
    
     bool getHeightmapDimensions(const char* filePath, int& width, int& height);
 
+    // Whether this build has the AVX2 normal kernel and the CPU can run it
+    bool isHeightmapAvx2Supported();
+    // Falls back to the scalar normals even where AVX2 is supported, for comparing the two. On by default
+    void setHeightmapAvx2Enabled(bool enabled);
+
+    // Builds the vertices and indices on all cores without touching GL
+    ew::MeshData createHeightmapMeshData(const std::vector<float>& heightmapData,
+        int width,
+        int height,
+        glm::vec3 scale = glm::vec3(1.0f));
+
     ew::Mesh createHeightmapMesh(const std::vector<float>& heightmapData,
         int width,
         int height,
@@ -1,171 +1,195 @@
 
 #include "heightmap.h"
+#include "heightmapImage.h"
+#include "parallel.h"
+#include "heightmapAvx2.h"
 #include "../ew/external/glad.h"
 #include "../ew/external/stb_image.h"
-#include "../ew/texture.h"
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#if defined(DH_HEIGHTMAP_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
 
 namespace dh {
 
+#if defined(DH_HEIGHTMAP_AVX2)
+    static bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        // AVX needs the OS to save the ymm registers too
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5));
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    static std::atomic<bool> avx2Enabled(true);
+
+    bool isHeightmapAvx2Supported() {
+#if defined(DH_HEIGHTMAP_AVX2)
+        static const bool supported = cpuHasAvx2();
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    void setHeightmapAvx2Enabled(bool enabled) {
+        avx2Enabled = enabled;
+    }
+
     bool getHeightmapDimensions(const char* filePath, int& width, int& height) {
+        // Only parses the header, the pixels are not decoded
         int channels;
-        unsigned char* data = stbi_load(filePath, &width, &height, &channels, 0);
-
-        if (data == nullptr) {
+        if (!stbi_info(filePath, &width, &height, &channels)) {
             std::printf("Failed to load heightmap image %s\n", filePath);
             return false;
         }
-
-        stbi_image_free(data);
         return true;
     }
 
     std::vector<float> loadHeightmapData(const char* filePath, bool normalizeHeight) {
-        int width, height, numComponents;
-        unsigned char* data = stbi_load(filePath, &width, &height, &numComponents, 1);
-
-        if (data == nullptr) {
-            std::printf("Failed to load heightmap image %s\n", filePath);
+        HeightmapImage image;
+        if (!image.load(filePath, normalizeHeight)) {
             return std::vector<float>();
         }
+        return std::move(image.getHeights());
+    }
+    // Fills in a vertex's normal and tangent from the height slopes along x and z.
+    // v grows along +z, which is -cross(normal, tangent), hence the negative sign.
+    static inline void setVertexSlopes(ew::Vertex& vertex, float dhdx, float dhdz, float invLength, float invTangentLength) {
+        vertex.normal = glm::vec3(-dhdx * invLength, invLength, -dhdz * invLength);
+        vertex.tangent = glm::vec4(invTangentLength, dhdx * invTangentLength, 0.0f, -1.0f);
+    }
 
-        std::printf("Loaded heightmap: %s (%dx%d, %d components)\n",
-            filePath, width, height, numComponents);
-
-        // Create height data array
-        std::vector<float> heights(width * height, 0.0f);
-
-        // First pass - collect statistics about the data
-        float minHeight = 255.0f;
-        float maxHeight = 0.0f;
-
-        for (int i = 0; i < width * height; i++) {
-            float h = static_cast<float>(data[i]);
-            heights[i] = h;
+    static inline void setVertexSlopes(ew::Vertex& vertex, float dhdx, float dhdz) {
+        setVertexSlopes(vertex, dhdx, dhdz, 1.0f / std::sqrt(dhdx * dhdx + 1.0f + dhdz * dhdz), 1.0f / std::sqrt(dhdx * dhdx + 1.0f));
+    }
 
-            if (normalizeHeight) {
-                minHeight = std::min(minHeight, h);
-                maxHeight = std::max(maxHeight, h);
-            }
+    // Writes one row of vertices. Normals use central differences at the real sample spacing,
+    // one-sided along the edges of the map, and point up (+Y) in mesh space.
+    static void createHeightmapRow(const float* heights, int width, int height, glm::vec3 scale, int z, ew::Vertex* row) {
+        const float* center = heights + (size_t)z * width;
+        int zd = std::max(z - 1, 0);
+        int zu = std::min(z + 1, height - 1);
+        const float* down = heights + (size_t)zd * width;
+        const float* up = heights + (size_t)zu * width;
+
+        // Turns a height difference into a slope, for a difference two samples wide along x
+        float slopeX = scale.y * (width - 1) / (2.0f * scale.x);
+        float slopeZ = scale.y * (height - 1) / ((zu - zd) * scale.z);
+
+        float v = static_cast<float>(z) / (height - 1);
+        float fz = (v - 0.5f) * scale.z;
+        for (int x = 0; x < width; x++) {
+            float u = static_cast<float>(x) / (width - 1);
+            row[x].pos = glm::vec3((u - 0.5f) * scale.x, center[x] * scale.y, fz);
+            row[x].uv = glm::vec2(u, v);
         }
 
-        // Debug statistics
-        std::printf("Raw height range: min=%f, max=%f\n", minHeight, maxHeight);
-
-        // Apply normalization
-        float range = maxHeight - minHeight;
-        if (normalizeHeight && range > 0.001f) {
-            for (int i = 0; i < width * height; i++) {
-                heights[i] = (heights[i] - minHeight) / range;
+        int x = 1;
+#if defined(DH_HEIGHTMAP_AVX2)
+        if (avx2Enabled && isHeightmapAvx2Supported()) {
+            // Interior columns in chunks, eight at a time
+            const int CHUNK_SIZE = 64;
+            float dhdx[CHUNK_SIZE], dhdz[CHUNK_SIZE], invLength[CHUNK_SIZE], invTangentLength[CHUNK_SIZE];
+            while (x + 8 <= width - 1) {
+                int count = std::min(CHUNK_SIZE, (width - 1 - x) & ~7);
+                computeRowSlopesAvx2(center + x, up + x, down + x, count, slopeX, slopeZ, dhdx, dhdz, invLength, invTangentLength);
+                for (int i = 0; i < count; i++) {
+                    setVertexSlopes(row[x + i], dhdx[i], dhdz[i], invLength[i], invTangentLength[i]);
+                }
+                x += count;
             }
-            std::printf("Normalized heights to 0-1 range\n");
         }
-        else {
-            // Just scale to 0-1
-            for (int i = 0; i < width * height; i++) {
-                heights[i] /= 255.0f;
-            }
-            std::printf("Scaled heights by 1/255\n");
+#endif
+        for (; x < width - 1; x++) {
+            setVertexSlopes(row[x], (center[x + 1] - center[x - 1]) * slopeX, (up[x] - down[x]) * slopeZ);
         }
+        setVertexSlopes(row[0], (center[1] - center[0]) * 2.0f * slopeX, (up[0] - down[0]) * slopeZ);
+        setVertexSlopes(row[width - 1], (center[width - 1] - center[width - 2]) * 2.0f * slopeX, (up[width - 1] - down[width - 1]) * slopeZ);
+    }
 
-        // Detect and report any anomalies
-        int zeroCount = 0;
-        int oneCount = 0;
-        for (int i = 0; i < std::min(10000, (int)heights.size()); i++) {
-            if (heights[i] < 0.001f) zeroCount++;
-            if (heights[i] > 0.999f) oneCount++;
+    ew::MeshData createHeightmapMeshData(const std::vector<float>& heightmapData, int width, int height, glm::vec3 scale) {
+        if (width < 2 || height < 2 || heightmapData.size() != (size_t)width * height) {
+            std::printf("ERROR in createHeightmapMesh: Data size (%zu) doesn't match dimensions (%d x %d)\n",
+                heightmapData.size(), width, height);
+            return ew::MeshData{};
         }
 
-        float zeroPercent = (float)zeroCount / std::min(10000, (int)heights.size()) * 100.0f;
-        float onePercent = (float)oneCount / std::min(10000, (int)heights.size()) * 100.0f;
-
-        std::printf("First 10k samples: %.1f%% near zero, %.1f%% near one\n",
-            zeroPercent, onePercent);
-
-        // Release the image data
-        stbi_image_free(data);
-        return heights;
-    }
-    ew::Mesh createHeightmapMesh(const std::vector<float>& heightmapData, int width, int height, glm::vec3 scale) {
-        if (heightmapData.size() != width * height) {
-            std::printf("ERROR in createHeightmapMesh: Data size (%zu) doesn't match dimensions (%d x %d = %d)\n",
-                heightmapData.size(), width, height, width * height);
-            return ew::Mesh(ew::MeshData{}); // Return empty mesh
+        // Invalid samples would spread into their neighbours' normals, so replace them up front
+        std::atomic<size_t> numInvalid(0);
+        parallelFor(0, height, [&](int zBegin, int zEnd) {
+            size_t count = 0;
+            for (size_t i = (size_t)zBegin * width; i < (size_t)zEnd * width; i++) {
+                count += std::isfinite(heightmapData[i]) ? 0 : 1;
+            }
+            numInvalid += count;
+        }, 256);
+
+        std::vector<float> sanitized;
+        const float* heights = heightmapData.data();
+        if (numInvalid > 0) {
+            std::printf("WARNING: %zu invalid height values replaced with 0\n", numInvalid.load());
+            sanitized = heightmapData;
+            for (float& h : sanitized) {
+                if (!std::isfinite(h)) {
+                    h = 0.0f;
+                }
+            }
+            heights = sanitized.data();
         }
 
-        std::vector<ew::Vertex> vertices;
-        std::vector<unsigned int> indices;
-
-        vertices.reserve(width * height);
-        indices.reserve((width - 1) * (height - 1) * 6);
-
-        for(int z = 0; z < height; z++) {
-            for (int x = 0; x < width; x++) {
-                ew::Vertex vertex;
-
-                size_t index = z * width + x;
-                if (index >= heightmapData.size()) {
-                    std::printf("ERROR: Index out of bounds in createHeightmapMesh: %zu >= %zu\n",
-                        index, heightmapData.size());
+        // Every row writes its own slice of both arrays, so bands of rows need no synchronization
+        ew::MeshData meshData;
+        meshData.vertices.resize((size_t)width * height);
+        meshData.indices.resize((size_t)(width - 1) * (height - 1) * 6);
+        ew::Vertex* vertices = meshData.vertices.data();
+        unsigned int* indices = meshData.indices.data();
+
+        parallelFor(0, height, [&](int zBegin, int zEnd) {
+            for (int z = zBegin; z < zEnd; z++) {
+                createHeightmapRow(heights, width, height, scale, z, vertices + (size_t)z * width);
+                if (z == height - 1) {
                     continue;
                 }
 
-                float heightValue = heightmapData[index];
-                // Ensure height is within a reasonable range
-                if (std::isnan(heightValue) || std::isinf(heightValue)) {
-                    std::printf("WARNING: Invalid height value at (%d,%d)\n", x, z);
-                    heightValue = 0.0f;
-                }
-                float fx = (static_cast<float>(x) / (width - 1) - 0.5f) * scale.x;
-                float fz = (static_cast<float>(z) / (height - 1) - 0.5f) * scale.z;
-                float fy = heightmapData[z * width + x] * scale.y;
-
-                vertex.pos = glm::vec3(fx, fy, fz);
-                vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f); // default normal
-                vertex.uv = glm::vec2(static_cast<float>(x) / (width - 1), static_cast<float>(z) / (height - 1));
-                vertex.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
-
-                // Calculate normal using central difference method if not at the edge
-                if (x > 0 && x < width - 1 && z > 0 && z < height - 1) {
-                    float hL = heightmapData[z * width + (x - 1)];
-                    float hR = heightmapData[z * width + (x + 1)];
-                    float hD = heightmapData[(z - 1) * width + x];
-                    float hU = heightmapData[(z + 1) * width + x];
-
-                    glm::vec3 tangent(2.0f, (hR - hL) * scale.y, 0.0f);
-                    glm::vec3 bitangent(0.0f, (hU - hD) * scale.y, 2.0f);
-                    vertex.normal = glm::normalize(glm::cross(tangent, bitangent));
+                unsigned int* quad = indices + (size_t)z * (width - 1) * 6;
+                for (int x = 0; x < width - 1; x++, quad += 6) {
+                    unsigned int topLeft = z * width + x;
+                    unsigned int topRight = topLeft + 1;
+                    unsigned int bottomLeft = (z + 1) * width + x;
+                    unsigned int bottomRight = bottomLeft + 1;
+
+                    // Triangle 1
+                    quad[0] = topLeft;
+                    quad[1] = bottomLeft;
+                    quad[2] = bottomRight;
+
+                    // Triangle 2
+                    quad[3] = topLeft;
+                    quad[4] = bottomRight;
+                    quad[5] = topRight;
                 }
-
-                vertices.push_back(vertex);
             }
-        }
+        }, 16);
 
-        // Generate triangle indices
-        for (int z = 0; z < height - 1; z++) {
-            for (int x = 0; x < width - 1; x++) {
-                unsigned int topLeft = z * width + x;
-                unsigned int topRight = topLeft + 1;
-                unsigned int bottomLeft = (z + 1) * width + x;
-                unsigned int bottomRight = bottomLeft + 1;
-
-                // Triangle 1
-                indices.push_back(topLeft);
-                indices.push_back(bottomLeft);
-                indices.push_back(bottomRight);
-
-                // Triangle 2
-                indices.push_back(topLeft);
-                indices.push_back(bottomRight);
-                indices.push_back(topRight);
-            }
-        }
-
-        ew::MeshData meshData;
-        meshData.vertices = std::move(vertices);
-        meshData.indices = std::move(indices);
+        return meshData;
+    }
 
-        return ew::Mesh(meshData);
+    ew::Mesh createHeightmapMesh(const std::vector<float>& heightmapData, int width, int height, glm::vec3 scale) {
+        return ew::Mesh(createHeightmapMeshData(heightmapData, width, height, scale));
     }
-}
\ No newline at end of file
+}
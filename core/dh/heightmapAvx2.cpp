@@ -0,0 +1,26 @@
+#include "heightmapAvx2.h"
+// Nothing but the kernel lives here. Inline functions from other headers compiled with AVX2 could be the copy
+// the linker keeps, and then run on CPUs without it.
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace dh {
+
+    void computeRowSlopesAvx2(const float* center, const float* up, const float* down, int count, float slopeX, float slopeZ,
+        float* dhdx, float* dhdz, float* invLength, float* invTangentLength) {
+        // The square roots and divisions are the expensive part
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 slopeX8 = _mm256_set1_ps(slopeX);
+        const __m256 slopeZ8 = _mm256_set1_ps(slopeZ);
+        for (int x = 0; x < count; x += 8) {
+            __m256 dx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(center + x + 1), _mm256_loadu_ps(center + x - 1)), slopeX8);
+            __m256 dz = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(down + x)), slopeZ8);
+            __m256 dx2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), one);
+            _mm256_storeu_ps(dhdx + x, dx);
+            _mm256_storeu_ps(dhdz + x, dz);
+            _mm256_storeu_ps(invLength + x, _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(dx2, _mm256_mul_ps(dz, dz)))));
+            _mm256_storeu_ps(invTangentLength + x, _mm256_div_ps(one, _mm256_sqrt_ps(dx2)));
+        }
+    }
+}
+#endif
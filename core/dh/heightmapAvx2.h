@@ -0,0 +1,10 @@
+#pragma once
+
+namespace dh {
+
+    // Slopes of count interior columns of a heightmap row, count a multiple of 8. center, up and down point at the
+    // first column in this row and the rows either side. Only built into heightmapAvx2.cpp, which alone is compiled
+    // for AVX2, so callers must check the CPU first.
+    void computeRowSlopesAvx2(const float* center, const float* up, const float* down, int count, float slopeX, float slopeZ,
+        float* dhdx, float* dhdz, float* invLength, float* invTangentLength);
+}
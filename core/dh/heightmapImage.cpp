@@ -0,0 +1,132 @@
+#include "heightmapImage.h"
+#include "../ew/external/glad.h"
+#include "../ew/external/stb_image.h"
+#include "../ew/glState.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+
+namespace dh {
+
+    // Finds the raw range then converts to floats in a single pass over the decoded samples,
+    // both split into rows across the job system
+    template<typename T>
+    static void normalizeSamples(const T* data, int width, int height, float maxValue, bool normalizeHeight, std::vector<float>& heights) {
+        size_t count = (size_t)width * height;
+        std::mutex rangeMutex;
+        T minSample = data[0];
+        T maxSample = data[0];
+        parallelFor(0, height, [&](int yBegin, int yEnd) {
+            T bandMin = data[(size_t)yBegin * width];
+            T bandMax = bandMin;
+            for (size_t i = (size_t)yBegin * width; i < (size_t)yEnd * width; i++) {
+                bandMin = std::min(bandMin, data[i]);
+                bandMax = std::max(bandMax, data[i]);
+            }
+            std::lock_guard<std::mutex> lock(rangeMutex);
+            minSample = std::min(minSample, bandMin);
+            maxSample = std::max(maxSample, bandMax);
+        }, 64);
+        std::printf("Raw height range: min=%d, max=%d\n", (int)minSample, (int)maxSample);
+
+        float offset = 0.0f;
+        float invRange = 1.0f / maxValue;
+        if (normalizeHeight && maxSample > minSample) {
+            offset = static_cast<float>(minSample);
+            invRange = 1.0f / static_cast<float>(maxSample - minSample);
+        }
+
+        heights.resize(count);
+        float* out = heights.data();
+        parallelFor(0, height, [=](int yBegin, int yEnd) {
+            for (size_t i = (size_t)yBegin * width; i < (size_t)yEnd * width; i++) {
+                out[i] = (static_cast<float>(data[i]) - offset) * invRange;
+            }
+        }, 64);
+    }
+
+    HeightmapImage::HeightmapImage(const char* filePath, bool normalizeHeight)
+    {
+        load(filePath, normalizeHeight);
+    }
+
+    bool HeightmapImage::load(const char* filePath, bool normalizeHeight)
+    {
+        m_width = 0;
+        m_height = 0;
+        m_heights.clear();
+
+        // 16-bit PNGs keep their full precision, everything else decodes to 8-bit luminance
+        int width, height, numComponents;
+        bool is16Bit = stbi_is_16_bit(filePath) != 0;
+        void* data = is16Bit
+            ? (void*)stbi_load_16(filePath, &width, &height, &numComponents, 1)
+            : (void*)stbi_load(filePath, &width, &height, &numComponents, 1);
+
+        if (data == nullptr) {
+            std::printf("Failed to load heightmap image %s\n", filePath);
+            return false;
+        }
+
+        std::printf("Loaded heightmap: %s (%dx%d, %d components, %d-bit)\n",
+            filePath, width, height, numComponents, is16Bit ? 16 : 8);
+
+        if (is16Bit) {
+            normalizeSamples(static_cast<const unsigned short*>(data), width, height, 65535.0f, normalizeHeight, m_heights);
+        }
+        else {
+            normalizeSamples(static_cast<const unsigned char*>(data), width, height, 255.0f, normalizeHeight, m_heights);
+        }
+        stbi_image_free(data);
+
+        m_width = width;
+        m_height = height;
+        return true;
+    }
+
+    ew::Texture HeightmapImage::createTexture() const
+    {
+        return createHeightTexture(m_heights, m_width, m_height);
+    }
+
+    static ew::Texture uploadHeightTexture(int width, int height, GLenum type, const void* data) {
+        ew::Texture texture = ew::Texture::create();
+        glBindTexture(GL_TEXTURE_2D, texture.get());
+
+        // Heights are 0-1, so 16-bit unorm keeps them at half the size of RGBA8.
+        // Rows of 16-bit samples are only 2-byte aligned when the width is odd.
+        glPixelStorei(GL_UNPACK_ALIGNMENT, type == GL_UNSIGNED_SHORT ? 2 : 4);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, width, height, 0, GL_RED, type, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // Show up as grayscale when previewed, .r is unchanged for the shaders
+        int swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        ew::GLState::get().invalidate();
+        return texture;
+    }
+
+    ew::Texture createHeightTexture(const std::vector<float>& heights, int width, int height) {
+        if (heights.size() != (size_t)width * height || heights.empty()) {
+            std::printf("ERROR in createHeightTexture: Data size (%zu) doesn't match dimensions (%d x %d)\n",
+                heights.size(), width, height);
+            return ew::Texture();
+        }
+        return uploadHeightTexture(width, height, GL_FLOAT, heights.data());
+    }
+
+    ew::Texture createHeightTexture(const unsigned short* heights, int width, int height) {
+        if (heights == nullptr || width <= 0 || height <= 0) {
+            return ew::Texture();
+        }
+        return uploadHeightTexture(width, height, GL_UNSIGNED_SHORT, heights);
+    }
+}
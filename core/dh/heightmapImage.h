@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include "../ew/glResource.h"
+
+namespace dh {
+
+    // A heightmap decoded once into normalized floats, shared by mesh building and texture upload
+    class HeightmapImage {
+    public:
+        HeightmapImage() {};
+        HeightmapImage(const char* filePath, bool normalizeHeight = true);
+        bool load(const char* filePath, bool normalizeHeight = true);
+        // Uploads the current heights as a single channel R16 texture and returns its handle
+        ew::Texture createTexture() const;
+        inline bool isLoaded() const { return !m_heights.empty(); }
+        inline int getWidth() const { return m_width; }
+        inline int getHeight() const { return m_height; }
+        inline const std::vector<float>& getHeights() const { return m_heights; }
+        inline std::vector<float>& getHeights() { return m_heights; }
+    private:
+        int m_width = 0;
+        int m_height = 0;
+        std::vector<float> m_heights;
+    };
+
+    ew::Texture createHeightTexture(const std::vector<float>& heights, int width, int height);
+    ew::Texture createHeightTexture(const unsigned short* heights, int width, int height);
+}
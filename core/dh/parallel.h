@@ -0,0 +1,19 @@
+#pragma once
+#include "../ew/jobs.h"
+#include <utility>
+
+namespace dh {
+
+    // The calling thread plus the job system's workers
+    inline int getNumWorkerThreads() {
+        return ew::jobs::getNumThreads();
+    }
+
+    // Splits [begin, end) into ranges of at least minBandSize and calls func(bandBegin, bandEnd) for each
+    // on the job system, the calling thread taking the first band and helping with the rest.
+    // Returns once every band is done. Safe to call from inside a job.
+    template<typename Func>
+    void parallelFor(int begin, int end, Func&& func, int minBandSize = 1) {
+        ew::jobs::parallelFor(begin, end, std::forward<Func>(func), minBandSize);
+    }
+}
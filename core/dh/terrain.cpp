@@ -0,0 +1,553 @@
+#include "terrain.h"
+#include "../ew/external/glad.h"
+#include "../ew/meshOptimizer.h"
+#include "../ew/glState.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+
+namespace dh {
+
+    // Heights come either from decoded floats or from a mapped cache, which also supplies
+    // full resolution normals and a min/max pyramid for leaf bounds
+    struct TerrainSource {
+        const float* heights = nullptr;
+        const TerrainCache* cache = nullptr;
+        inline float height(size_t index) const {
+            return heights != nullptr ? heights[index] : cache->getHeights()[index] / 65535.0f;
+        }
+    };
+
+    static float sampleHeight(const TerrainData& terrain, const TerrainSource& source, int x, int z) {
+        return source.height((size_t)z * terrain.width + x);
+    }
+
+    // Sample columns (or rows) a node touches at its stride, the last one clamped to the map edge
+    static std::vector<int> nodeSamples(int start, int step, int count, int last) {
+        std::vector<int> samples;
+        int end = std::min(start + count * step, last);
+        for (int s = start; s < end; s += step) {
+            samples.push_back(s);
+        }
+        samples.push_back(end);
+        return samples;
+    }
+
+    static glm::vec3 samplePosition(const TerrainData& terrain, const TerrainSource& source, int x, int z) {
+        float fx = (static_cast<float>(x) / (terrain.width - 1) - 0.5f) * terrain.scale.x;
+        float fz = (static_cast<float>(z) / (terrain.height - 1) - 0.5f) * terrain.scale.z;
+        return glm::vec3(fx, sampleHeight(terrain, source, x, z) * terrain.scale.y, fz);
+    }
+
+    static ew::Vertex createVertex(const TerrainData& terrain, const TerrainSource& source, int x, int z, int step) {
+        ew::Vertex vertex;
+        vertex.pos = samplePosition(terrain, source, x, z);
+        vertex.uv = glm::vec2(static_cast<float>(x) / (terrain.width - 1), static_cast<float>(z) / (terrain.height - 1));
+
+        // Central differences at the node's own stride so coarse chunks get matching, smoother normals
+        int xl = std::max(x - step, 0);
+        int xr = std::min(x + step, terrain.width - 1);
+        int zd = std::max(z - step, 0);
+        int zu = std::min(z + step, terrain.height - 1);
+        float dx = (xr - xl) * terrain.scale.x / (terrain.width - 1);
+        float dz = (zu - zd) * terrain.scale.z / (terrain.height - 1);
+        float dhdx = (sampleHeight(terrain, source, xr, z) - sampleHeight(terrain, source, xl, z)) * terrain.scale.y / dx;
+        float dhdz = (sampleHeight(terrain, source, x, zu) - sampleHeight(terrain, source, x, zd)) * terrain.scale.y / dz;
+
+        vertex.normal = glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz));
+        // v grows along +z, which is -cross(normal, tangent)
+        vertex.tangent = glm::vec4(glm::normalize(glm::vec3(1.0f, dhdx, 0.0f)), -1.0f);
+
+        // The cache stores full resolution normals for the unit square, scale them into mesh space
+        if (step == 1 && source.cache != nullptr) {
+            glm::vec3 normal = unpackNormal(source.cache->getNormals()[(size_t)z * terrain.width + x]);
+            vertex.normal = glm::normalize(normal / terrain.scale);
+            vertex.tangent = glm::vec4(glm::normalize(glm::vec3(vertex.normal.y, -vertex.normal.x, 0.0f)), -1.0f);
+        }
+        return vertex;
+    }
+
+    // Height of the node's own triangulation at a sample point. Cells are split along the
+    // top-left/bottom-right diagonal, matching the index order in createNodeMesh.
+    static float interpolateNode(const TerrainData& terrain, const TerrainSource& source, const TerrainNode& node,
+        int x1, int z1, int xf, int zf) {
+        int cx0 = std::min(node.x + ((xf - node.x) / node.step) * node.step, x1);
+        int cz0 = std::min(node.z + ((zf - node.z) / node.step) * node.step, z1);
+        int cx1 = std::min(cx0 + node.step, x1);
+        int cz1 = std::min(cz0 + node.step, z1);
+        float u = cx1 > cx0 ? static_cast<float>(xf - cx0) / (cx1 - cx0) : 0.0f;
+        float v = cz1 > cz0 ? static_cast<float>(zf - cz0) / (cz1 - cz0) : 0.0f;
+
+        float topLeft = sampleHeight(terrain, source, cx0, cz0);
+        float topRight = sampleHeight(terrain, source, cx1, cz0);
+        float bottomLeft = sampleHeight(terrain, source, cx0, cz1);
+        float bottomRight = sampleHeight(terrain, source, cx1, cz1);
+        if (v >= u) {
+            return topLeft + u * (bottomRight - bottomLeft) + v * (bottomLeft - topLeft);
+        }
+        return topLeft + u * (topRight - topLeft) + v * (bottomRight - topRight);
+    }
+
+    // Grid triangles for an nx by nz vertex grid, then skirts for vertices appended after the grid
+    // as four edges (first row, last row, first column, last column) of nx, nx, nz and nz vertices
+    static void createChunkIndices(int nx, int nz, std::vector<unsigned int>& indices) {
+        indices.reserve(indices.size() + (nx - 1) * (nz - 1) * 6 + (nx - 1 + nz - 1) * 24);
+        for (int z = 0; z < nz - 1; z++) {
+            for (int x = 0; x < nx - 1; x++) {
+                unsigned int topLeft = z * nx + x;
+                unsigned int topRight = topLeft + 1;
+                unsigned int bottomLeft = (z + 1) * nx + x;
+                unsigned int bottomRight = bottomLeft + 1;
+
+                indices.push_back(topLeft);
+                indices.push_back(bottomLeft);
+                indices.push_back(bottomRight);
+
+                indices.push_back(topLeft);
+                indices.push_back(bottomRight);
+                indices.push_back(topRight);
+            }
+        }
+
+        std::vector<unsigned int> edges[4];
+        for (int x = 0; x < nx; x++) {
+            edges[0].push_back(x);
+            edges[1].push_back((nz - 1) * nx + x);
+        }
+        for (int z = 0; z < nz; z++) {
+            edges[2].push_back(z * nx);
+            edges[3].push_back(z * nx + nx - 1);
+        }
+
+        unsigned int base = nx * nz;
+        for (const std::vector<unsigned int>& edge : edges) {
+            for (size_t i = 0; i + 1 < edge.size(); i++) {
+                unsigned int a = edge[i];
+                unsigned int b = edge[i + 1];
+                unsigned int skirtA = base + (unsigned int)i;
+                unsigned int skirtB = skirtA + 1;
+
+                // Both windings, so the skirt fills the crack from either side with back-face culling on
+                unsigned int quad[12] = {
+                    a, skirtA, skirtB,  a, skirtB, b,
+                    a, skirtB, skirtA,  a, b, skirtB
+                };
+                indices.insert(indices.end(), quad, quad + 12);
+            }
+            base += (unsigned int)edge.size();
+        }
+    }
+
+    static ew::MeshData createNodeMesh(const TerrainData& terrain, const TerrainSource& source, const TerrainNode& node) {
+        int chunkSize = terrain.settings.chunkSize;
+        std::vector<int> columns = nodeSamples(node.x, node.step, chunkSize, terrain.width - 1);
+        std::vector<int> rows = nodeSamples(node.z, node.step, chunkSize, terrain.height - 1);
+        int nx = (int)columns.size();
+        int nz = (int)rows.size();
+
+        ew::MeshData mesh;
+        mesh.vertices.reserve(nx * nz + 2 * (nx + nz));
+        for (int z : rows) {
+            for (int x : columns) {
+                mesh.vertices.push_back(createVertex(terrain, source, x, z, node.step));
+            }
+        }
+
+        // Skirts hang down from every edge so neighbours at a different LOD never show cracks
+        int edgeStarts[4][2] = { { 0, 1 }, { (nz - 1) * nx, 1 }, { 0, nx }, { nx - 1, nx } };
+        for (int e = 0; e < 4; e++) {
+            int count = e < 2 ? nx : nz;
+            for (int i = 0; i < count; i++) {
+                ew::Vertex vertex = mesh.vertices[edgeStarts[e][0] + i * edgeStarts[e][1]];
+                vertex.pos.y -= node.skirtDepth;
+                mesh.vertices.push_back(vertex);
+            }
+        }
+
+        createChunkIndices(nx, nz, mesh.indices);
+        ew::optimizeMesh(mesh);
+        return mesh;
+    }
+
+    int getCompactVertexCount(int chunkSize) {
+        return (chunkSize + 1) * (chunkSize + 5);
+    }
+
+    // Heights in the same order the compact shader rebuilds the grid from gl_VertexID
+    static void createCompactHeights(const TerrainData& terrain, const TerrainSource& source, const TerrainNode& node, unsigned short* heights) {
+        int side = terrain.settings.chunkSize + 1;
+        auto height = [&](int i, int j) {
+            int x = std::min(node.x + i * node.step, terrain.width - 1);
+            int z = std::min(node.z + j * node.step, terrain.height - 1);
+            size_t index = (size_t)z * terrain.width + x;
+            if (source.heights == nullptr) {
+                return source.cache->getHeights()[index];
+            }
+            return (unsigned short)std::lround(std::min(std::max(source.heights[index], 0.0f), 1.0f) * 65535.0f);
+        };
+
+        for (int j = 0; j < side; j++) {
+            for (int i = 0; i < side; i++) {
+                *heights++ = height(i, j);
+            }
+        }
+        for (int k = 0; k < side; k++) *heights++ = height(k, 0);
+        for (int k = 0; k < side; k++) *heights++ = height(k, side - 1);
+        for (int k = 0; k < side; k++) *heights++ = height(0, k);
+        for (int k = 0; k < side; k++) *heights++ = height(side - 1, k);
+    }
+
+    static int createNode(TerrainData& terrain, const TerrainSource& source, int level, int x, int z) {
+        if (x >= terrain.width - 1 || z >= terrain.height - 1) {
+            return -1;
+        }
+
+        // Reserve the slot first so nodes are stored in pre-order with the root at 0
+        int index = (int)terrain.nodes.size();
+        terrain.nodes.push_back(TerrainNode());
+
+        TerrainNode node;
+        node.x = x;
+        node.z = z;
+        node.level = level;
+        node.step = 1 << level;
+
+        int chunkSize = terrain.settings.chunkSize;
+        int x1 = std::min(x + chunkSize * node.step, terrain.width - 1);
+        int z1 = std::min(z + chunkSize * node.step, terrain.height - 1);
+        float minHeight = sampleHeight(terrain, source, x, z) * terrain.scale.y;
+        float maxHeight = minHeight;
+
+        if (level == 0 && source.cache != nullptr) {
+            source.cache->getHeightRange(x, z, x1, z1, minHeight, maxHeight);
+            minHeight *= terrain.scale.y;
+            maxHeight *= terrain.scale.y;
+        }
+        else if (level == 0) {
+            for (int sz = z; sz <= z1; sz++) {
+                for (int sx = x; sx <= x1; sx++) {
+                    float h = sampleHeight(terrain, source, sx, sz) * terrain.scale.y;
+                    minHeight = std::min(minHeight, h);
+                    maxHeight = std::max(maxHeight, h);
+                }
+            }
+        }
+        else {
+            int half = chunkSize << (level - 1);
+            int offsets[4][2] = { { 0, 0 }, { half, 0 }, { 0, half }, { half, half } };
+            for (int c = 0; c < 4; c++) {
+                int child = createNode(terrain, source, level - 1, x + offsets[c][0], z + offsets[c][1]);
+                node.children[c] = child;
+                if (child >= 0) {
+                    const TerrainNode& childNode = terrain.nodes[child];
+                    minHeight = std::min(minHeight, childNode.boundsMin.y);
+                    maxHeight = std::max(maxHeight, childNode.boundsMax.y);
+                    node.error = std::max(node.error, childNode.error);
+                }
+            }
+
+            // Compare this node against the vertices its children add (half stride)
+            std::vector<int> columns = nodeSamples(x, node.step / 2, chunkSize * 2, terrain.width - 1);
+            std::vector<int> rows = nodeSamples(z, node.step / 2, chunkSize * 2, terrain.height - 1);
+            for (int zf : rows) {
+                for (int xf : columns) {
+                    float h = sampleHeight(terrain, source, xf, zf);
+                    float approx = interpolateNode(terrain, source, node, x1, z1, xf, zf);
+                    node.error = std::max(node.error, std::abs(h - approx));
+                }
+            }
+        }
+
+        // Bounds are in mesh space. Parents take the union of their children, which already
+        // covers every sample the parent's coarser grid can touch.
+        node.boundsMin = glm::vec3(samplePosition(terrain, source, x, z).x, minHeight, samplePosition(terrain, source, x, z).z);
+        node.boundsMax = glm::vec3(samplePosition(terrain, source, x1, z1).x, maxHeight, samplePosition(terrain, source, x1, z1).z);
+
+        // The gap between two chunks is at most both of their errors, hence twice the error.
+        // Skirts reach below the sampled minimum, so the bounds do too.
+        node.skirtDepth = 2.0f * node.error * terrain.scale.y + terrain.settings.skirtDepth * terrain.scale.y;
+        node.boundsMin.y -= node.skirtDepth;
+
+        terrain.nodes[index] = node;
+        return index;
+    }
+
+    static TerrainData buildTerrain(const TerrainSource& source, int width, int height, glm::vec3 scale, const TerrainSettings& settings) {
+        TerrainData terrain;
+        terrain.width = width;
+        terrain.height = height;
+        terrain.scale = scale;
+        terrain.settings = settings;
+
+        // Enough levels for the root to cover the whole map with one chunk
+        int tilesX = (width - 2) / settings.chunkSize + 1;
+        int tilesZ = (height - 2) / settings.chunkSize + 1;
+        int levels = 0;
+        while ((1 << levels) < std::max(tilesX, tilesZ)) {
+            levels++;
+        }
+
+        createNode(terrain, source, levels, 0, 0);
+
+        // Chunks only read their own finished node, so they are meshed in parallel once the tree is built
+        int numNodes = (int)terrain.nodes.size();
+        if (settings.vertexFormat == TerrainVertexFormat::COMPACT) {
+            size_t vertexCount = getCompactVertexCount(settings.chunkSize);
+            terrain.compactHeights.resize(terrain.nodes.size() * vertexCount);
+            parallelFor(0, numNodes, [&](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    createCompactHeights(terrain, source, terrain.nodes[i], terrain.compactHeights.data() + i * vertexCount);
+                }
+            });
+        }
+        else {
+            terrain.meshes.resize(terrain.nodes.size());
+            terrain.meshlets.resize(terrain.nodes.size());
+            parallelFor(0, numNodes, [&](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    terrain.meshes[i] = createNodeMesh(terrain, source, terrain.nodes[i]);
+                    terrain.meshlets[i] = ew::buildMeshlets(terrain.meshes[i]);
+                }
+            });
+        }
+
+        std::printf("Built terrain quadtree: %zu chunks, %d levels, %dx%d quads per chunk\n",
+            terrain.nodes.size(), levels + 1, settings.chunkSize, settings.chunkSize);
+        return terrain;
+    }
+
+    TerrainData createTerrainData(const std::vector<float>& heightmapData, int width, int height, glm::vec3 scale, const TerrainSettings& settings) {
+        if (width < 2 || height < 2 || heightmapData.size() != (size_t)width * height || settings.chunkSize < 1) {
+            std::printf("ERROR in createTerrainData: Data size (%zu) doesn't match dimensions (%d x %d)\n",
+                heightmapData.size(), width, height);
+            return TerrainData();
+        }
+        TerrainSource source;
+        source.heights = heightmapData.data();
+        return buildTerrain(source, width, height, scale, settings);
+    }
+
+    TerrainData createTerrainData(const TerrainCache& cache, glm::vec3 scale, const TerrainSettings& settings) {
+        if (!cache.isOpen() || settings.chunkSize < 1) {
+            std::printf("ERROR in createTerrainData: Terrain cache is not open\n");
+            return TerrainData();
+        }
+        TerrainSource source;
+        source.cache = &cache;
+        return buildTerrain(source, cache.getWidth(), cache.getHeight(), scale, settings);
+    }
+
+    Terrain::Terrain(const TerrainData& terrainData)
+    {
+        load(terrainData);
+    }
+
+    void Terrain::load(const TerrainData& terrainData)
+    {
+        m_nodes = terrainData.nodes;
+        m_vertexFormat = terrainData.settings.vertexFormat;
+        m_width = terrainData.width;
+        m_height = terrainData.height;
+        m_scale = terrainData.scale;
+        m_chunkSize = terrainData.settings.chunkSize;
+        m_bufferBytes = 0;
+
+        m_meshlets = terrainData.meshlets;
+        m_meshes.clear();
+        m_meshes.reserve(terrainData.meshes.size());
+        for (const ew::MeshData& meshData : terrainData.meshes) {
+            m_meshes.push_back(ew::Mesh(meshData));
+            m_bufferBytes += m_meshes.back().getBufferBytes();
+        }
+
+        if (m_vertexFormat == TerrainVertexFormat::COMPACT) {
+            loadCompact(terrainData);
+        }
+        else {
+            // A terrain that was compact before would otherwise keep its heights and indices alive
+            m_compactVao.reset();
+            m_compactVbo.reset();
+            m_compactEbo.reset();
+            m_compactIndexType = 0;
+            m_numCompactIndices = 0;
+        }
+
+        m_selected.clear();
+        m_numSelectedIndices = 0;
+        m_pixelError = terrainData.settings.pixelError;
+    }
+
+    void Terrain::loadCompact(const TerrainData& terrainData)
+    {
+        int side = m_chunkSize + 1;
+        std::vector<unsigned int> indices;
+        createChunkIndices(side, side, indices);
+        // Vertices are addressed by gl_VertexID here, so only the triangle order can change
+        ew::optimizeVertexCache(indices, getCompactVertexCount(m_chunkSize));
+        m_numCompactIndices = (int)indices.size();
+
+        if (!m_compactVao) {
+            m_compactVao = ew::VertexArray::create();
+            m_compactVbo = ew::Buffer::create();
+            m_compactEbo = ew::Buffer::create();
+
+            // One normalized 16-bit height per vertex. The buffer is bound per chunk in draw,
+            // so each chunk's vertices start at index 0 and gl_VertexID is the grid index.
+            ew::GLState::get().bindVertexArray(m_compactVao.get());
+            glVertexAttribFormat(0, 1, GL_UNSIGNED_SHORT, GL_TRUE, 0);
+            glVertexAttribBinding(0, 0);
+            glEnableVertexAttribArray(0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_compactEbo.get());
+        }
+
+        ew::GLState::get().bindVertexArray(m_compactVao.get());
+        glBindBuffer(GL_ARRAY_BUFFER, m_compactVbo.get());
+        glBufferData(GL_ARRAY_BUFFER, terrainData.compactHeights.size() * sizeof(unsigned short), terrainData.compactHeights.data(), GL_STATIC_DRAW);
+
+        // Every chunk shares this index buffer, 16-bit whenever the chunk is small enough
+        size_t indexSize = sizeof(unsigned int);
+        if (getCompactVertexCount(m_chunkSize) <= 65536) {
+            std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+            m_compactIndexType = GL_UNSIGNED_SHORT;
+            indexSize = sizeof(unsigned short);
+        }
+        else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+            m_compactIndexType = GL_UNSIGNED_INT;
+        }
+        m_bufferBytes += terrainData.compactHeights.size() * sizeof(unsigned short) + indices.size() * indexSize;
+
+        ew::GLState::get().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void Terrain::select(const ew::Camera& camera, float viewportHeight, const glm::mat4& model)
+    {
+        m_selected.clear();
+        m_drawCounts.clear();
+        m_drawFirstIndices.clear();
+        m_selectedRanges.assign(1, 0);
+        m_numSelectedIndices = 0;
+        if (m_nodes.empty()) {
+            return;
+        }
+
+        // Planes and camera in mesh space, so bounds can be tested without transforming them
+        ew::Frustum frustum(camera.projectionMatrix() * camera.viewMatrix() * model);
+        glm::vec3 localCamera = glm::vec3(glm::inverse(model) * glm::vec4(camera.position, 1.0f));
+
+        // Pixels per world unit at distance 1 (perspective) or anywhere (orthographic)
+        float pixelsPerUnit = camera.orthographic
+            ? viewportHeight / camera.orthoHeight
+            : viewportHeight / (2.0f * std::tan(glm::radians(camera.fov) * 0.5f));
+        // Node errors are unscaled, they pick up the baked vertical scale and then the model's
+        float heightScale = m_scale.y * glm::length(glm::vec3(model[1]));
+
+        std::vector<int> stack;
+        stack.push_back(0);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            const TerrainNode& node = m_nodes[index];
+
+            if (!frustum.intersectsBox(node.boundsMin, node.boundsMax)) {
+                continue;
+            }
+
+            bool refine = false;
+            if (node.level > 0) {
+                float screenError = node.error * heightScale * pixelsPerUnit;
+                if (!camera.orthographic) {
+                    // Closest distance from the camera to the node's world space box
+                    glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+                    glm::vec3 extents = (node.boundsMax - node.boundsMin) * 0.5f;
+                    glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+                    glm::vec3 worldExtents(0.0f);
+                    for (int axis = 0; axis < 3; axis++) {
+                        worldExtents[axis] = std::abs(model[0][axis]) * extents.x
+                            + std::abs(model[1][axis]) * extents.y
+                            + std::abs(model[2][axis]) * extents.z;
+                    }
+                    glm::vec3 delta = glm::max(glm::abs(camera.position - worldCenter) - worldExtents, glm::vec3(0.0f));
+                    screenError /= std::max(glm::length(delta), camera.nearPlane);
+                }
+                refine = screenError > m_pixelError;
+            }
+
+            if (refine) {
+                for (int child : node.children) {
+                    if (child >= 0) {
+                        stack.push_back(child);
+                    }
+                }
+            }
+            else if (isCompact()) {
+                m_selected.push_back(index);
+                m_numSelectedIndices += m_numCompactIndices;
+            }
+            else {
+                size_t firstRange = m_drawCounts.size();
+                ew::cullMeshlets(m_meshlets[index], frustum, localCamera, !camera.orthographic, m_drawCounts, m_drawFirstIndices);
+                if (m_drawCounts.size() == firstRange) {
+                    continue;
+                }
+                for (size_t i = firstRange; i < m_drawCounts.size(); i++) {
+                    m_numSelectedIndices += m_drawCounts[i];
+                }
+                m_selected.push_back(index);
+                m_selectedRanges.push_back((int)m_drawCounts.size());
+            }
+        }
+    }
+
+    void Terrain::draw(ew::DrawMode drawMode) const
+    {
+        // Compact chunks are placed by the shader, there is nothing to draw without one
+        assert(!isCompact() && "Compact terrains are drawn with draw(shader)");
+        if (isCompact()) {
+            return;
+        }
+        for (size_t i = 0; i < m_selected.size(); i++) {
+            if (drawMode == ew::DrawMode::TRIANGLES) {
+                int first = m_selectedRanges[i];
+                m_meshes[m_selected[i]].drawRanges(&m_drawCounts[first], &m_drawFirstIndices[first], m_selectedRanges[i + 1] - first);
+            }
+            else {
+                m_meshes[m_selected[i]].draw(drawMode);
+            }
+        }
+    }
+
+    void Terrain::draw(const ew::Shader& shader, ew::DrawMode drawMode) const
+    {
+        if (!isCompact()) {
+            draw(drawMode);
+            return;
+        }
+
+        shader.setVec2("_MapSize", (float)m_width, (float)m_height);
+        shader.setVec3("_TerrainScale", m_scale);
+        shader.setInt("_ChunkSize", m_chunkSize);
+
+        int vertexCount = getCompactVertexCount(m_chunkSize);
+        ew::GLState::get().bindVertexArray(m_compactVao.get());
+        for (int index : m_selected) {
+            const TerrainNode& node = m_nodes[index];
+            shader.setVec2("_ChunkOrigin", (float)node.x, (float)node.z);
+            shader.setInt("_ChunkStep", node.step);
+            shader.setFloat("_SkirtDepth", node.skirtDepth);
+
+            glBindVertexBuffer(0, m_compactVbo.get(), (GLintptr)index * vertexCount * sizeof(unsigned short), sizeof(unsigned short));
+            if (drawMode == ew::DrawMode::TRIANGLES) {
+                glDrawElements(GL_TRIANGLES, m_numCompactIndices, m_compactIndexType, NULL);
+            }
+            else {
+                glDrawArrays(GL_POINTS, 0, vertexCount);
+            }
+        }
+        ew::GLState::get().bindVertexArray(0);
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "../ew/mesh.h"
+#include "../ew/meshlet.h"
+#include "../ew/camera.h"
+#include "../ew/shader.h"
+#include "terrainCache.h"
+
+namespace dh {
+
+    enum class TerrainVertexFormat {
+        FULL = 0,       // An ew::Vertex per sample, one mesh per chunk
+        COMPACT = 1     // A 16-bit height per sample, the shader rebuilds position, uv and normal
+    };
+
+    struct TerrainSettings {
+        int chunkSize = 64;         // Quads along one chunk edge, the same at every LOD
+        float pixelError = 2.0f;    // Largest screen-space error (in pixels) a selected chunk may have
+        float skirtDepth = 0.01f;   // Minimum skirt drop as a fraction of the height scale
+        TerrainVertexFormat vertexFormat = TerrainVertexFormat::FULL;
+    };
+
+    // One quadtree node. Level 0 nodes sample every texel, each level up doubles the stride.
+    struct TerrainNode {
+        int x = 0, z = 0;           // First sample covered by this node
+        int level = 0;
+        int step = 1;               // Sample stride, 1 << level
+        glm::vec3 boundsMin = glm::vec3(0.0f);
+        glm::vec3 boundsMax = glm::vec3(0.0f);
+        float error = 0.0f;         // Max height deviation from full resolution, in unscaled 0-1 heights
+        float skirtDepth = 0.0f;    // How far the skirts hang below the edges, in mesh units
+        int children[4] = { -1, -1, -1, -1 };
+    };
+
+    // CPU side of a terrain, nodes[0] is the root. FULL terrains have meshes[i] and meshlets[i] for nodes[i], COMPACT
+    // ones store getCompactVertexCount() heights per node, in node order, in compactHeights.
+    struct TerrainData {
+        int width = 0;
+        int height = 0;
+        glm::vec3 scale = glm::vec3(1.0f);
+        TerrainSettings settings;
+        std::vector<TerrainNode> nodes;
+        std::vector<ew::MeshData> meshes;
+        std::vector<std::vector<ew::Meshlet>> meshlets;
+        std::vector<unsigned short> compactHeights;
+    };
+
+    // Every COMPACT chunk is a (chunkSize + 1)^2 grid followed by its four skirt edges, so they
+    // all share one index buffer. Edge chunks repeat the last row and column of the map.
+    int getCompactVertexCount(int chunkSize);
+
+    TerrainData createTerrainData(const std::vector<float>& heightmapData,
+        int width,
+        int height,
+        glm::vec3 scale = glm::vec3(1.0f),
+        const TerrainSettings& settings = TerrainSettings());
+    // Builds from a mapped cache, using its stored normals and height pyramid instead of rescanning
+    TerrainData createTerrainData(const TerrainCache& cache,
+        glm::vec3 scale = glm::vec3(1.0f),
+        const TerrainSettings& settings = TerrainSettings());
+
+    class Terrain {
+    public:
+        Terrain() {};
+        Terrain(const TerrainData& terrainData);
+        void load(const TerrainData& terrainData);
+        // Picks the coarsest set of visible chunks whose projected error stays under the pixel error.
+        // FULL chunks are also culled per meshlet.
+        void select(const ew::Camera& camera, float viewportHeight, const glm::mat4& model = glm::mat4(1.0f));
+        // FULL terrains only, COMPACT ones draw nothing here
+        void draw(ew::DrawMode drawMode = ew::DrawMode::TRIANGLES) const;
+        // COMPACT terrains need the shader to pass each chunk's placement, FULL ones ignore it
+        void draw(const ew::Shader& shader, ew::DrawMode drawMode = ew::DrawMode::TRIANGLES) const;
+        inline void setPixelError(float pixelError) { m_pixelError = pixelError; }
+        inline float getPixelError() const { return m_pixelError; }
+        inline int getNumNodes() const { return (int)m_nodes.size(); }
+        inline int getNumSelected() const { return (int)m_selected.size(); }
+        inline int getNumSelectedIndices() const { return m_numSelectedIndices; }
+        inline bool isCompact() const { return m_vertexFormat == TerrainVertexFormat::COMPACT; }
+        // GPU memory held by vertex and index buffers
+        inline size_t getBufferBytes() const { return m_bufferBytes; }
+    private:
+        void loadCompact(const TerrainData& terrainData);
+
+        std::vector<TerrainNode> m_nodes;
+        std::vector<ew::Mesh> m_meshes;
+        std::vector<std::vector<ew::Meshlet>> m_meshlets;
+        TerrainVertexFormat m_vertexFormat = TerrainVertexFormat::FULL;
+        int m_width = 0;
+        int m_height = 0;
+        glm::vec3 m_scale = glm::vec3(1.0f);
+        int m_chunkSize = 0;
+        size_t m_bufferBytes = 0;
+
+        // COMPACT only, one height buffer for every chunk and the shared index buffer
+        ew::VertexArray m_compactVao;
+        ew::Buffer m_compactVbo;
+        ew::Buffer m_compactEbo;
+        unsigned int m_compactIndexType = 0;
+        int m_numCompactIndices = 0;
+        std::vector<int> m_selected;
+        // FULL only, visible meshlet ranges. Selected chunk i draws ranges m_selectedRanges[i] to m_selectedRanges[i + 1].
+        std::vector<int> m_drawCounts;
+        std::vector<unsigned int> m_drawFirstIndices;
+        std::vector<int> m_selectedRanges;
+        float m_pixelError = 2.0f;
+        int m_numSelectedIndices = 0;
+    };
+}
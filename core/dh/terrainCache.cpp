@@ -0,0 +1,308 @@
+#include "terrainCache.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace dh {
+
+    static const uint32_t TERRAIN_CACHE_MAGIC = 0x52544844; // "DHTR"
+    static const uint32_t TERRAIN_CACHE_VERSION = 1;
+
+    struct TerrainCacheHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t normalized;
+        uint32_t numLevels;
+        uint64_t sourceSize;
+        uint64_t sourceHash;        // FNV-1a of the source image file
+        uint64_t heightsOffset;
+        uint64_t normalsOffset;
+        uint64_t pyramidOffset;
+        uint64_t fileSize;
+        uint64_t headerHash;        // FNV-1a of this header with this field zeroed
+    };
+
+    static uint64_t alignOffset(uint64_t offset) {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    static uint64_t hashHeader(TerrainCacheHeader header) {
+        header.headerHash = 0;
+        return ew::hashBytes(&header, sizeof(header));
+    }
+
+    // Level l of the pyramid has one min/max pair per 2^l x 2^l block of quads. A block's range
+    // includes its far edge samples, so adjacent blocks overlap by one row and column.
+    static int pyramidLevelSize(int samples, int level) {
+        int quads = samples - 1;
+        return std::max(1, (quads + (1 << level) - 1) >> level);
+    }
+
+    static size_t pyramidLevelOffset(int width, int height, int level) {
+        size_t offset = 0;
+        for (int l = 1; l < level; l++) {
+            offset += (size_t)pyramidLevelSize(width, l) * pyramidLevelSize(height, l) * 2;
+        }
+        return offset;
+    }
+
+    static int pyramidNumLevels(int width, int height) {
+        int levels = 1;
+        while (pyramidLevelSize(width, levels) > 1 || pyramidLevelSize(height, levels) > 1) {
+            levels++;
+        }
+        return levels;
+    }
+
+    std::string getTerrainCachePath(const char* sourcePath) {
+        return std::string(sourcePath) + ".dhterrain";
+    }
+
+    // Octahedral encoding around +Y, two 16-bit snorm components in one 32-bit word
+    unsigned int packNormal(glm::vec3 normal) {
+        float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        float ex = normal.x / sum;
+        float ez = normal.z / sum;
+        if (normal.y < 0.0f) {
+            float fx = (1.0f - std::abs(ez)) * (ex >= 0.0f ? 1.0f : -1.0f);
+            float fz = (1.0f - std::abs(ex)) * (ez >= 0.0f ? 1.0f : -1.0f);
+            ex = fx;
+            ez = fz;
+        }
+        unsigned int x = (unsigned short)(short)std::lround(std::min(std::max(ex, -1.0f), 1.0f) * 32767.0f);
+        unsigned int z = (unsigned short)(short)std::lround(std::min(std::max(ez, -1.0f), 1.0f) * 32767.0f);
+        return x | (z << 16);
+    }
+
+    glm::vec3 unpackNormal(unsigned int packed) {
+        float ex = (short)(packed & 0xFFFF) / 32767.0f;
+        float ez = (short)(packed >> 16) / 32767.0f;
+        float ey = 1.0f - std::abs(ex) - std::abs(ez);
+        if (ey < 0.0f) {
+            float fx = (1.0f - std::abs(ez)) * (ex >= 0.0f ? 1.0f : -1.0f);
+            float fz = (1.0f - std::abs(ex)) * (ez >= 0.0f ? 1.0f : -1.0f);
+            ex = fx;
+            ez = fz;
+        }
+        return glm::normalize(glm::vec3(ex, ey, ez));
+    }
+
+    bool TerrainCache::write(const char* sourcePath, const HeightmapImage& image, bool normalizeHeight)
+    {
+        uint64_t sourceHash, sourceSize;
+        if (!image.isLoaded() || !ew::hashFile(sourcePath, sourceHash, sourceSize)) {
+            return false;
+        }
+
+        int width = image.getWidth();
+        int height = image.getHeight();
+        const std::vector<float>& source = image.getHeights();
+        size_t count = (size_t)width * height;
+
+        // Normals in normalized terrain space, x and z span 0-1 across the map
+        std::vector<unsigned short> heights(count);
+        std::vector<unsigned int> normals(count);
+        parallelFor(0, height, [&](int zBegin, int zEnd) {
+            for (size_t i = (size_t)zBegin * width; i < (size_t)zEnd * width; i++) {
+                heights[i] = (unsigned short)std::lround(std::min(std::max(source[i], 0.0f), 1.0f) * 65535.0f);
+            }
+            for (int z = zBegin; z < zEnd; z++) {
+                int zd = std::max(z - 1, 0);
+                int zu = std::min(z + 1, height - 1);
+                for (int x = 0; x < width; x++) {
+                    int xl = std::max(x - 1, 0);
+                    int xr = std::min(x + 1, width - 1);
+                    float dhdx = (source[z * width + xr] - source[z * width + xl]) * (width - 1) / (float)(xr - xl);
+                    float dhdz = (source[zu * width + x] - source[zd * width + x]) * (height - 1) / (float)(zu - zd);
+                    normals[(size_t)z * width + x] = packNormal(glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz)));
+                }
+            }
+        }, 16);
+
+        int numLevels = pyramidNumLevels(width, height);
+        std::vector<unsigned short> pyramid(pyramidLevelOffset(width, height, numLevels + 1));
+        for (int level = 1; level <= numLevels; level++) {
+            int levelWidth = pyramidLevelSize(width, level);
+            int levelHeight = pyramidLevelSize(height, level);
+            unsigned short* cells = pyramid.data() + pyramidLevelOffset(width, height, level);
+            const unsigned short* finer = pyramid.data() + pyramidLevelOffset(width, height, level - 1);
+            int finerWidth = pyramidLevelSize(width, level - 1);
+            int finerHeight = pyramidLevelSize(height, level - 1);
+
+            // Rows of a level are independent, the levels themselves go coarser one after another
+            parallelFor(0, levelHeight, [&](int jBegin, int jEnd) {
+                for (int j = jBegin; j < jEnd; j++) {
+                    for (int i = 0; i < levelWidth; i++) {
+                        unsigned short minHeight = 65535;
+                        unsigned short maxHeight = 0;
+                        if (level == 1) {
+                            for (int z = j * 2; z <= std::min(j * 2 + 2, height - 1); z++) {
+                                for (int x = i * 2; x <= std::min(i * 2 + 2, width - 1); x++) {
+                                    minHeight = std::min(minHeight, heights[(size_t)z * width + x]);
+                                    maxHeight = std::max(maxHeight, heights[(size_t)z * width + x]);
+                                }
+                            }
+                        }
+                        else {
+                            for (int fj = j * 2; fj <= std::min(j * 2 + 1, finerHeight - 1); fj++) {
+                                for (int fi = i * 2; fi <= std::min(i * 2 + 1, finerWidth - 1); fi++) {
+                                    minHeight = std::min(minHeight, finer[(fj * finerWidth + fi) * 2]);
+                                    maxHeight = std::max(maxHeight, finer[(fj * finerWidth + fi) * 2 + 1]);
+                                }
+                            }
+                        }
+                        cells[(j * levelWidth + i) * 2] = minHeight;
+                        cells[(j * levelWidth + i) * 2 + 1] = maxHeight;
+                    }
+                }
+            }, 16);
+        }
+
+        TerrainCacheHeader header = {};
+        header.magic = TERRAIN_CACHE_MAGIC;
+        header.version = TERRAIN_CACHE_VERSION;
+        header.width = width;
+        header.height = height;
+        header.normalized = normalizeHeight ? 1 : 0;
+        header.numLevels = numLevels;
+        header.sourceSize = sourceSize;
+        header.sourceHash = sourceHash;
+        header.heightsOffset = alignOffset(sizeof(TerrainCacheHeader));
+        header.normalsOffset = alignOffset(header.heightsOffset + count * sizeof(unsigned short));
+        header.pyramidOffset = alignOffset(header.normalsOffset + count * sizeof(unsigned int));
+        header.fileSize = header.pyramidOffset + pyramid.size() * sizeof(unsigned short);
+        header.headerHash = hashHeader(header);
+
+        std::string cachePath = getTerrainCachePath(sourcePath);
+        std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::printf("Failed to write terrain cache %s\n", cachePath.c_str());
+            return false;
+        }
+
+        const char padding[16] = {};
+        auto writeAt = [&](uint64_t offset, const void* data, size_t size) {
+            file.write(padding, (std::streamsize)(offset - (uint64_t)file.tellp()));
+            file.write(static_cast<const char*>(data), (std::streamsize)size);
+        };
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.heightsOffset, heights.data(), count * sizeof(unsigned short));
+        writeAt(header.normalsOffset, normals.data(), count * sizeof(unsigned int));
+        writeAt(header.pyramidOffset, pyramid.data(), pyramid.size() * sizeof(unsigned short));
+
+        if (!file.good()) {
+            std::printf("Failed to write terrain cache %s\n", cachePath.c_str());
+            file.close();
+            std::remove(cachePath.c_str());
+            return false;
+        }
+        std::printf("Wrote terrain cache %s (%llu bytes)\n", cachePath.c_str(), (unsigned long long)header.fileSize);
+        return true;
+    }
+
+    bool TerrainCache::open(const char* sourcePath, bool normalizeHeight)
+    {
+        close();
+
+        std::string cachePath = getTerrainCachePath(sourcePath);
+        uint64_t sourceHash, sourceSize;
+        if (!ew::hashFile(sourcePath, sourceHash, sourceSize) || !m_file.open(cachePath.c_str())) {
+            return false;
+        }
+
+        TerrainCacheHeader header;
+        bool valid = m_file.size() >= sizeof(header);
+        if (valid) {
+            std::memcpy(&header, m_file.data(), sizeof(header));
+            size_t count = (size_t)header.width * header.height;
+            valid = header.magic == TERRAIN_CACHE_MAGIC
+                && header.version == TERRAIN_CACHE_VERSION
+                && header.headerHash == hashHeader(header)
+                && header.fileSize == m_file.size()
+                && header.width >= 2 && header.height >= 2
+                && header.heightsOffset % 16 == 0 && header.normalsOffset % 16 == 0 && header.pyramidOffset % 16 == 0
+                && header.heightsOffset + count * sizeof(unsigned short) <= header.normalsOffset
+                && header.normalsOffset + count * sizeof(unsigned int) <= header.pyramidOffset
+                && (int)header.numLevels == pyramidNumLevels(header.width, header.height)
+                && header.pyramidOffset + pyramidLevelOffset(header.width, header.height, header.numLevels + 1) * sizeof(unsigned short) <= header.fileSize;
+        }
+        if (!valid) {
+            std::printf("Terrain cache %s is corrupt or from another version\n", cachePath.c_str());
+            close();
+            return false;
+        }
+        if (header.sourceSize != sourceSize || header.sourceHash != sourceHash || header.normalized != (normalizeHeight ? 1u : 0u)) {
+            std::printf("Terrain cache %s is stale\n", cachePath.c_str());
+            close();
+            return false;
+        }
+
+        m_width = header.width;
+        m_height = header.height;
+        m_numLevels = header.numLevels;
+        m_heights = reinterpret_cast<const unsigned short*>(m_file.data() + header.heightsOffset);
+        m_normals = reinterpret_cast<const unsigned int*>(m_file.data() + header.normalsOffset);
+        m_pyramid = reinterpret_cast<const unsigned short*>(m_file.data() + header.pyramidOffset);
+        std::printf("Mapped terrain cache %s (%dx%d)\n", cachePath.c_str(), m_width, m_height);
+        return true;
+    }
+
+    void TerrainCache::close()
+    {
+        m_file.close();
+        m_width = 0;
+        m_height = 0;
+        m_numLevels = 0;
+        m_heights = nullptr;
+        m_normals = nullptr;
+        m_pyramid = nullptr;
+    }
+
+    void TerrainCache::getHeightRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight) const
+    {
+        // Coarsest level whose blocks are no bigger than the query, so it overshoots by less than a block
+        int extent = std::max(std::min(x1 - x0, z1 - z0), 1);
+        int level = 1;
+        while (level < m_numLevels && (2 << level) <= extent) {
+            level++;
+        }
+
+        int levelWidth = pyramidLevelSize(m_width, level);
+        int levelHeight = pyramidLevelSize(m_height, level);
+        const unsigned short* cells = m_pyramid + pyramidLevelOffset(m_width, m_height, level);
+        int i0 = std::min(x0 >> level, levelWidth - 1);
+        int i1 = std::min(std::max(x1 - 1, x0) >> level, levelWidth - 1);
+        int j0 = std::min(z0 >> level, levelHeight - 1);
+        int j1 = std::min(std::max(z1 - 1, z0) >> level, levelHeight - 1);
+
+        unsigned short low = 65535;
+        unsigned short high = 0;
+        for (int j = j0; j <= j1; j++) {
+            for (int i = i0; i <= i1; i++) {
+                low = std::min(low, cells[(j * levelWidth + i) * 2]);
+                high = std::max(high, cells[(j * levelWidth + i) * 2 + 1]);
+            }
+        }
+        minHeight = low / 65535.0f;
+        maxHeight = high / 65535.0f;
+    }
+
+    std::vector<float> TerrainCache::copyHeights() const
+    {
+        std::vector<float> heights((size_t)m_width * m_height);
+        for (size_t i = 0; i < heights.size(); i++) {
+            heights[i] = m_heights[i] / 65535.0f;
+        }
+        return heights;
+    }
+
+    ew::Texture TerrainCache::createTexture() const
+    {
+        return createHeightTexture(m_heights, m_width, m_height);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "../ew/mappedFile.h"
+#include "heightmapImage.h"
+
+namespace dh {
+
+    // Memory mapped .dhterrain file written next to a source heightmap. Holds 16-bit heights,
+    // octahedral packed normals and a min/max pyramid, so loading it costs page faults instead
+    // of an image decode and a normal pass.
+    class TerrainCache {
+    public:
+        TerrainCache() {};
+        // Maps the cache for a source image. Fails if it is missing, truncated, from another
+        // format version, or if the source's size or checksum no longer match.
+        bool open(const char* sourcePath, bool normalizeHeight = true);
+        void close();
+        // Builds the cache for a decoded source image, overwriting any existing one
+        static bool write(const char* sourcePath, const HeightmapImage& image, bool normalizeHeight = true);
+
+        inline bool isOpen() const { return m_file.isOpen(); }
+        inline int getWidth() const { return m_width; }
+        inline int getHeight() const { return m_height; }
+        inline const unsigned short* getHeights() const { return m_heights; }
+        // Normals are packed in normalized terrain space, a unit square with heights in 0-1
+        inline const unsigned int* getNormals() const { return m_normals; }
+        inline int getNumLevels() const { return m_numLevels; }
+
+        // Conservative 0-1 height range over samples [x0, x1] x [z0, z1], read from the pyramid
+        void getHeightRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight) const;
+        std::vector<float> copyHeights() const;
+        // Uploads the mapped heights as a single channel R16 texture and returns its handle
+        ew::Texture createTexture() const;
+    private:
+        ew::MappedFile m_file;
+        int m_width = 0;
+        int m_height = 0;
+        int m_numLevels = 0;
+        const unsigned short* m_heights = nullptr;
+        const unsigned int* m_normals = nullptr;
+        const unsigned short* m_pyramid = nullptr;
+    };
+
+    std::string getTerrainCachePath(const char* sourcePath);
+    unsigned int packNormal(glm::vec3 normal);
+    glm::vec3 unpackNormal(unsigned int packed);
+}
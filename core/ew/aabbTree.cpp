@@ -0,0 +1,361 @@
+#include "aabbTree.h"
+#include <algorithm>
+#include <utility>
+
+namespace ew {
+	//Half the surface area, only ever compared
+	static float getArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		glm::vec3 size = boundsMax - boundsMin;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	static bool contains(const glm::vec3& outerMin, const glm::vec3& outerMax, const glm::vec3& innerMin, const glm::vec3& innerMax) {
+		return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z
+			&& outerMax.x >= innerMax.x && outerMax.y >= innerMax.y && outerMax.z >= innerMax.z;
+	}
+
+	static bool overlaps(const glm::vec3& aMin, const glm::vec3& aMax, const glm::vec3& bMin, const glm::vec3& bMax) {
+		return aMin.x <= bMax.x && aMin.y <= bMax.y && aMin.z <= bMax.z
+			&& aMax.x >= bMin.x && aMax.y >= bMin.y && aMax.z >= bMin.z;
+	}
+
+	int AabbTree::insert(const glm::vec3& boundsMin, const glm::vec3& boundsMax, unsigned int userData)
+	{
+		int proxy = allocateNode();
+		Node& node = m_nodes[proxy];
+		node.boundsMin = boundsMin - glm::vec3(m_margin);
+		node.boundsMax = boundsMax + glm::vec3(m_margin);
+		node.userData = userData;
+		node.height = 0;
+		insertLeaf(proxy);
+		m_numProxies++;
+		return proxy;
+	}
+
+	void AabbTree::remove(int proxy)
+	{
+		removeLeaf(proxy);
+		freeNode(proxy);
+		m_numProxies--;
+	}
+
+	bool AabbTree::update(int proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		Node& node = m_nodes[proxy];
+		if (contains(node.boundsMin, node.boundsMax, boundsMin, boundsMax)) {
+			return false;
+		}
+		removeLeaf(proxy);
+		node.boundsMin = boundsMin - glm::vec3(m_margin);
+		node.boundsMax = boundsMax + glm::vec3(m_margin);
+		insertLeaf(proxy);
+		return true;
+	}
+
+	void AabbTree::clear()
+	{
+		m_nodes.clear();
+		m_root = NULL_NODE;
+		m_freeList = NULL_NODE;
+		m_numProxies = 0;
+	}
+
+	void AabbTree::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const
+	{
+		if (m_root == NULL_NODE) {
+			return;
+		}
+		//Each entry carries the planes its box still crosses, a box inside all of them takes its whole subtree
+		const unsigned int ALL_PLANES = 0x3F;
+		std::vector<std::pair<int, unsigned int>> stack;
+		stack.reserve(64);
+		stack.push_back({ m_root, ALL_PLANES });
+		while (!stack.empty()) {
+			int index = stack.back().first;
+			unsigned int planeMask = stack.back().second;
+			stack.pop_back();
+			const Node& node = m_nodes[index];
+
+			bool outside = false;
+			for (int i = 0; i < 6 && !outside; i++) {
+				if (!(planeMask & (1u << i))) {
+					continue;
+				}
+				const glm::vec4& plane = frustum.planes[i];
+				glm::vec3 normal = glm::vec3(plane);
+				//Corners furthest along and against the normal
+				glm::vec3 p, n;
+				for (int axis = 0; axis < 3; axis++) {
+					p[axis] = normal[axis] >= 0.0f ? node.boundsMax[axis] : node.boundsMin[axis];
+					n[axis] = normal[axis] >= 0.0f ? node.boundsMin[axis] : node.boundsMax[axis];
+				}
+				if (glm::dot(normal, p) + plane.w < 0.0f) {
+					outside = true;
+				}
+				else if (glm::dot(normal, n) + plane.w >= 0.0f) {
+					planeMask &= ~(1u << i);
+				}
+			}
+			if (outside) {
+				continue;
+			}
+			if (planeMask == 0 || node.isLeaf()) {
+				collect(index, results);
+				continue;
+			}
+			stack.push_back({ node.children[0], planeMask });
+			stack.push_back({ node.children[1], planeMask });
+		}
+	}
+
+	void AabbTree::querySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& results) const
+	{
+		if (m_root == NULL_NODE) {
+			return;
+		}
+		std::vector<int> stack;
+		stack.reserve(64);
+		stack.push_back(m_root);
+		while (!stack.empty()) {
+			const Node& node = m_nodes[stack.back()];
+			stack.pop_back();
+			glm::vec3 offset = center - glm::clamp(center, node.boundsMin, node.boundsMax);
+			if (glm::dot(offset, offset) > radius * radius) {
+				continue;
+			}
+			if (node.isLeaf()) {
+				results.push_back(node.userData);
+				continue;
+			}
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+
+	void AabbTree::queryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<unsigned int>& results) const
+	{
+		if (m_root == NULL_NODE) {
+			return;
+		}
+		std::vector<int> stack;
+		stack.reserve(64);
+		stack.push_back(m_root);
+		while (!stack.empty()) {
+			int index = stack.back();
+			const Node& node = m_nodes[index];
+			stack.pop_back();
+			if (!overlaps(node.boundsMin, node.boundsMax, boundsMin, boundsMax)) {
+				continue;
+			}
+			if (node.isLeaf() || contains(boundsMin, boundsMax, node.boundsMin, node.boundsMax)) {
+				collect(index, results);
+				continue;
+			}
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+
+	void AabbTree::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<unsigned int>& results) const
+	{
+		if (m_root == NULL_NODE) {
+			return;
+		}
+		//Slab test, a zero component divides to infinity which the min/max handle
+		glm::vec3 invDirection = 1.0f / direction;
+		std::vector<int> stack;
+		stack.reserve(64);
+		stack.push_back(m_root);
+		while (!stack.empty()) {
+			const Node& node = m_nodes[stack.back()];
+			stack.pop_back();
+			glm::vec3 t0 = (node.boundsMin - origin) * invDirection;
+			glm::vec3 t1 = (node.boundsMax - origin) * invDirection;
+			glm::vec3 tNear = glm::min(t0, t1);
+			glm::vec3 tFar = glm::max(t0, t1);
+			float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+			float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+			//Written so NaNs from 0 * infinity count as a miss
+			if (!(enter <= exit)) {
+				continue;
+			}
+			if (node.isLeaf()) {
+				results.push_back(node.userData);
+				continue;
+			}
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+
+	int AabbTree::allocateNode()
+	{
+		if (m_freeList == NULL_NODE) {
+			m_nodes.push_back(Node());
+			return (int)m_nodes.size() - 1;
+		}
+		int index = m_freeList;
+		m_freeList = m_nodes[index].parent;
+		m_nodes[index] = Node();
+		return index;
+	}
+
+	void AabbTree::freeNode(int node)
+	{
+		m_nodes[node].parent = m_freeList;
+		m_nodes[node].height = -1;
+		m_freeList = node;
+	}
+
+	//Walks down to the sibling that grows the total surface area least (Catto's heuristic from Box2D)
+	void AabbTree::insertLeaf(int leaf)
+	{
+		if (m_root == NULL_NODE) {
+			m_root = leaf;
+			m_nodes[leaf].parent = NULL_NODE;
+			return;
+		}
+
+		glm::vec3 leafMin = m_nodes[leaf].boundsMin;
+		glm::vec3 leafMax = m_nodes[leaf].boundsMax;
+		int index = m_root;
+		while (!m_nodes[index].isLeaf()) {
+			const Node& node = m_nodes[index];
+			float area = getArea(node.boundsMin, node.boundsMax);
+			float combinedArea = getArea(glm::min(node.boundsMin, leafMin), glm::max(node.boundsMax, leafMax));
+			//Pairing with this node, or pushing the leaf further down and growing every box on the way
+			float cost = 2.0f * combinedArea;
+			float inheritedCost = 2.0f * (combinedArea - area);
+			float childCosts[2];
+			for (int c = 0; c < 2; c++) {
+				const Node& child = m_nodes[node.children[c]];
+				float grownArea = getArea(glm::min(child.boundsMin, leafMin), glm::max(child.boundsMax, leafMax));
+				childCosts[c] = (child.isLeaf() ? grownArea : grownArea - getArea(child.boundsMin, child.boundsMax)) + inheritedCost;
+			}
+			if (cost < childCosts[0] && cost < childCosts[1]) {
+				break;
+			}
+			index = childCosts[0] < childCosts[1] ? node.children[0] : node.children[1];
+		}
+
+		int sibling = index;
+		int oldParent = m_nodes[sibling].parent;
+		int newParent = allocateNode();
+		Node& parent = m_nodes[newParent];
+		parent.parent = oldParent;
+		parent.boundsMin = glm::min(m_nodes[sibling].boundsMin, leafMin);
+		parent.boundsMax = glm::max(m_nodes[sibling].boundsMax, leafMax);
+		parent.height = m_nodes[sibling].height + 1;
+		parent.children[0] = sibling;
+		parent.children[1] = leaf;
+		m_nodes[sibling].parent = newParent;
+		m_nodes[leaf].parent = newParent;
+		if (oldParent == NULL_NODE) {
+			m_root = newParent;
+		}
+		else {
+			int* children = m_nodes[oldParent].children;
+			children[children[0] == sibling ? 0 : 1] = newParent;
+		}
+		refit(m_nodes[leaf].parent);
+	}
+
+	void AabbTree::removeLeaf(int leaf)
+	{
+		if (leaf == m_root) {
+			m_root = NULL_NODE;
+			return;
+		}
+		int parent = m_nodes[leaf].parent;
+		int grandParent = m_nodes[parent].parent;
+		int sibling = m_nodes[parent].children[m_nodes[parent].children[0] == leaf ? 1 : 0];
+		m_nodes[sibling].parent = grandParent;
+		freeNode(parent);
+		if (grandParent == NULL_NODE) {
+			m_root = sibling;
+			return;
+		}
+		int* children = m_nodes[grandParent].children;
+		children[children[0] == parent ? 0 : 1] = sibling;
+		refit(grandParent);
+	}
+
+	void AabbTree::refit(int node)
+	{
+		int index = node;
+		while (index != NULL_NODE) {
+			index = balance(index);
+			Node& current = m_nodes[index];
+			const Node& a = m_nodes[current.children[0]];
+			const Node& b = m_nodes[current.children[1]];
+			current.height = 1 + std::max(a.height, b.height);
+			current.boundsMin = glm::min(a.boundsMin, b.boundsMin);
+			current.boundsMax = glm::max(a.boundsMax, b.boundsMax);
+			index = current.parent;
+		}
+	}
+
+	//Rotates the taller grandchild subtree up when a's children differ in height by more than one, returns the node now in a's place
+	int AabbTree::balance(int a)
+	{
+		Node& nodeA = m_nodes[a];
+		if (nodeA.isLeaf() || nodeA.height < 2) {
+			return a;
+		}
+		int difference = m_nodes[nodeA.children[1]].height - m_nodes[nodeA.children[0]].height;
+		if (difference >= -1 && difference <= 1) {
+			return a;
+		}
+
+		//up is the taller child that takes a's place, a keeps the other child and one of up's children
+		int tallSide = difference > 1 ? 1 : 0;
+		int up = nodeA.children[tallSide];
+		Node& nodeUp = m_nodes[up];
+		int f = nodeUp.children[0];
+		int g = nodeUp.children[1];
+
+		nodeUp.children[0] = a;
+		nodeUp.parent = nodeA.parent;
+		nodeA.parent = up;
+		if (nodeUp.parent == NULL_NODE) {
+			m_root = up;
+		}
+		else {
+			int* children = m_nodes[nodeUp.parent].children;
+			children[children[0] == a ? 0 : 1] = up;
+		}
+
+		//The taller of f and g stays with up, the shorter moves under a
+		int keep = m_nodes[f].height > m_nodes[g].height ? f : g;
+		int give = keep == f ? g : f;
+		nodeUp.children[1] = keep;
+		nodeA.children[tallSide] = give;
+		m_nodes[give].parent = a;
+
+		const Node& other = m_nodes[nodeA.children[1 - tallSide]];
+		nodeA.boundsMin = glm::min(other.boundsMin, m_nodes[give].boundsMin);
+		nodeA.boundsMax = glm::max(other.boundsMax, m_nodes[give].boundsMax);
+		nodeA.height = 1 + std::max(other.height, m_nodes[give].height);
+		nodeUp.boundsMin = glm::min(nodeA.boundsMin, m_nodes[keep].boundsMin);
+		nodeUp.boundsMax = glm::max(nodeA.boundsMax, m_nodes[keep].boundsMax);
+		nodeUp.height = 1 + std::max(nodeA.height, m_nodes[keep].height);
+		return up;
+	}
+
+	void AabbTree::collect(int node, std::vector<unsigned int>& results) const
+	{
+		std::vector<int> stack;
+		stack.reserve(64);
+		stack.push_back(node);
+		while (!stack.empty()) {
+			const Node& current = m_nodes[stack.back()];
+			stack.pop_back();
+			if (current.isLeaf()) {
+				results.push_back(current.userData);
+				continue;
+			}
+			stack.push_back(current.children[0]);
+			stack.push_back(current.children[1]);
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "frustum.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// Dynamic bounding volume hierarchy over world space boxes, kept balanced with AVL style rotations so queries visit O(log n) nodes.
+	/// Leaves store a box grown by a margin, so objects that move a little update without touching the tree.
+	/// Queries append the userData of every leaf they touch and are safe to run from several threads at once, edits are not.
+	/// </summary>
+	class AabbTree {
+	public:
+		static const int NULL_NODE = -1;
+
+		AabbTree(float margin = 0.1f) : m_margin(margin) {};
+
+		/// <summary>
+		/// Adds an object and returns its proxy, which stays valid until remove()
+		/// </summary>
+		int insert(const glm::vec3& boundsMin, const glm::vec3& boundsMax, unsigned int userData);
+		void remove(int proxy);
+		/// <summary>
+		/// Gives a proxy its new bounds. Returns false without changing anything while they still fit in the grown box,
+		/// otherwise the leaf is reinserted and it returns true.
+		/// </summary>
+		bool update(int proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+		void clear();
+
+		void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& results)const;
+		void querySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& results)const;
+		void queryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<unsigned int>& results)const;
+		/// <summary>
+		/// Every leaf box the ray passes through before maxDistance, unordered. direction needn't be normalized, distances are in its units.
+		/// </summary>
+		void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<unsigned int>& results)const;
+
+		inline unsigned int getUserData(int proxy)const { return m_nodes[proxy].userData; }
+		//The grown box the tree stores, not the one last given
+		inline const glm::vec3& getBoundsMin(int proxy)const { return m_nodes[proxy].boundsMin; }
+		inline const glm::vec3& getBoundsMax(int proxy)const { return m_nodes[proxy].boundsMax; }
+		inline int getNumProxies()const { return m_numProxies; }
+		//Levels from the root to the deepest leaf, 0 when empty
+		inline int getHeight()const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height + 1; }
+		inline float getMargin()const { return m_margin; }
+	private:
+		struct Node {
+			glm::vec3 boundsMin = glm::vec3(0.0f);
+			glm::vec3 boundsMax = glm::vec3(0.0f);
+			int parent = NULL_NODE; //Next free node while on the free list
+			int children[2] = { NULL_NODE, NULL_NODE };
+			int height = -1; //0 for leaves, -1 for free nodes
+			unsigned int userData = 0;
+			inline bool isLeaf()const { return children[0] == NULL_NODE; }
+		};
+
+		int allocateNode();
+		void freeNode(int node);
+		void insertLeaf(int leaf);
+		void removeLeaf(int leaf);
+		int balance(int node);
+		//Refits boxes and heights from node up to the root, rebalancing on the way
+		void refit(int node);
+		//Appends the userData of every leaf under node
+		void collect(int node, std::vector<unsigned int>& results)const;
+
+		std::vector<Node> m_nodes;
+		int m_root = NULL_NODE;
+		int m_freeList = NULL_NODE;
+		int m_numProxies = 0;
+		float m_margin;
+	};
+}
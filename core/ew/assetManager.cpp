@@ -0,0 +1,208 @@
+#include "assetManager.h"
+#include "mappedFile.h"
+#include "texture.h"
+#include "external/glad.h"
+#include <cstdio>
+#include <vector>
+
+namespace ew {
+	std::string normalizeAssetPath(const std::string& filePath)
+	{
+		std::vector<std::string> segments;
+		bool absolute = !filePath.empty() && (filePath[0] == '/' || filePath[0] == '\\');
+		size_t begin = 0;
+		while (begin <= filePath.size()) {
+			size_t end = filePath.find_first_of("/\\", begin);
+			if (end == std::string::npos) {
+				end = filePath.size();
+			}
+			std::string segment = filePath.substr(begin, end - begin);
+			if (segment == "..") {
+				if (!segments.empty() && segments.back() != "..") {
+					segments.pop_back();
+				}
+				else if (!absolute) {
+					segments.push_back(segment);
+				}
+			}
+			else if (!segment.empty() && segment != ".") {
+				segments.push_back(segment);
+			}
+			begin = end + 1;
+		}
+		std::string path = absolute ? "/" : "";
+		for (size_t i = 0; i < segments.size(); i++) {
+			if (i > 0) {
+				path += '/';
+			}
+			path += segments[i];
+		}
+		return path;
+	}
+
+	AssetManager::AssetManager(size_t memoryBudget)
+		: m_memoryBudget(memoryBudget)
+	{
+	}
+
+	std::shared_ptr<const Model> AssetManager::getModel(const std::string& filePath, bool positionStream)
+	{
+		uint64_t contentHash;
+		if (!getContentHash(filePath, contentHash)) {
+			return nullptr;
+		}
+		uint64_t key = hashBytes(&positionStream, sizeof(positionStream), contentHash);
+		std::shared_ptr<const Model> model = find(m_models, key);
+		if (model) {
+			return model;
+		}
+		model = std::make_shared<Model>(filePath, positionStream);
+		insert(m_models, key, model, model->getBufferBytes());
+		return model;
+	}
+
+	std::shared_ptr<const Texture> AssetManager::getTexture(const std::string& filePath)
+	{
+		uint64_t contentHash;
+		if (!getContentHash(filePath, contentHash)) {
+			return nullptr;
+		}
+		std::shared_ptr<const Texture> texture = find(m_textures, contentHash);
+		if (texture) {
+			return texture;
+		}
+		Texture loaded = loadTexture(filePath.c_str());
+		if (!loaded) {
+			return nullptr;
+		}
+		//Estimate from the top level, assuming 4 bytes per texel and a full mip chain
+		int width = 0, height = 0;
+		glGetTextureLevelParameteriv(loaded.get(), 0, GL_TEXTURE_WIDTH, &width);
+		glGetTextureLevelParameteriv(loaded.get(), 0, GL_TEXTURE_HEIGHT, &height);
+		texture = std::make_shared<Texture>(std::move(loaded));
+		insert(m_textures, contentHash, texture, (size_t)width * height * 4 * 4 / 3);
+		return texture;
+	}
+
+	std::shared_ptr<const Shader> AssetManager::getShader(const std::string& vertexShader, const std::string& fragmentShader)
+	{
+		uint64_t vertexHash, fragmentHash;
+		if (!getContentHash(vertexShader, vertexHash) || !getContentHash(fragmentShader, fragmentHash)) {
+			return nullptr;
+		}
+		uint64_t key = hashBytes(&fragmentHash, sizeof(fragmentHash), vertexHash);
+		std::shared_ptr<const Shader> shader = find(m_shaders, key);
+		if (shader) {
+			return shader;
+		}
+		unsigned int vertexStage = getShaderStage(GL_VERTEX_SHADER, vertexShader, vertexHash);
+		unsigned int fragmentStage = getShaderStage(GL_FRAGMENT_SHADER, fragmentShader, fragmentHash);
+		shader = std::make_shared<Shader>(Program(linkShaderProgram(vertexStage, fragmentStage)));
+		insert(m_shaders, key, shader, 0);
+		return shader;
+	}
+
+	void AssetManager::collect()
+	{
+		//Only assets the manager holds the last reference to can go, the rest would just load twice
+		while (m_memoryUsage > m_memoryBudget) {
+			uint64_t oldest = UINT64_MAX;
+			int oldestType = -1;
+			uint64_t oldestKey = 0;
+			auto consider = [&](const auto& entries, int type) {
+				for (const auto& it : entries) {
+					if (it.second.bytes > 0 && it.second.asset.use_count() == 1 && it.second.lastUsed < oldest) {
+						oldest = it.second.lastUsed;
+						oldestType = type;
+						oldestKey = it.first;
+					}
+				}
+			};
+			consider(m_models, 0);
+			consider(m_textures, 1);
+			if (oldestType < 0) {
+				return;
+			}
+			if (oldestType == 0) {
+				m_memoryUsage -= m_models[oldestKey].bytes;
+				m_models.erase(oldestKey);
+			}
+			else {
+				m_memoryUsage -= m_textures[oldestKey].bytes;
+				m_textures.erase(oldestKey);
+			}
+			m_stats.evictions++;
+		}
+	}
+
+	void AssetManager::clear()
+	{
+		m_models.clear();
+		m_textures.clear();
+		m_shaders.clear();
+		m_shaderStages.clear();
+		m_contentHashes.clear();
+		m_memoryUsage = 0;
+	}
+
+	void AssetManager::setMemoryBudget(size_t bytes)
+	{
+		m_memoryBudget = bytes;
+		collect();
+	}
+
+	bool AssetManager::getContentHash(const std::string& filePath, uint64_t& hash)
+	{
+		//Files are hashed the first time their path is seen, call clear() to pick up changes on disk
+		std::string path = normalizeAssetPath(filePath);
+		auto it = m_contentHashes.find(path);
+		if (it != m_contentHashes.end()) {
+			hash = it->second;
+			return true;
+		}
+		uint64_t size;
+		if (!hashFile(path.c_str(), hash, size)) {
+			printf("Failed to load asset %s\n", filePath.c_str());
+			return false;
+		}
+		m_contentHashes[path] = hash;
+		return true;
+	}
+
+	unsigned int AssetManager::getShaderStage(unsigned int shaderType, const std::string& filePath, uint64_t contentHash)
+	{
+		uint64_t key = hashBytes(&shaderType, sizeof(shaderType), contentHash);
+		ShaderStage& stage = m_shaderStages[key];
+		if (!stage) {
+			std::string source = loadShaderSourceFromFile(filePath);
+			stage.reset(createShader(shaderType, source.c_str()));
+			m_stats.shaderStagesCompiled++;
+		}
+		return stage.get();
+	}
+
+	template<typename T>
+	std::shared_ptr<T> AssetManager::find(std::unordered_map<uint64_t, Entry<T>>& entries, uint64_t key)
+	{
+		auto it = entries.find(key);
+		if (it == entries.end()) {
+			return nullptr;
+		}
+		it->second.lastUsed = ++m_useCounter;
+		m_stats.hits++;
+		return it->second.asset;
+	}
+
+	template<typename T>
+	void AssetManager::insert(std::unordered_map<uint64_t, Entry<T>>& entries, uint64_t key, const std::shared_ptr<T>& asset, size_t bytes)
+	{
+		Entry<T>& entry = entries[key];
+		entry.asset = asset;
+		entry.bytes = bytes;
+		entry.lastUsed = ++m_useCounter;
+		m_memoryUsage += bytes;
+		m_stats.loads++;
+		//The new asset is referenced by the caller, so it is never the one evicted
+		collect();
+	}
+}
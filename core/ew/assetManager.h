@@ -0,0 +1,79 @@
+#pragma once
+#include "model.h"
+#include "shader.h"
+#include "glResource.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace ew {
+	/// <summary>
+	/// Lexically normalizes a path so different spellings of one file share a key: forward slashes, no "." or "dir/.." segments.
+	/// </summary>
+	std::string normalizeAssetPath(const std::string& filePath);
+
+	struct AssetStats {
+		int loads = 0; //Requests that had to load, upload or link something
+		int hits = 0; //Requests answered from the cache
+		int shaderStagesCompiled = 0;
+		int evictions = 0;
+	};
+
+	/// <summary>
+	/// Loads models, textures and shaders once and hands out shared handles to them.
+	/// Files are looked up by normalized path and then by content hash, so copies of a file under another path are shared too.
+	/// Each shader stage is compiled once per source and linked into every program that uses it.
+	/// Assets only the manager still holds are evicted least recently used first while the memory estimate is over budget.
+	/// Main thread only, like the rest of the GL code.
+	/// </summary>
+	class AssetManager {
+	public:
+		AssetManager(size_t memoryBudget = (size_t)512 << 20);
+		AssetManager(const AssetManager&) = delete;
+		AssetManager& operator=(const AssetManager&) = delete;
+
+		//Each returns nullptr if the file can't be read
+		std::shared_ptr<const Model> getModel(const std::string& filePath, bool positionStream = false);
+		std::shared_ptr<const Texture> getTexture(const std::string& filePath);
+		std::shared_ptr<const Shader> getShader(const std::string& vertexShader, const std::string& fragmentShader);
+
+		/// <summary>
+		/// Evicts unreferenced assets until the memory estimate fits the budget. Runs after every load.
+		/// </summary>
+		void collect();
+		/// <summary>
+		/// Drops every cached asset and shader stage. Handles already given out stay valid.
+		/// </summary>
+		void clear();
+		void setMemoryBudget(size_t bytes);
+		inline size_t getMemoryBudget()const { return m_memoryBudget; }
+		//Estimated GPU memory of the cached models and textures, shaders count as 0
+		inline size_t getMemoryUsage()const { return m_memoryUsage; }
+		inline const AssetStats& getStats()const { return m_stats; }
+	private:
+		template<typename T>
+		struct Entry {
+			std::shared_ptr<T> asset;
+			size_t bytes = 0;
+			uint64_t lastUsed = 0;
+		};
+
+		bool getContentHash(const std::string& filePath, uint64_t& hash);
+		unsigned int getShaderStage(unsigned int shaderType, const std::string& filePath, uint64_t contentHash);
+		template<typename T>
+		std::shared_ptr<T> find(std::unordered_map<uint64_t, Entry<T>>& entries, uint64_t key);
+		template<typename T>
+		void insert(std::unordered_map<uint64_t, Entry<T>>& entries, uint64_t key, const std::shared_ptr<T>& asset, size_t bytes);
+
+		size_t m_memoryBudget;
+		size_t m_memoryUsage = 0;
+		uint64_t m_useCounter = 0;
+		AssetStats m_stats;
+		std::unordered_map<std::string, uint64_t> m_contentHashes; //Normalized path to file content hash
+		std::unordered_map<uint64_t, Entry<const Model>> m_models;
+		std::unordered_map<uint64_t, Entry<const Texture>> m_textures;
+		std::unordered_map<uint64_t, Entry<const Shader>> m_shaders;
+		std::unordered_map<uint64_t, ShaderStage> m_shaderStages; //Keyed by stage type and source hash
+	};
+}
@@ -0,0 +1,83 @@
+#include "culling.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EW_CULL_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace ew {
+	glm::vec4 getBoundingSphere(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		return glm::vec4((boundsMin + boundsMax) * 0.5f, glm::length(boundsMax - boundsMin) * 0.5f);
+	}
+
+	glm::vec4 transformSphere(const glm::vec4& sphere, const Transform& transform)
+	{
+		glm::vec3 center = transform.position + transform.rotation * (transform.scale * glm::vec3(sphere));
+		glm::vec3 scale = glm::abs(transform.scale);
+		return glm::vec4(center, sphere.w * std::max(scale.x, std::max(scale.y, scale.z)));
+	}
+
+	glm::vec4 transformSphere(const glm::vec4& sphere, const glm::mat4& model)
+	{
+		glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(sphere), 1.0f));
+		float scale2 = std::max(glm::dot(model[0], model[0]), std::max(glm::dot(model[1], model[1]), glm::dot(model[2], model[2])));
+		return glm::vec4(center, sphere.w * std::sqrt(scale2));
+	}
+
+	void transformBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model, glm::vec3& outMin, glm::vec3& outMax)
+	{
+		outMin = outMax = glm::vec3(model[3]);
+		for (int column = 0; column < 3; column++) {
+			glm::vec3 axis = glm::vec3(model[column]);
+			glm::vec3 a = axis * boundsMin[column];
+			glm::vec3 b = axis * boundsMax[column];
+			outMin += glm::min(a, b);
+			outMax += glm::max(a, b);
+		}
+	}
+
+	int cullSpheres(const Frustum& frustum, const glm::vec4* spheres, int count, unsigned int* visible)
+	{
+		//Every index is written and only kept if its sphere is visible, which avoids a branch per sphere
+		unsigned int* out = visible;
+		int numVisible = 0;
+		int i = 0;
+#ifdef EW_CULL_SSE
+		__m128 planes[6][4];
+		for (int p = 0; p < 6; p++) {
+			for (int c = 0; c < 4; c++) {
+				planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+			}
+		}
+		for (; i + 4 <= count; i += 4) {
+			//Four spheres in, x y z r out, one lane per sphere
+			__m128 x = _mm_loadu_ps(&spheres[i].x);
+			__m128 y = _mm_loadu_ps(&spheres[i + 1].x);
+			__m128 z = _mm_loadu_ps(&spheres[i + 2].x);
+			__m128 r = _mm_loadu_ps(&spheres[i + 3].x);
+			_MM_TRANSPOSE4_PS(x, y, z, r);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+					_mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+			}
+			int mask = ~_mm_movemask_ps(outside) & 0xF;
+			for (int lane = 0; lane < 4; lane++) {
+				out[numVisible] = (unsigned int)(i + lane);
+				numVisible += (mask >> lane) & 1;
+			}
+		}
+#endif
+		for (; i < count; i++) {
+			out[numVisible] = (unsigned int)i;
+			numVisible += frustum.intersectsSphere(glm::vec3(spheres[i]), spheres[i].w) ? 1 : 0;
+		}
+		return numVisible;
+	}
+}
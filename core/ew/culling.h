@@ -0,0 +1,27 @@
+#pragma once
+#include "frustum.h"
+#include "transform.h"
+#include <glm/glm.hpp>
+
+namespace ew {
+	/// <summary>
+	/// Sphere through the corners of a box, xyz is the center and w the radius
+	/// </summary>
+	glm::vec4 getBoundingSphere(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	/// <summary>
+	/// Moves a model space sphere into world space. Rotation keeps the radius, scale grows it by the largest axis.
+	/// </summary>
+	glm::vec4 transformSphere(const glm::vec4& sphere, const Transform& transform);
+	glm::vec4 transformSphere(const glm::vec4& sphere, const glm::mat4& model);
+	/// <summary>
+	/// World space box around a model space box after model (Arvo's method)
+	/// </summary>
+	void transformBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model, glm::vec3& outMin, glm::vec3& outMax);
+
+	/// <summary>
+	/// Tests world space bounding spheres against the frustum, four at a time with SSE where it is available.
+	/// Writes the indices of the spheres that intersect it to the front of visible, in order, and returns how many there are.
+	/// visible needs room for count indices.
+	/// </summary>
+	int cullSpheres(const Frustum& frustum, const glm::vec4* spheres, int count, unsigned int* visible);
+}
@@ -0,0 +1,105 @@
+#include "drawList.h"
+#include "glState.h"
+
+namespace ew {
+	void DrawList::begin(const glm::mat4& view, float nearPlane, float farPlane)
+	{
+		m_draws.clear();
+		m_keys.clear();
+		m_programIds.clear();
+		m_textureIds.clear();
+		m_vertexArrayIds.clear();
+		m_view = view;
+		m_nearPlane = nearPlane;
+		m_farPlane = farPlane;
+	}
+
+	unsigned int DrawList::getId(std::unordered_map<unsigned int, unsigned int>& ids, unsigned int name)
+	{
+		auto it = ids.find(name);
+		if (it != ids.end()) {
+			return it->second;
+		}
+		unsigned int id = (unsigned int)ids.size();
+		ids[name] = id;
+		return id;
+	}
+
+	void DrawList::add(const Shader& shader, unsigned int texture, const Mesh& mesh, const glm::mat4& modelMatrix, unsigned int pass)
+	{
+		//Sorted by the vertex array rather than the mesh, meshes in one GeometryPool share it
+		glm::vec4 viewPosition = m_view * modelMatrix[3];
+		uint64_t key = makeSortKey(pass,
+			getId(m_programIds, shader.getProgram()),
+			getId(m_textureIds, texture),
+			getId(m_vertexArrayIds, mesh.getVertexArray()),
+			quantizeDepth(-viewPosition.z, m_nearPlane, m_farPlane));
+		m_keys.push_back({ key, (unsigned int)m_draws.size() });
+		m_draws.push_back({ &shader, texture, &mesh, modelMatrix * mesh.getPositionDecode() });
+	}
+
+	void DrawList::add(const Shader& shader, unsigned int texture, const Model& model, const glm::mat4& modelMatrix, unsigned int pass)
+	{
+		for (const Mesh& mesh : model.getMeshes()) {
+			add(shader, texture, mesh, modelMatrix, pass);
+		}
+	}
+
+	//Counts the binds one more draw needs when only changes are bound
+	static void countBinds(BindCounts& counts, unsigned int& program, unsigned int& texture, unsigned int& vertexArray,
+		unsigned int drawProgram, unsigned int drawTexture, unsigned int drawVertexArray) {
+		if (drawProgram != program) {
+			program = drawProgram;
+			counts.programs++;
+		}
+		if (drawTexture != texture) {
+			texture = drawTexture;
+			counts.textures++;
+		}
+		if (drawVertexArray != vertexArray) {
+			vertexArray = drawVertexArray;
+			counts.vertexArrays++;
+		}
+	}
+
+	void DrawList::submit(bool depthOnly)
+	{
+		m_stats = DrawStats();
+		m_stats.draws = (int)m_draws.size();
+		if (m_draws.empty()) {
+			return;
+		}
+
+		//0 is never a live program or vertex array, and ~0 is never a texture, so the first draw binds everything
+		unsigned int program = 0, texture = ~0u, vertexArray = 0;
+		for (const Draw& draw : m_draws) {
+			countBinds(m_stats.unsortedBinds, program, texture, vertexArray,
+				draw.shader->getProgram(), draw.texture, draw.mesh->getVertexArray(depthOnly));
+		}
+
+		radixSort(m_keys, m_scratch);
+
+		program = 0, texture = ~0u, vertexArray = 0;
+		GLState& state = GLState::get();
+		for (const SortItem& item : m_keys) {
+			const Draw& draw = m_draws[item.index];
+			if (draw.shader->getProgram() != program) {
+				program = draw.shader->getProgram();
+				state.useProgram(program);
+				m_stats.binds.programs++;
+			}
+			if (draw.texture != texture) {
+				texture = draw.texture;
+				state.bindTexture(0, texture);
+				m_stats.binds.textures++;
+			}
+			if (draw.mesh->getVertexArray(depthOnly) != vertexArray) {
+				vertexArray = draw.mesh->getVertexArray(depthOnly);
+				state.bindVertexArray(vertexArray);
+				m_stats.binds.vertexArrays++;
+			}
+			draw.shader->setMat4("_Model", draw.model);
+			draw.mesh->drawBound();
+		}
+	}
+}
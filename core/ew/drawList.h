@@ -0,0 +1,70 @@
+#pragma once
+#include "mesh.h"
+#include "model.h"
+#include "shader.h"
+#include "sortKey.h"
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace ew {
+	struct BindCounts {
+		int programs = 0;
+		int textures = 0;
+		int vertexArrays = 0;
+		inline int total()const { return programs + textures + vertexArrays; }
+	};
+
+	struct DrawStats {
+		int draws = 0;
+		//Binds submit() issued
+		BindCounts binds;
+		//Binds the same draws would have needed in the order they were added, for comparison
+		BindCounts unsortedBinds;
+	};
+
+	/// <summary>
+	/// A frame's draws, sorted by pass, shader, texture, mesh and then front to back before they are issued.
+	/// Submitting skips program, texture and vertex array binds that are already in place.
+	/// </summary>
+	class DrawList {
+	public:
+		DrawList() {};
+		/// <summary>
+		/// Clears the list. view and the planes turn each draw's position into the depth it is sorted by.
+		/// </summary>
+		void begin(const glm::mat4& view, float nearPlane, float farPlane);
+		/// <summary>
+		/// Queues a draw of mesh with texture on unit 0. Lower passes draw first.
+		/// The shader, texture and mesh must stay alive until submit.
+		/// </summary>
+		void add(const Shader& shader, unsigned int texture, const Mesh& mesh, const glm::mat4& modelMatrix, unsigned int pass = 0);
+		void add(const Shader& shader, unsigned int texture, const Model& model, const glm::mat4& modelMatrix, unsigned int pass = 0);
+		/// <summary>
+		/// Sorts and draws everything. Only _Model is set per draw, any other uniforms have to be set on each shader beforehand.
+		/// </summary>
+		void submit(bool depthOnly = false);
+		inline int getNumDraws()const { return (int)m_draws.size(); }
+		inline const DrawStats& getStats()const { return m_stats; }
+	private:
+		struct Draw {
+			const Shader* shader;
+			unsigned int texture;
+			const Mesh* mesh;
+			glm::mat4 model;
+		};
+		//Small ids in first seen order so every field of the sort key is dense
+		static unsigned int getId(std::unordered_map<unsigned int, unsigned int>& ids, unsigned int name);
+
+		std::vector<Draw> m_draws;
+		std::vector<SortItem> m_keys;
+		std::vector<SortItem> m_scratch;
+		std::unordered_map<unsigned int, unsigned int> m_programIds;
+		std::unordered_map<unsigned int, unsigned int> m_textureIds;
+		std::unordered_map<unsigned int, unsigned int> m_vertexArrayIds;
+		glm::mat4 m_view = glm::mat4(1.0f);
+		float m_nearPlane = 0.1f;
+		float m_farPlane = 100.0f;
+		DrawStats m_stats;
+	};
+}
@@ -0,0 +1,54 @@
+#include "frustum.h"
+
+namespace ew {
+	Frustum::Frustum(const glm::mat4& clip)
+	{
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+		}
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		planes[4] = rows[3] + rows[2];
+		planes[5] = rows[3] - rows[2];
+
+		//Normalized so sphere tests can compare distances directly
+		for (int i = 0; i < 6; i++) {
+			float length = glm::length(glm::vec3(planes[i]));
+			if (length > 0.0f) {
+				planes[i] /= length;
+			}
+		}
+	}
+
+	Frustum::Frustum(const Camera& camera)
+		: Frustum(camera.projectionMatrix() * camera.viewMatrix())
+	{
+	}
+
+	bool Frustum::intersectsBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+	{
+		for (int i = 0; i < 6; i++) {
+			glm::vec3 p(
+				planes[i].x >= 0.0f ? boundsMax.x : boundsMin.x,
+				planes[i].y >= 0.0f ? boundsMax.y : boundsMin.y,
+				planes[i].z >= 0.0f ? boundsMax.z : boundsMin.z);
+			if (glm::dot(glm::vec3(planes[i]), p) + planes[i].w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (int i = 0; i < 6; i++) {
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
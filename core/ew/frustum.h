@@ -0,0 +1,21 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "camera.h"
+
+namespace ew {
+	/// <summary>
+	/// Six planes extracted from a clip matrix (Gribb/Hartmann), normals point inward.
+	/// Built from projection * view * model, the planes are in that model's space.
+	/// </summary>
+	struct Frustum {
+		glm::vec4 planes[6];
+
+		Frustum() {};
+		Frustum(const glm::mat4& clip);
+		//World space planes of what the camera sees
+		Frustum(const Camera& camera);
+		//p-vertex test, conservative near the corners
+		bool intersectsBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax)const;
+		bool intersectsSphere(const glm::vec3& center, float radius)const;
+	};
+}
@@ -0,0 +1,201 @@
+#include "geometryPool.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+namespace ew {
+	RangeAllocator::RangeAllocator(unsigned int capacity)
+	{
+		grow(capacity);
+	}
+
+	bool RangeAllocator::allocate(unsigned int size, unsigned int& offset)
+	{
+		for (size_t i = 0; i < m_freeBlocks.size(); i++) {
+			Block& block = m_freeBlocks[i];
+			if (block.size < size) {
+				continue;
+			}
+			offset = block.offset;
+			block.offset += size;
+			block.size -= size;
+			if (block.size == 0) {
+				m_freeBlocks.erase(m_freeBlocks.begin() + i);
+			}
+			m_used += size;
+			return true;
+		}
+		return false;
+	}
+
+	void RangeAllocator::free(unsigned int offset, unsigned int size)
+	{
+		if (size == 0) {
+			return;
+		}
+		auto next = std::lower_bound(m_freeBlocks.begin(), m_freeBlocks.end(), offset, [](const Block& block, unsigned int offset) {
+			return block.offset < offset;
+		});
+		m_used -= size;
+		//Merge into the block before and/or after when they touch
+		bool mergePrevious = next != m_freeBlocks.begin() && (next - 1)->offset + (next - 1)->size == offset;
+		bool mergeNext = next != m_freeBlocks.end() && offset + size == next->offset;
+		if (mergePrevious && mergeNext) {
+			(next - 1)->size += size + next->size;
+			m_freeBlocks.erase(next);
+		}
+		else if (mergePrevious) {
+			(next - 1)->size += size;
+		}
+		else if (mergeNext) {
+			next->offset = offset;
+			next->size += size;
+		}
+		else {
+			m_freeBlocks.insert(next, { offset, size });
+		}
+	}
+
+	void RangeAllocator::grow(unsigned int capacity)
+	{
+		if (capacity <= m_capacity) {
+			return;
+		}
+		unsigned int added = capacity - m_capacity;
+		unsigned int offset = m_capacity;
+		m_capacity = capacity;
+		//Counted as used until free() hands it back, so free() can do the merging
+		m_used += added;
+		free(offset, added);
+	}
+
+	GeometryPool::GeometryPool(VertexFormat format, bool positionStream, unsigned int vertexCapacity, unsigned int indexCapacity)
+		: m_format(format)
+	{
+		//Buffers are created by the first grow
+		m_vao = VertexArray::create();
+		if (positionStream) {
+			m_depthVao = VertexArray::create();
+		}
+		growVertices(std::max(vertexCapacity, 1u));
+		growIndices(std::max(indexCapacity, 1u));
+	}
+
+	bool GeometryPool::allocate(const Vertex* vertices, size_t numVertices, const unsigned int* indices, size_t numIndices,
+		const glm::mat4& positionDecode, unsigned int& firstVertex, unsigned int& firstIndex)
+	{
+		if (numVertices > 0xFFFFFFFFu / 2 || numIndices > 0xFFFFFFFFu / 2) {
+			printf("ERROR in GeometryPool: Mesh with %zu vertices and %zu indices is too large\n", numVertices, numIndices);
+			return false;
+		}
+		while (!m_vertexRanges.allocate((unsigned int)numVertices, firstVertex)) {
+			growVertices(std::max(m_vertexRanges.getCapacity() * 2, m_vertexRanges.getCapacity() + (unsigned int)numVertices));
+		}
+		while (!m_indexRanges.allocate((unsigned int)numIndices, firstIndex)) {
+			growIndices(std::max(m_indexRanges.getCapacity() * 2, m_indexRanges.getCapacity() + (unsigned int)numIndices));
+		}
+
+		int stride = m_format.getStride();
+		std::vector<unsigned char> data;
+		if (numVertices > 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, m_vbo.get());
+			if (stride == sizeof(Vertex)) {
+				glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)firstVertex * stride, numVertices * sizeof(Vertex), vertices);
+			}
+			else {
+				packVertices(vertices, numVertices, m_format, positionDecode, data);
+				glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)firstVertex * stride, data.size(), data.data());
+			}
+			if (m_positionVbo) {
+				packPositions(vertices, numVertices, m_format, positionDecode, data);
+				glBindBuffer(GL_ARRAY_BUFFER, m_positionVbo.get());
+				glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)firstVertex * m_format.getPositionSize(), data.size(), data.data());
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		if (numIndices > 0) {
+			//Bound to the copy target so no vertex array's element binding is touched
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo.get());
+			glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * sizeof(unsigned int), numIndices * sizeof(unsigned int), indices);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		return true;
+	}
+
+	void GeometryPool::free(unsigned int firstVertex, unsigned int numVertices, unsigned int firstIndex, unsigned int numIndices)
+	{
+		m_vertexRanges.free(firstVertex, numVertices);
+		m_indexRanges.free(firstIndex, numIndices);
+	}
+
+	void GeometryPool::bind(bool depthOnly) const
+	{
+		GLState::get().bindVertexArray(getVertexArray(depthOnly));
+	}
+
+	unsigned int GeometryPool::getVertexArray(bool depthOnly) const
+	{
+		return depthOnly && m_depthVao ? m_depthVao.get() : m_vao.get();
+	}
+
+	size_t GeometryPool::getBufferBytes() const
+	{
+		size_t bytes = (size_t)getVertexCapacity() * m_format.getStride() + (size_t)getIndexCapacity() * sizeof(unsigned int);
+		if (m_positionVbo) {
+			bytes += (size_t)getVertexCapacity() * m_format.getPositionSize();
+		}
+		return bytes;
+	}
+
+	//Copies the old contents into a bigger buffer, the old one is deleted when the handle is replaced
+	static void growBuffer(Buffer& buffer, size_t oldSize, size_t newSize) {
+		Buffer grown = Buffer::create();
+		glBindBuffer(GL_COPY_WRITE_BUFFER, grown.get());
+		glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+		if (oldSize > 0) {
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer.get());
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		buffer = std::move(grown);
+	}
+
+	void GeometryPool::growVertices(unsigned int capacity)
+	{
+		unsigned int oldCapacity = m_vertexRanges.getCapacity();
+		growBuffer(m_vbo, (size_t)oldCapacity * m_format.getStride(), (size_t)capacity * m_format.getStride());
+		if (m_depthVao) {
+			growBuffer(m_positionVbo, (size_t)oldCapacity * m_format.getPositionSize(), (size_t)capacity * m_format.getPositionSize());
+		}
+		m_vertexRanges.grow(capacity);
+		setupVertexArrays();
+	}
+
+	void GeometryPool::growIndices(unsigned int capacity)
+	{
+		growBuffer(m_ebo, (size_t)m_indexRanges.getCapacity() * sizeof(unsigned int), (size_t)capacity * sizeof(unsigned int));
+		m_indexRanges.grow(capacity);
+		setupVertexArrays();
+	}
+
+	//Vertex arrays capture buffer names, so they are pointed at the new ones after every resize
+	void GeometryPool::setupVertexArrays()
+	{
+		GLState::get().bindVertexArray(m_vao.get());
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo.get());
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo.get());
+		setVertexAttributes(m_format);
+		if (m_depthVao) {
+			GLState::get().bindVertexArray(m_depthVao.get());
+			glBindBuffer(GL_ARRAY_BUFFER, m_positionVbo.get());
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo.get());
+			setPositionAttribute(m_format, m_format.getPositionSize());
+		}
+		GLState::get().bindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+}
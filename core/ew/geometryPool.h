@@ -0,0 +1,75 @@
+#pragma once
+#include "mesh.h"
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// First fit free list over [0, capacity). Neighbouring free blocks are merged when a range is freed.
+	/// </summary>
+	class RangeAllocator {
+	public:
+		RangeAllocator(unsigned int capacity = 0);
+		//Returns false if no free block is large enough
+		bool allocate(unsigned int size, unsigned int& offset);
+		void free(unsigned int offset, unsigned int size);
+		//Adds free space at the end
+		void grow(unsigned int capacity);
+		inline unsigned int getCapacity()const { return m_capacity; }
+		inline unsigned int getUsed()const { return m_used; }
+		inline int getNumFreeBlocks()const { return (int)m_freeBlocks.size(); }
+	private:
+		struct Block {
+			unsigned int offset;
+			unsigned int size;
+		};
+		std::vector<Block> m_freeBlocks; //Sorted by offset
+		unsigned int m_capacity = 0;
+		unsigned int m_used = 0;
+	};
+
+	/// <summary>
+	/// Shared vertex and index buffers that many meshes are suballocated from, with one vertex array per vertex format.
+	/// Meshes drawn from the same pool only need glDrawElementsBaseVertex between them, no vertex array switches.
+	/// Indices are 32-bit and relative to each mesh's first vertex. The buffers double in size when they run out.
+	/// </summary>
+	class GeometryPool {
+	public:
+		/// <param name="positionStream">Also keep a position-only copy with its own vertex array for Mesh::drawDepth</param>
+		GeometryPool(VertexFormat format = VertexFormat(), bool positionStream = false, unsigned int vertexCapacity = 1 << 16, unsigned int indexCapacity = 1 << 18);
+		//Meshes keep a pointer to their pool
+		GeometryPool(const GeometryPool&) = delete;
+		GeometryPool& operator=(const GeometryPool&) = delete;
+
+		/// <summary>
+		/// Uploads a mesh into free ranges. Used by Mesh::load, positionDecode is only read for quantized positions.
+		/// </summary>
+		bool allocate(const Vertex* vertices, size_t numVertices, const unsigned int* indices, size_t numIndices,
+			const glm::mat4& positionDecode, unsigned int& firstVertex, unsigned int& firstIndex);
+		void free(unsigned int firstVertex, unsigned int numVertices, unsigned int firstIndex, unsigned int numIndices);
+		//Binds the vertex array every pooled mesh draws from
+		void bind(bool depthOnly = false)const;
+		//The vertex array bind() binds, the full one if there is no position stream
+		unsigned int getVertexArray(bool depthOnly = false)const;
+
+		inline const VertexFormat& getVertexFormat()const { return m_format; }
+		inline bool hasPositionStream()const { return (bool)m_depthVao; }
+		inline unsigned int getVertexCapacity()const { return m_vertexRanges.getCapacity(); }
+		inline unsigned int getIndexCapacity()const { return m_indexRanges.getCapacity(); }
+		inline unsigned int getNumVertices()const { return m_vertexRanges.getUsed(); }
+		inline unsigned int getNumIndices()const { return m_indexRanges.getUsed(); }
+		size_t getBufferBytes()const;
+	private:
+		void growVertices(unsigned int capacity);
+		void growIndices(unsigned int capacity);
+		void setupVertexArrays();
+
+		VertexFormat m_format;
+		VertexArray m_vao;
+		Buffer m_vbo;
+		Buffer m_ebo;
+		VertexArray m_depthVao;
+		Buffer m_positionVbo;
+		RangeAllocator m_vertexRanges;
+		RangeAllocator m_indexRanges;
+	};
+}
@@ -0,0 +1,75 @@
+#include "glResource.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <cstdio>
+
+namespace ew {
+#ifndef NDEBUG
+	static std::atomic<int> s_liveObjects[(int)GLObjectType::COUNT];
+#endif
+
+	unsigned int createGLObject(GLObjectType type) {
+		unsigned int id = 0;
+		switch (type) {
+		case GLObjectType::BUFFER: glGenBuffers(1, &id); break;
+		case GLObjectType::VERTEX_ARRAY: glGenVertexArrays(1, &id); break;
+		case GLObjectType::TEXTURE: glGenTextures(1, &id); break;
+		case GLObjectType::FRAMEBUFFER: glGenFramebuffers(1, &id); break;
+		case GLObjectType::RENDERBUFFER: glGenRenderbuffers(1, &id); break;
+		case GLObjectType::PROGRAM: id = glCreateProgram(); break;
+		default: break;
+		}
+		return id;
+	}
+
+	void deleteGLObject(GLObjectType type, unsigned int id) {
+		//Handles in globals outlive glfwTerminate
+		if (id == 0 || glfwGetCurrentContext() == nullptr) {
+			return;
+		}
+		switch (type) {
+		case GLObjectType::BUFFER: glDeleteBuffers(1, &id); break;
+		case GLObjectType::VERTEX_ARRAY: glDeleteVertexArrays(1, &id); break;
+		case GLObjectType::TEXTURE: glDeleteTextures(1, &id); break;
+		case GLObjectType::FRAMEBUFFER: glDeleteFramebuffers(1, &id); break;
+		case GLObjectType::RENDERBUFFER: glDeleteRenderbuffers(1, &id); break;
+		case GLObjectType::PROGRAM: glDeleteProgram(id); break;
+		case GLObjectType::SHADER: glDeleteShader(id); break;
+		default: break;
+		}
+		GLState::get().forget(type, id);
+	}
+
+	void trackGLObject(GLObjectType type, int delta) {
+#ifndef NDEBUG
+		s_liveObjects[(int)type] += delta;
+#endif
+	}
+
+	int getNumLiveGLObjects(GLObjectType type) {
+#ifndef NDEBUG
+		return s_liveObjects[(int)type];
+#else
+		return 0;
+#endif
+	}
+
+	const char* getGLObjectTypeName(GLObjectType type) {
+		static const char* names[(int)GLObjectType::COUNT] = {
+			"Buffers", "Vertex arrays", "Textures", "Framebuffers", "Renderbuffers", "Programs", "Shader stages"
+		};
+		return names[(int)type];
+	}
+
+	/// <summary>
+	/// Prints how many objects of each type are owned by a handle. Call it where
+	/// everything should have been released to find leaks.
+	/// </summary>
+	void printLiveGLObjects() {
+		for (int i = 0; i < (int)GLObjectType::COUNT; i++) {
+			printf("%s: %d\n", getGLObjectTypeName((GLObjectType)i), getNumLiveGLObjects((GLObjectType)i));
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+namespace ew {
+	enum class GLObjectType {
+		BUFFER = 0,
+		VERTEX_ARRAY,
+		TEXTURE,
+		FRAMEBUFFER,
+		RENDERBUFFER,
+		PROGRAM,
+		SHADER,
+		COUNT
+	};
+
+	unsigned int createGLObject(GLObjectType type);
+	//Does nothing without a current context, the objects went away with it
+	void deleteGLObject(GLObjectType type, unsigned int id);
+
+	//Live object counts are only tracked in debug builds, release builds always report 0
+	void trackGLObject(GLObjectType type, int delta);
+	int getNumLiveGLObjects(GLObjectType type);
+	const char* getGLObjectTypeName(GLObjectType type);
+	void printLiveGLObjects();
+
+	//Owns one GL object name. Move-only, the object is deleted when the handle is destroyed or reset.
+	template<GLObjectType Type>
+	class GLHandle {
+	public:
+		GLHandle() {};
+		explicit GLHandle(unsigned int id) : m_id(id) {
+			if (m_id != 0) {
+				trackGLObject(Type, 1);
+			}
+		}
+		~GLHandle() { reset(); }
+		GLHandle(const GLHandle&) = delete;
+		GLHandle& operator=(const GLHandle&) = delete;
+		//Ownership moves along with the tracked count, so neither side touches it
+		GLHandle(GLHandle&& other) noexcept : m_id(other.m_id) { other.m_id = 0; }
+		GLHandle& operator=(GLHandle&& other) noexcept {
+			if (this != &other) {
+				reset(other.release());
+			}
+			return *this;
+		}
+
+		static GLHandle create() { return GLHandle(createGLObject(Type)); }
+
+		//Deletes the owned object and takes ownership of id instead
+		void reset(unsigned int id = 0) {
+			if (m_id != 0) {
+				deleteGLObject(Type, m_id);
+				trackGLObject(Type, -1);
+			}
+			m_id = id;
+			if (m_id != 0) {
+				trackGLObject(Type, 1);
+			}
+		}
+		//Gives up ownership without deleting
+		unsigned int release() {
+			unsigned int id = m_id;
+			if (m_id != 0) {
+				trackGLObject(Type, -1);
+			}
+			m_id = 0;
+			return id;
+		}
+
+		inline unsigned int get()const { return m_id; }
+		inline explicit operator bool()const { return m_id != 0; }
+	private:
+		unsigned int m_id = 0;
+	};
+
+	using Buffer = GLHandle<GLObjectType::BUFFER>;
+	using VertexArray = GLHandle<GLObjectType::VERTEX_ARRAY>;
+	using Texture = GLHandle<GLObjectType::TEXTURE>;
+	using Framebuffer = GLHandle<GLObjectType::FRAMEBUFFER>;
+	using Renderbuffer = GLHandle<GLObjectType::RENDERBUFFER>;
+	using Program = GLHandle<GLObjectType::PROGRAM>;
+	//Stages need a type to be created, pass glCreateShader's result to reset() instead of using create()
+	using ShaderStage = GLHandle<GLObjectType::SHADER>;
+}
@@ -0,0 +1,271 @@
+#include "glState.h"
+#include "external/glad.h"
+#include <cstdio>
+
+namespace ew {
+	static const GLenum s_cullFaces[] = { GL_BACK, GL_FRONT, GL_FRONT_AND_BACK };
+	static const GLenum s_polygonModes[] = { GL_FILL, GL_LINE, GL_POINT };
+
+	static unsigned int getInteger(GLenum name) {
+		GLint value = 0;
+		glGetIntegerv(name, &value);
+		return (unsigned int)value;
+	}
+
+	//Only reports state the cache claims to know
+	static void check(const char* what, unsigned int cached, unsigned int actual) {
+		if (cached != ~0u && cached != actual) {
+			printf("GLState: cached %s %u but GL has %u\n", what, cached, actual);
+		}
+	}
+
+	static GLenum getTextureBinding(GLenum target) {
+		switch (target) {
+		case GL_TEXTURE_2D_ARRAY: return GL_TEXTURE_BINDING_2D_ARRAY;
+		case GL_TEXTURE_3D: return GL_TEXTURE_BINDING_3D;
+		case GL_TEXTURE_CUBE_MAP: return GL_TEXTURE_BINDING_CUBE_MAP;
+		case GL_TEXTURE_2D_MULTISAMPLE: return GL_TEXTURE_BINDING_2D_MULTISAMPLE;
+		default: return GL_TEXTURE_BINDING_2D;
+		}
+	}
+
+	GLState& GLState::get()
+	{
+		static GLState state;
+		return state;
+	}
+
+	void GLState::setEnabled(bool enabled)
+	{
+		m_enabled = enabled;
+		invalidate();
+	}
+
+	void GLState::invalidate()
+	{
+		m_program = UNKNOWN;
+		m_vertexArray = UNKNOWN;
+		for (int i = 0; i < NUM_TEXTURE_UNITS; i++) {
+			m_textures[i] = UNKNOWN;
+			m_textureTargets[i] = GL_TEXTURE_2D;
+		}
+		m_framebuffer = UNKNOWN;
+		m_viewport[2] = m_viewport[3] = -1;
+		m_cullEnabled = m_cullFace = UNKNOWN;
+		m_depthTest = m_depthWrite = UNKNOWN;
+		m_blend = m_blendSource = m_blendDestination = UNKNOWN;
+		m_polygonMode = UNKNOWN;
+	}
+
+	void GLState::beginFrame()
+	{
+		m_lastFrameStats = m_stats;
+		m_stats = GLStateStats();
+		invalidate();
+	}
+
+	bool GLState::elide(bool unchanged)
+	{
+		if (m_enabled && unchanged) {
+			m_stats.elided++;
+			return true;
+		}
+		m_stats.issued++;
+		return false;
+	}
+
+	void GLState::useProgram(unsigned int program)
+	{
+		if (m_validate) {
+			check("program", m_program, getInteger(GL_CURRENT_PROGRAM));
+		}
+		if (elide(m_program == program)) {
+			return;
+		}
+		glUseProgram(program);
+		m_program = program;
+	}
+
+	void GLState::bindVertexArray(unsigned int vertexArray)
+	{
+		if (m_validate) {
+			check("vertex array", m_vertexArray, getInteger(GL_VERTEX_ARRAY_BINDING));
+		}
+		if (elide(m_vertexArray == vertexArray)) {
+			return;
+		}
+		glBindVertexArray(vertexArray);
+		m_vertexArray = vertexArray;
+	}
+
+	void GLState::bindTexture(unsigned int unit, unsigned int texture, unsigned int target)
+	{
+		if (unit >= (unsigned int)NUM_TEXTURE_UNITS) {
+			elide(false);
+			glBindTextureUnit(unit, texture);
+			return;
+		}
+		if (m_validate && m_textures[unit] != UNKNOWN) {
+			//Texture bindings can only be read through the active unit
+			GLenum active = getInteger(GL_ACTIVE_TEXTURE);
+			glActiveTexture(GL_TEXTURE0 + unit);
+			check("texture", m_textures[unit], getInteger(getTextureBinding(m_textureTargets[unit])));
+			glActiveTexture(active);
+		}
+		if (elide(m_textures[unit] == texture)) {
+			return;
+		}
+		glBindTextureUnit(unit, texture);
+		m_textures[unit] = texture;
+		m_textureTargets[unit] = target;
+	}
+
+	void GLState::bindFramebuffer(unsigned int framebuffer)
+	{
+		if (m_validate) {
+			check("draw framebuffer", m_framebuffer, getInteger(GL_DRAW_FRAMEBUFFER_BINDING));
+			check("read framebuffer", m_framebuffer, getInteger(GL_READ_FRAMEBUFFER_BINDING));
+		}
+		if (elide(m_framebuffer == framebuffer)) {
+			return;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		m_framebuffer = framebuffer;
+	}
+
+	void GLState::setViewport(int x, int y, int width, int height)
+	{
+		if (m_validate && m_viewport[2] >= 0) {
+			GLint actual[4];
+			glGetIntegerv(GL_VIEWPORT, actual);
+			for (int i = 0; i < 4; i++) {
+				check("viewport", (unsigned int)m_viewport[i], (unsigned int)actual[i]);
+			}
+		}
+		if (elide(m_viewport[0] == x && m_viewport[1] == y && m_viewport[2] == width && m_viewport[3] == height)) {
+			return;
+		}
+		glViewport(x, y, width, height);
+		m_viewport[0] = x;
+		m_viewport[1] = y;
+		m_viewport[2] = width;
+		m_viewport[3] = height;
+	}
+
+	//glEnable/glDisable through the cached value
+	static void setCapability(bool validate, GLenum capability, const char* what, unsigned int& cached, bool enabled, bool elided) {
+		if (validate) {
+			check(what, cached, glIsEnabled(capability) ? 1 : 0);
+		}
+		if (elided) {
+			return;
+		}
+		if (enabled) {
+			glEnable(capability);
+		}
+		else {
+			glDisable(capability);
+		}
+		cached = enabled ? 1 : 0;
+	}
+
+	void GLState::setCullFace(bool enabled, CullFace face)
+	{
+		setCapability(m_validate, GL_CULL_FACE, "face culling", m_cullEnabled, enabled, elide(m_cullEnabled == (enabled ? 1u : 0u)));
+		if (!enabled) {
+			return;
+		}
+		GLenum mode = s_cullFaces[(int)face];
+		if (m_validate) {
+			check("cull face", m_cullFace, getInteger(GL_CULL_FACE_MODE));
+		}
+		if (elide(m_cullFace == mode)) {
+			return;
+		}
+		glCullFace(mode);
+		m_cullFace = mode;
+	}
+
+	void GLState::setDepthTest(bool enabled)
+	{
+		setCapability(m_validate, GL_DEPTH_TEST, "depth test", m_depthTest, enabled, elide(m_depthTest == (enabled ? 1u : 0u)));
+	}
+
+	void GLState::setDepthWrite(bool enabled)
+	{
+		if (m_validate) {
+			check("depth write", m_depthWrite, getInteger(GL_DEPTH_WRITEMASK) ? 1 : 0);
+		}
+		if (elide(m_depthWrite == (enabled ? 1u : 0u))) {
+			return;
+		}
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+		m_depthWrite = enabled ? 1 : 0;
+	}
+
+	void GLState::setBlend(bool enabled)
+	{
+		setCapability(m_validate, GL_BLEND, "blending", m_blend, enabled, elide(m_blend == (enabled ? 1u : 0u)));
+	}
+
+	void GLState::setBlendFunc(unsigned int source, unsigned int destination)
+	{
+		if (m_validate) {
+			check("blend source", m_blendSource, getInteger(GL_BLEND_SRC_RGB));
+			check("blend destination", m_blendDestination, getInteger(GL_BLEND_DST_RGB));
+		}
+		if (elide(m_blendSource == source && m_blendDestination == destination)) {
+			return;
+		}
+		glBlendFunc(source, destination);
+		m_blendSource = source;
+		m_blendDestination = destination;
+	}
+
+	void GLState::setPolygonMode(PolygonMode mode)
+	{
+		GLenum glMode = s_polygonModes[(int)mode];
+		if (m_validate) {
+			//Some drivers still write front and back
+			GLint actual[2] = { 0, 0 };
+			glGetIntegerv(GL_POLYGON_MODE, actual);
+			check("polygon mode", m_polygonMode, (unsigned int)actual[0]);
+		}
+		if (elide(m_polygonMode == glMode)) {
+			return;
+		}
+		glPolygonMode(GL_FRONT_AND_BACK, glMode);
+		m_polygonMode = glMode;
+	}
+
+	void GLState::forget(GLObjectType type, unsigned int id)
+	{
+		switch (type) {
+		case GLObjectType::PROGRAM:
+			//A deleted program stays in use until something else is, but its name can come back
+			if (m_program == id) {
+				m_program = UNKNOWN;
+			}
+			break;
+		case GLObjectType::VERTEX_ARRAY:
+			if (m_vertexArray == id) {
+				m_vertexArray = 0;
+			}
+			break;
+		case GLObjectType::TEXTURE:
+			for (int i = 0; i < NUM_TEXTURE_UNITS; i++) {
+				if (m_textures[i] == id) {
+					m_textures[i] = 0;
+				}
+			}
+			break;
+		case GLObjectType::FRAMEBUFFER:
+			if (m_framebuffer == id) {
+				m_framebuffer = 0;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
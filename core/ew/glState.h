@@ -0,0 +1,96 @@
+#pragma once
+#include "glResource.h"
+
+namespace ew {
+	enum class CullFace {
+		BACK = 0,
+		FRONT,
+		FRONT_AND_BACK
+	};
+
+	enum class PolygonMode {
+		FILL = 0,
+		LINE,
+		POINT
+	};
+
+	struct GLStateStats {
+		int issued = 0; //Calls that reached the driver
+		int elided = 0; //Calls skipped because the state was already set
+	};
+
+	/// <summary>
+	/// Shadows the GL state that goes through it and skips calls that would set what is already set.
+	/// That is only safe while nothing changes the same state behind its back, so elision is off until setEnabled(true)
+	/// and every call goes to the driver before then. Code that has to call GL directly can invalidate() afterwards.
+	/// There is one cache, for the one context the assignments create.
+	/// </summary>
+	class GLState {
+	public:
+		static GLState& get();
+
+		void setEnabled(bool enabled);
+		inline bool isEnabled()const { return m_enabled; }
+		/// <summary>
+		/// Compares the cache with glGet before every call and prints where they disagree. Slow, for finding raw GL calls.
+		/// </summary>
+		inline void setValidation(bool validate) { m_validate = validate; }
+		inline bool isValidating()const { return m_validate; }
+		//Forgets everything, the next call of each kind is issued
+		void invalidate();
+		/// <summary>
+		/// Starts the next frame's counters. Also invalidates, so state changed outside the cache between frames can't leak in.
+		/// </summary>
+		void beginFrame();
+		//Counters of the frame in progress, and of the one before the last beginFrame
+		inline const GLStateStats& getStats()const { return m_stats; }
+		inline const GLStateStats& getLastFrameStats()const { return m_lastFrameStats; }
+
+		void useProgram(unsigned int program);
+		void bindVertexArray(unsigned int vertexArray);
+		/// <summary>
+		/// Binds with glBindTextureUnit, so the active texture unit doesn't matter.
+		/// target is the texture's type, it is only needed to validate.
+		/// </summary>
+		void bindTexture(unsigned int unit, unsigned int texture, unsigned int target = 0x0DE1 /*GL_TEXTURE_2D*/);
+		//Both the draw and read framebuffer
+		void bindFramebuffer(unsigned int framebuffer);
+		void setViewport(int x, int y, int width, int height);
+		void setCullFace(bool enabled, CullFace face = CullFace::BACK);
+		void setDepthTest(bool enabled);
+		void setDepthWrite(bool enabled);
+		void setBlend(bool enabled);
+		void setBlendFunc(unsigned int source, unsigned int destination);
+		void setPolygonMode(PolygonMode mode);
+
+		//Deleted objects are unbound by GL and their names can be reused, called by deleteGLObject
+		void forget(GLObjectType type, unsigned int id);
+	private:
+		GLState() { invalidate(); }
+		//Counts the call and returns true if it can be skipped
+		bool elide(bool unchanged);
+
+		static const unsigned int UNKNOWN = ~0u;
+		static const int NUM_TEXTURE_UNITS = 32;
+
+		bool m_enabled = false;
+		bool m_validate = false;
+		GLStateStats m_stats;
+		GLStateStats m_lastFrameStats;
+
+		unsigned int m_program = UNKNOWN;
+		unsigned int m_vertexArray = UNKNOWN;
+		unsigned int m_textures[NUM_TEXTURE_UNITS];
+		unsigned int m_textureTargets[NUM_TEXTURE_UNITS];
+		unsigned int m_framebuffer = UNKNOWN;
+		int m_viewport[4] = { 0, 0, -1, -1 };
+		unsigned int m_cullEnabled = UNKNOWN;
+		unsigned int m_cullFace = UNKNOWN;
+		unsigned int m_depthTest = UNKNOWN;
+		unsigned int m_depthWrite = UNKNOWN;
+		unsigned int m_blend = UNKNOWN;
+		unsigned int m_blendSource = UNKNOWN;
+		unsigned int m_blendDestination = UNKNOWN;
+		unsigned int m_polygonMode = UNKNOWN;
+	};
+}
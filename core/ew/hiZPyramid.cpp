@@ -0,0 +1,52 @@
+#include "hiZPyramid.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <algorithm>
+
+namespace ew {
+	void HiZPyramid::build(const Shader& buildShader, unsigned int depthTexture, int width, int height)
+	{
+		if (width <= 0 || height <= 0) {
+			return;
+		}
+		if (width != m_width || height != m_height) {
+			allocate(width, height);
+		}
+
+		GLState::get().bindTexture(0, depthTexture);
+		buildShader.use();
+		for (int level = 0; level < m_numLevels; level++) {
+			//Level 0 only writes, the source binding just has to be valid
+			glBindImageTexture(0, m_texture.get(), std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+			glBindImageTexture(1, m_texture.get(), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			buildShader.setInt("_Level", level);
+			int levelWidth = std::max(m_width >> level, 1);
+			int levelHeight = std::max(m_height >> level, 1);
+			buildShader.dispatch((levelWidth + LOCAL_SIZE - 1) / LOCAL_SIZE, (levelHeight + LOCAL_SIZE - 1) / LOCAL_SIZE);
+			//Each level reads the one written before it
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		}
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		m_built = true;
+	}
+
+	void HiZPyramid::allocate(int width, int height)
+	{
+		m_width = width;
+		m_height = height;
+		m_numLevels = 1;
+		while ((std::max(width, height) >> m_numLevels) > 0) {
+			m_numLevels++;
+		}
+		//Immutable storage needs a texture created with its target, so it isn't made with Texture::create()
+		unsigned int texture;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		m_texture.reset(texture);
+		glTextureStorage2D(texture, m_numLevels, GL_R32F, width, height);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		m_built = false;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "shader.h"
+#include "glResource.h"
+
+namespace ew {
+	/// <summary>
+	/// Mip chain of a depth buffer where every texel keeps the farthest depth under it, for occlusion tests.
+	/// Anything whose nearest depth is farther than every texel its screen rect covers is hidden behind what was drawn.
+	/// Built with a compute shader that reads this layout:
+	/// layout(binding = 0) uniform sampler2D _Depth;
+	/// layout(r32f, binding = 0) readonly uniform image2D _Source;
+	/// layout(r32f, binding = 1) writeonly uniform image2D _Destination;
+	/// uniform int _Level; //0 copies _Depth, higher levels reduce _Source, the level below
+	/// </summary>
+	class HiZPyramid {
+	public:
+		static const int LOCAL_SIZE = 8;
+
+		HiZPyramid() {};
+		/// <summary>
+		/// Rebuilds every level from a depth texture, reallocating first if the size changed
+		/// </summary>
+		void build(const Shader& buildShader, unsigned int depthTexture, int width, int height);
+		inline unsigned int getTexture()const { return m_texture.get(); }
+		inline int getWidth()const { return m_width; }
+		inline int getHeight()const { return m_height; }
+		inline int getNumLevels()const { return m_numLevels; }
+		inline bool isBuilt()const { return m_built; }
+		//Until the next build, e.g. when the depth it holds no longer matches the view it is tested against
+		inline void invalidate() { m_built = false; }
+	private:
+		void allocate(int width, int height);
+
+		Texture m_texture;
+		int m_width = 0;
+		int m_height = 0;
+		int m_numLevels = 0;
+		bool m_built = false;
+	};
+}
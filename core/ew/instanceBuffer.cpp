@@ -0,0 +1,34 @@
+#include "instanceBuffer.h"
+#include "external/glad.h"
+
+namespace ew {
+	static_assert(sizeof(InstanceData) == 80, "InstanceData must match the std430 layout in the shaders");
+
+	void InstanceBuffer::upload(const InstanceData* instances, int count)
+	{
+		if (!m_buffer) {
+			m_buffer = Buffer::create();
+		}
+		m_count = count > 0 ? count : 0;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer.get());
+		if (m_count > m_capacity) {
+			m_capacity = m_capacity * 2 > m_count ? m_capacity * 2 : m_count;
+		}
+		//Orphan the old storage, then fill the new one
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(InstanceData) * (size_t)m_capacity, nullptr, GL_DYNAMIC_DRAW);
+		if (m_count > 0) {
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(InstanceData) * (size_t)m_count, instances);
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	void InstanceBuffer::upload(const std::vector<InstanceData>& instances)
+	{
+		upload(instances.data(), (int)instances.size());
+	}
+
+	void InstanceBuffer::bind(int binding) const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_buffer.get());
+	}
+}
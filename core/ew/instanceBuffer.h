@@ -0,0 +1,37 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "glResource.h"
+
+namespace ew {
+	/// <summary>
+	/// One instance as instanced shaders see it, matching this std430 block:
+	/// struct InstanceData { mat4 model; vec4 color; };
+	/// layout(std430, binding = 0) readonly buffer Instances { InstanceData _Instances[]; };
+	/// </summary>
+	struct InstanceData {
+		glm::mat4 model = glm::mat4(1.0f);
+		glm::vec4 color = glm::vec4(1.0f);
+	};
+
+	/// <summary>
+	/// Per-instance data in a shader storage buffer, indexed with gl_InstanceID by Mesh::drawInstanced and Model::drawInstanced.
+	/// </summary>
+	class InstanceBuffer {
+	public:
+		InstanceBuffer() {};
+		/// <summary>
+		/// Replaces the contents. Storage grows geometrically and is orphaned on every upload,
+		/// so rewriting it each frame doesn't wait on draws that still read the old data.
+		/// </summary>
+		void upload(const InstanceData* instances, int count);
+		void upload(const std::vector<InstanceData>& instances);
+		void bind(int binding = 0)const;
+		inline int getCount()const { return m_count; }
+		inline int getCapacity()const { return m_capacity; }
+	private:
+		Buffer m_buffer;
+		int m_count = 0;
+		int m_capacity = 0;
+	};
+}
@@ -0,0 +1,269 @@
+#include "jobs.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace ew {
+	namespace jobs {
+		static thread_local int t_workerIndex = -1;
+
+		class Scheduler {
+		public:
+			void start(int numWorkers)
+			{
+				std::lock_guard<std::mutex> lock(m_startMutex);
+				if (m_started.load(std::memory_order_acquire)) {
+					return;
+				}
+				if (numWorkers <= 0) {
+					numWorkers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+				}
+				m_stopping = false;
+				m_queues.clear();
+				//One deque per worker, the last one is shared by every thread that isn't a worker
+				for (int i = 0; i <= numWorkers; i++) {
+					m_queues.emplace_back(new Queue());
+				}
+				for (int i = 0; i < numWorkers; i++) {
+					m_workers.emplace_back(&Scheduler::work, this, i);
+				}
+				m_started.store(true, std::memory_order_release);
+			}
+
+			void stop()
+			{
+				std::lock_guard<std::mutex> lock(m_startMutex);
+				if (!m_started.load(std::memory_order_acquire)) {
+					return;
+				}
+				{
+					std::lock_guard<std::mutex> sleepLock(m_sleepMutex);
+					m_stopping = true;
+				}
+				m_wake.notify_all();
+				for (std::thread& worker : m_workers) {
+					worker.join();
+				}
+				m_workers.clear();
+				m_started.store(false, std::memory_order_release);
+			}
+
+			inline int getNumThreads()
+			{
+				ensureStarted();
+				return (int)m_workers.size() + 1;
+			}
+
+			void add(Job job, Counter* counter)
+			{
+				if (counter) {
+					counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+				}
+				push(std::move(job), counter);
+			}
+
+			void addAfter(Counter& dependency, Job job, Counter* counter)
+			{
+				if (counter) {
+					counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+				}
+				{
+					//finish() takes the same lock, so the dependency can't reach zero between the check and the push_back
+					std::lock_guard<std::mutex> lock(dependency.m_mutex);
+					if (dependency.m_pending.load(std::memory_order_acquire) > 0) {
+						dependency.m_continuations.push_back({ std::move(job), counter });
+						return;
+					}
+				}
+				push(std::move(job), counter);
+			}
+
+			bool runOne()
+			{
+				if (!m_started.load(std::memory_order_acquire)) {
+					return false;
+				}
+				Item item;
+				if (!find(t_workerIndex, item)) {
+					return false;
+				}
+				item.job();
+				if (item.counter) {
+					finish(*item.counter);
+				}
+				return true;
+			}
+
+			void wait(Counter& counter)
+			{
+				while (!counter.isDone()) {
+					if (!runOne()) {
+						std::this_thread::yield();
+					}
+				}
+				//The job that reached zero may still hold the mutex, it has to let go before the counter can be destroyed
+				std::lock_guard<std::mutex> lock(counter.m_mutex);
+			}
+
+		private:
+			struct Item {
+				Job job;
+				Counter* counter = nullptr;
+			};
+			struct Queue {
+				std::mutex mutex;
+				std::deque<Item> items;
+			};
+
+			inline void ensureStarted()
+			{
+				if (!m_started.load(std::memory_order_acquire)) {
+					start(0);
+				}
+			}
+
+			void push(Job job, Counter* counter)
+			{
+				ensureStarted();
+				Queue& queue = *m_queues[t_workerIndex >= 0 ? t_workerIndex : m_queues.size() - 1];
+				{
+					std::lock_guard<std::mutex> lock(queue.mutex);
+					queue.items.push_back({ std::move(job), counter });
+				}
+				m_queued.fetch_add(1);
+				//Sleepers check m_queued after counting themselves, so the lock can be skipped while nobody sleeps
+				if (m_sleeping.load() > 0) {
+					std::lock_guard<std::mutex> lock(m_sleepMutex);
+					m_wake.notify_one();
+				}
+			}
+
+			//Own deque newest first, then the shared queue and the other workers' deques oldest first
+			bool find(int workerIndex, Item& item)
+			{
+				if (m_queued.load() <= 0) {
+					return false;
+				}
+				if (workerIndex >= 0 && pop(*m_queues[workerIndex], item, true)) {
+					return true;
+				}
+				int numQueues = (int)m_queues.size();
+				for (int i = 1; i <= numQueues; i++) {
+					int index = (workerIndex + i + numQueues) % numQueues;
+					if (index != workerIndex && pop(*m_queues[index], item, false)) {
+						return true;
+					}
+				}
+				return false;
+			}
+
+			bool pop(Queue& queue, Item& item, bool newest)
+			{
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if (queue.items.empty()) {
+					return false;
+				}
+				if (newest) {
+					item = std::move(queue.items.back());
+					queue.items.pop_back();
+				}
+				else {
+					item = std::move(queue.items.front());
+					queue.items.pop_front();
+				}
+				m_queued.fetch_sub(1);
+				return true;
+			}
+
+			//Counts a job as done, and queues whatever was waiting on the counter once it reaches zero
+			void finish(Counter& counter)
+			{
+				std::vector<Counter::Continuation> continuations;
+				{
+					std::lock_guard<std::mutex> lock(counter.m_mutex);
+					if (counter.m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+						continuations.swap(counter.m_continuations);
+					}
+				}
+				for (Counter::Continuation& continuation : continuations) {
+					push(std::move(continuation.job), continuation.counter);
+				}
+			}
+
+			void work(int index)
+			{
+				t_workerIndex = index;
+				while (true) {
+					if (runOne()) {
+						continue;
+					}
+					std::unique_lock<std::mutex> lock(m_sleepMutex);
+					//Queued jobs still run before stopping, someone may be waiting on them
+					if (m_stopping && m_queued.load() <= 0) {
+						return;
+					}
+					m_sleeping.fetch_add(1);
+					m_wake.wait(lock, [this]() { return m_stopping || m_queued.load() > 0; });
+					m_sleeping.fetch_sub(1);
+				}
+			}
+
+			std::vector<std::unique_ptr<Queue>> m_queues;
+			std::vector<std::thread> m_workers;
+			std::atomic<int> m_queued{ 0 };
+			std::atomic<int> m_sleeping{ 0 };
+			std::atomic<bool> m_started{ false };
+			std::mutex m_startMutex;
+			std::mutex m_sleepMutex;
+			std::condition_variable m_wake;
+			bool m_stopping = false;
+		};
+
+		//Never destroyed, so jobs queued from other globals' destructors still have somewhere to run
+		static Scheduler& getScheduler() {
+			static Scheduler* scheduler = new Scheduler();
+			return *scheduler;
+		}
+
+		void init(int numWorkers)
+		{
+			getScheduler().start(numWorkers);
+		}
+
+		void shutdown()
+		{
+			getScheduler().stop();
+		}
+
+		int getNumThreads()
+		{
+			return getScheduler().getNumThreads();
+		}
+
+		int getWorkerIndex()
+		{
+			return t_workerIndex;
+		}
+
+		void run(Job job, Counter* counter)
+		{
+			getScheduler().add(std::move(job), counter);
+		}
+
+		void runAfter(Counter& dependency, Job job, Counter* counter)
+		{
+			getScheduler().addAfter(dependency, std::move(job), counter);
+		}
+
+		void wait(Counter& counter)
+		{
+			getScheduler().wait(counter);
+		}
+
+		bool runPendingJob()
+		{
+			return getScheduler().runOne();
+		}
+	}
+}
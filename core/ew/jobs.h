@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace ew {
+	namespace jobs {
+		using Job = std::function<void()>;
+
+		/// <summary>
+		/// Counts unfinished jobs. run() adds one and each job takes its one away when it returns.
+		/// Jobs queued with runAfter() start once the counter they depend on reaches zero.
+		/// Destroy it only after wait() returned, a finishing job may still be touching it before that.
+		/// </summary>
+		class Counter {
+		public:
+			Counter() {};
+			Counter(const Counter&) = delete;
+			Counter& operator=(const Counter&) = delete;
+			inline bool isDone()const { return m_pending.load(std::memory_order_acquire) == 0; }
+		private:
+			friend class Scheduler;
+			struct Continuation {
+				Job job;
+				Counter* counter;
+			};
+			std::atomic<int> m_pending{ 0 };
+			std::mutex m_mutex;
+			std::vector<Continuation> m_continuations;
+		};
+
+		/// <summary>
+		/// Starts the worker threads, one less than the hardware has since the calling thread helps in wait().
+		/// Called by the first job if nobody did, so it only needs calling to pick the number of workers.
+		/// </summary>
+		void init(int numWorkers = 0);
+		//Finishes every queued job and joins the workers. Queuing another job starts them again
+		void shutdown();
+		//Workers plus the thread that waits
+		int getNumThreads();
+		//Index of the worker thread this is called from, -1 on any other thread
+		int getWorkerIndex();
+
+		/// <summary>
+		/// Queues a job. From a worker it goes on that worker's own deque, which it runs newest first while
+		/// idle workers steal the oldest. From any other thread it goes on a shared queue.
+		/// </summary>
+		void run(Job job, Counter* counter = nullptr);
+		/// <summary>
+		/// Queues job once dependency reaches zero, right away if it already has. counter counts it from now on.
+		/// </summary>
+		void runAfter(Counter& dependency, Job job, Counter* counter = nullptr);
+		/// <summary>
+		/// Runs queued jobs until counter reaches zero, so a waiting thread is never idle while there is work.
+		/// These can be anyone's jobs, not only the ones counter counts.
+		/// </summary>
+		void wait(Counter& counter);
+		//Runs one queued job if there is one
+		bool runPendingJob();
+
+		/// <summary>
+		/// Splits [begin, end) into a few ranges per thread and calls func(rangeBegin, rangeEnd) for each as a job,
+		/// the calling thread taking the first range. Ranges are at least grainSize long, so small loops
+		/// stay on the calling thread. Returns once every range is done, and can be nested inside jobs.
+		/// </summary>
+		template<typename Func>
+		void parallelFor(int begin, int end, Func&& func, int grainSize = 1) {
+			int count = end - begin;
+			if (count <= 0) {
+				return;
+			}
+			//More ranges than threads so stealing can even out uneven ranges
+			int numRanges = std::min(getNumThreads() * 4, std::max(1, count / std::max(grainSize, 1)));
+			if (numRanges == 1) {
+				func(begin, end);
+				return;
+			}
+
+			auto rangeStart = [=](int range) { return begin + (int)((long long)count * range / numRanges); };
+			Counter counter;
+			for (int range = numRanges - 1; range > 0; range--) {
+				int rangeBegin = rangeStart(range);
+				int rangeEnd = rangeStart(range + 1);
+				run([&func, rangeBegin, rangeEnd]() { func(rangeBegin, rangeEnd); }, &counter);
+			}
+			func(begin, rangeStart(1));
+			wait(counter);
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace ew {
+	/// <summary>
+	/// Read-only memory mapping of a whole file. Pages are only read from disk when touched.
+	/// </summary>
+	class MappedFile {
+	public:
+		MappedFile() {};
+		MappedFile(const char* filePath);
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		bool open(const char* filePath);
+		void close();
+		inline bool isOpen()const { return m_data != nullptr; }
+		inline const unsigned char* data()const { return m_data; }
+		inline size_t size()const { return m_size; }
+	private:
+		const unsigned char* m_data = nullptr;
+		size_t m_size = 0;
+		void* m_mapping = nullptr; //Platform handle kept alive while mapped
+	};
+
+	/// <summary>
+	/// 64-bit FNV-1a hash, chain calls by passing the previous result as the seed
+	/// </summary>
+	inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = seed;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	/// <summary>
+	/// Hashes a file's contents through a mapping. Returns false if the file can't be opened.
+	/// </summary>
+	bool hashFile(const char* filePath, uint64_t& hash, uint64_t& size);
+}
@@ -6,69 +6,436 @@
 */
 
 #include "mesh.h"
+#include "geometryPool.h"
+#include "glState.h"
 #include "external/glad.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
 
 namespace ew {
-	Mesh::Mesh(const MeshData& meshData)
+	//Byte offsets of each attribute inside one vertex
+	struct VertexLayout {
+		int positionSize;
+		int normalOffset;
+		int uvOffset;
+		int tangentOffset;
+		int stride;
+	};
+
+	static VertexLayout getVertexLayout(const VertexFormat& format) {
+		VertexLayout layout;
+		//Quantized positions are padded to 4 shorts to keep every attribute 4 byte aligned
+		layout.positionSize = format.quantizedPositions ? 4 * sizeof(uint16_t) : sizeof(glm::vec3);
+		int normalSize = format.packedNormals ? sizeof(uint32_t) : sizeof(glm::vec3);
+		int uvSize = format.halfUVs ? sizeof(uint32_t) : sizeof(glm::vec2);
+		int tangentSize = format.packedNormals ? sizeof(uint32_t) : sizeof(glm::vec4);
+		layout.normalOffset = layout.positionSize;
+		layout.uvOffset = layout.normalOffset + normalSize;
+		layout.tangentOffset = layout.uvOffset + uvSize;
+		layout.stride = layout.tangentOffset + tangentSize;
+		return layout;
+	}
+
+	int VertexFormat::getStride() const
 	{
-		load(meshData);
+		return getVertexLayout(*this).stride;
 	}
-	void Mesh::load(const MeshData& meshData)
+
+	int VertexFormat::getPositionSize() const
 	{
-		if (!m_initialized) {
-			glGenVertexArrays(1, &m_vao);
-			glBindVertexArray(m_vao);
+		return getVertexLayout(*this).positionSize;
+	}
+
+	//Signed normalized 10:10:10:2, x in the lowest bits to match GL_INT_2_10_10_10_REV
+	static uint32_t packSnorm1010102(const glm::vec3& v, float w) {
+		auto quantize = [](float f, int bits) {
+			int maxValue = (1 << (bits - 1)) - 1;
+			int q = (int)std::round(std::min(std::max(f, -1.0f), 1.0f) * maxValue);
+			return (uint32_t)q & ((1u << bits) - 1);
+		};
+		return quantize(v.x, 10) | (quantize(v.y, 10) << 10) | (quantize(v.z, 10) << 20) | (quantize(w, 2) << 30);
+	}
+
+	//Positions are quantized inside a cube rather than the exact bounds, the uniform scale keeps normals
+	//correct when the decode is folded into _Model
+	glm::mat4 computePositionDecode(const Vertex* vertices, size_t numVertices) {
+		if (numVertices == 0) {
+			return glm::mat4(1.0f);
+		}
+		glm::vec3 minPos = vertices[0].pos;
+		glm::vec3 maxPos = minPos;
+		for (size_t i = 0; i < numVertices; i++) {
+			minPos = glm::min(minPos, vertices[i].pos);
+			maxPos = glm::max(maxPos, vertices[i].pos);
+		}
+		glm::vec3 size = maxPos - minPos;
+		float extent = std::max(std::max(size.x, size.y), size.z);
+		if (extent <= 0.0f) {
+			extent = 1.0f;
+		}
+		glm::mat4 decode = glm::mat4(extent);
+		decode[3] = glm::vec4(minPos, 1.0f);
+		return decode;
+	}
+
+	static void quantizePosition(const glm::vec3& pos, const glm::mat4& decode, uint16_t* out) {
+		glm::vec3 unit = (pos - glm::vec3(decode[3])) / decode[0][0];
+		for (int i = 0; i < 3; i++) {
+			out[i] = (uint16_t)std::round(std::min(std::max(unit[i], 0.0f), 1.0f) * 65535.0f);
+		}
+		out[3] = 0;
+	}
+
+	void packVertices(const Vertex* vertices, size_t numVertices, const VertexFormat& format, const glm::mat4& decode, std::vector<unsigned char>& out) {
+		VertexLayout layout = getVertexLayout(format);
+		out.resize(numVertices * layout.stride);
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			const Vertex& v = vertices[i];
+			unsigned char* dst = out.data() + i * layout.stride;
+			if (format.quantizedPositions) {
+				quantizePosition(v.pos, decode, (uint16_t*)dst);
+			}
+			else {
+				std::memcpy(dst, &v.pos, sizeof(glm::vec3));
+			}
+			if (format.packedNormals) {
+				uint32_t normal = packSnorm1010102(v.normal, 0.0f);
+				uint32_t tangent = packSnorm1010102(glm::vec3(v.tangent), v.tangent.w);
+				std::memcpy(dst + layout.normalOffset, &normal, sizeof(uint32_t));
+				std::memcpy(dst + layout.tangentOffset, &tangent, sizeof(uint32_t));
+			}
+			else {
+				std::memcpy(dst + layout.normalOffset, &v.normal, sizeof(glm::vec3));
+				std::memcpy(dst + layout.tangentOffset, &v.tangent, sizeof(glm::vec4));
+			}
+			if (format.halfUVs) {
+				uint32_t uv = glm::packHalf2x16(v.uv);
+				std::memcpy(dst + layout.uvOffset, &uv, sizeof(uint32_t));
+			}
+			else {
+				std::memcpy(dst + layout.uvOffset, &v.uv, sizeof(glm::vec2));
+			}
+		}
+	}
+
+	void packPositions(const Vertex* vertices, size_t numVertices, const VertexFormat& format, const glm::mat4& decode, std::vector<unsigned char>& out) {
+		int positionSize = format.getPositionSize();
+		out.resize(numVertices * positionSize);
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			unsigned char* dst = out.data() + i * positionSize;
+			if (format.quantizedPositions) {
+				quantizePosition(vertices[i].pos, decode, (uint16_t*)dst);
+			}
+			else {
+				std::memcpy(dst, &vertices[i].pos, sizeof(glm::vec3));
+			}
+		}
+	}
+
+	void setPositionAttribute(const VertexFormat& format, int stride) {
+		if (format.quantizedPositions) {
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (const void*)0);
+		}
+		else {
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const void*)0);
+		}
+		glEnableVertexAttribArray(0);
+	}
+
+	void setVertexAttributes(const VertexFormat& format) {
+		VertexLayout layout = getVertexLayout(format);
+
+		//Position attribute
+		setPositionAttribute(format, layout.stride);
+
+		//Normal attribute
+		if (format.packedNormals) {
+			glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, layout.stride, (const void*)(size_t)layout.normalOffset);
+		}
+		else {
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, layout.stride, (const void*)(size_t)layout.normalOffset);
+		}
+		glEnableVertexAttribArray(1);
 
-			glGenBuffers(1, &m_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		//UV attribute
+		if (format.halfUVs) {
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, layout.stride, (const void*)(size_t)layout.uvOffset);
+		}
+		else {
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, layout.stride, (const void*)(size_t)layout.uvOffset);
+		}
+		glEnableVertexAttribArray(2);
 
-			glGenBuffers(1, &m_ebo);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-			//Position attribute
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
-			glEnableVertexAttribArray(0);
+		//Tangent attribute
+		if (format.packedNormals) {
+			glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, layout.stride, (const void*)(size_t)layout.tangentOffset);
+		}
+		else {
+			glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, layout.stride, (const void*)(size_t)layout.tangentOffset);
+		}
+		glEnableVertexAttribArray(3);
+	}
 
-			//Normal attribute
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
-			glEnableVertexAttribArray(1);
+	Mesh::Mesh(const MeshData& meshData, bool positionStream, VertexFormat format)
+	{
+		load(meshData, positionStream, format);
+	}
+	Mesh::Mesh(const MeshData& meshData, GeometryPool& pool)
+	{
+		load(meshData, pool);
+	}
+	Mesh::~Mesh()
+	{
+		releasePoolRange();
+	}
+	Mesh::Mesh(Mesh&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+	Mesh& Mesh::operator=(Mesh&& other) noexcept
+	{
+		if (this == &other) {
+			return *this;
+		}
+		releasePoolRange();
+		m_vao = std::move(other.m_vao);
+		m_vbo = std::move(other.m_vbo);
+		m_ebo = std::move(other.m_ebo);
+		m_depthVao = std::move(other.m_depthVao);
+		m_positionVbo = std::move(other.m_positionVbo);
+		m_numVertices = other.m_numVertices;
+		m_numIndices = other.m_numIndices;
+		m_shortIndices = other.m_shortIndices;
+		m_format = other.m_format;
+		m_positionDecode = other.m_positionDecode;
+		m_boundsMin = other.m_boundsMin;
+		m_boundsMax = other.m_boundsMax;
+		m_boundingSphere = other.m_boundingSphere;
+		m_pool = other.m_pool;
+		m_firstVertex = other.m_firstVertex;
+		m_firstIndex = other.m_firstIndex;
+		other.m_pool = nullptr;
+		other.m_numVertices = 0;
+		other.m_numIndices = 0;
+		return *this;
+	}
+	void Mesh::computeBounds(const Vertex* vertices, size_t numVertices)
+	{
+		m_boundsMin = glm::vec3(1.0f);
+		m_boundsMax = glm::vec3(-1.0f);
+		m_boundingSphere = glm::vec4(0.0f);
+		if (numVertices == 0) {
+			return;
+		}
+		m_boundsMin = m_boundsMax = vertices[0].pos;
+		for (size_t i = 1; i < numVertices; i++) {
+			m_boundsMin = glm::min(m_boundsMin, vertices[i].pos);
+			m_boundsMax = glm::max(m_boundsMax, vertices[i].pos);
+		}
+		//Centered on the box, but only as large as the farthest vertex, which is tighter than the box's corners
+		glm::vec3 center = (m_boundsMin + m_boundsMax) * 0.5f;
+		float radius2 = 0.0f;
+		for (size_t i = 0; i < numVertices; i++) {
+			glm::vec3 d = vertices[i].pos - center;
+			radius2 = std::max(radius2, glm::dot(d, d));
+		}
+		m_boundingSphere = glm::vec4(center, std::sqrt(radius2));
+	}
+	void Mesh::releasePoolRange()
+	{
+		if (m_pool) {
+			m_pool->free(m_firstVertex, m_numVertices, m_firstIndex, m_numIndices);
+			m_pool = nullptr;
+		}
+		//Owned buffers start at 0, a stale pool offset would draw past them
+		m_firstVertex = 0;
+		m_firstIndex = 0;
+	}
+	void Mesh::load(const MeshData& meshData, bool positionStream, VertexFormat format)
+	{
+		load(meshData.vertices.data(), meshData.vertices.size(), meshData.indices.data(), meshData.indices.size(), positionStream, format);
+	}
+	void Mesh::load(const MeshData& meshData, GeometryPool& pool)
+	{
+		load(meshData.vertices.data(), meshData.vertices.size(), meshData.indices.data(), meshData.indices.size(), pool);
+	}
+	void Mesh::load(const Vertex* vertices, size_t numVertices, const unsigned int* indices, size_t numIndices, GeometryPool& pool)
+	{
+		releasePoolRange();
+		m_vao.reset();
+		m_vbo.reset();
+		m_ebo.reset();
+		m_depthVao.reset();
+		m_positionVbo.reset();
+		m_format = pool.getVertexFormat();
+		m_positionDecode = m_format.quantizedPositions ? computePositionDecode(vertices, numVertices) : glm::mat4(1.0f);
+		computeBounds(vertices, numVertices);
+		m_numVertices = 0;
+		m_numIndices = 0;
+		m_shortIndices = false;
+		if (!pool.allocate(vertices, numVertices, indices, numIndices, m_positionDecode, m_firstVertex, m_firstIndex)) {
+			return;
+		}
+		m_pool = &pool;
+		m_numVertices = numVertices;
+		m_numIndices = numIndices;
+	}
+	void Mesh::load(const Vertex* vertices, size_t numVertices, const unsigned int* indices, size_t numIndices, bool positionStream, VertexFormat format)
+	{
+		releasePoolRange();
+		if (!m_vao) {
+			m_vao = VertexArray::create();
+			m_vbo = Buffer::create();
+			m_ebo = Buffer::create();
+		}
+		m_format = format;
+		m_positionDecode = format.quantizedPositions ? computePositionDecode(vertices, numVertices) : glm::mat4(1.0f);
+		computeBounds(vertices, numVertices);
+		m_numVertices = numVertices;
+		m_numIndices = numIndices;
+		m_shortIndices = m_numVertices <= 65536;
 
-			//UV attribute
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
-			glEnableVertexAttribArray(2);
+		VertexLayout layout = getVertexLayout(format);
+		GLState::get().bindVertexArray(m_vao.get());
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo.get());
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo.get());
 
-			//Tangent attribute
-			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
-			glEnableVertexAttribArray(3);
+		setVertexAttributes(format);
 
-			m_initialized = true;
+		if (numVertices > 0) {
+			if (layout.stride == sizeof(Vertex)) {
+				//The full format is the Vertex struct itself
+				glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * numVertices, vertices, GL_STATIC_DRAW);
+			}
+			else {
+				std::vector<unsigned char> vertexData;
+				packVertices(vertices, numVertices, format, m_positionDecode, vertexData);
+				glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+			}
+		}
+		if (numIndices > 0) {
+			if (m_shortIndices) {
+				std::vector<uint16_t> shortIndices(indices, indices + numIndices);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * shortIndices.size(), shortIndices.data(), GL_STATIC_DRAW);
+			}
+			else {
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * numIndices, indices, GL_STATIC_DRAW);
+			}
 		}
 
-		glBindVertexArray(m_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+		GLState::get().bindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-		if (meshData.vertices.size() > 0) {
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), GL_STATIC_DRAW);
+		if (!positionStream) {
+			m_depthVao.reset();
+			m_positionVbo.reset();
+			return;
+		}
+		if (!m_depthVao) {
+			m_depthVao = VertexArray::create();
+			m_positionVbo = Buffer::create();
 		}
-		if (meshData.indices.size() > 0) {
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+		GLState::get().bindVertexArray(m_depthVao.get());
+		glBindBuffer(GL_ARRAY_BUFFER, m_positionVbo.get());
+
+		//Shares the index buffer with the full vertex array
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo.get());
+
+		//Position attribute, in the same encoding as the full vertices
+		setPositionAttribute(format, layout.positionSize);
+
+		if (numVertices > 0) {
+			std::vector<unsigned char> positions;
+			packPositions(vertices, numVertices, format, m_positionDecode, positions);
+			glBufferData(GL_ARRAY_BUFFER, positions.size(), positions.data(), GL_STATIC_DRAW);
 		}
-		m_numVertices = meshData.vertices.size();
-		m_numIndices = meshData.indices.size();
 
-		glBindVertexArray(0);
+		GLState::get().bindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 	void Mesh::draw(ew::DrawMode drawMode) const
 	{
-		glBindVertexArray(m_vao);
+		GLState::get().bindVertexArray(getVertexArray());
 		if (drawMode == DrawMode::TRIANGLES) {
-			glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL);
+			drawBound();
 		}
 		else {
-			glDrawArrays(GL_POINTS, 0, m_numVertices);
+			glDrawArrays(GL_POINTS, m_firstVertex, m_numVertices);
 		}
 		
 	}
-}
\ No newline at end of file
+	void Mesh::drawDepth() const
+	{
+		//Without a position stream this is the full vertex array
+		GLState::get().bindVertexArray(getVertexArray(true));
+		drawBound();
+	}
+	void Mesh::drawBound() const
+	{
+		if (m_pool) {
+			glDrawElementsBaseVertex(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, (const void*)(m_firstIndex * sizeof(unsigned int)), m_firstVertex);
+			return;
+		}
+		glDrawElements(GL_TRIANGLES, m_numIndices, m_shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, NULL);
+	}
+	unsigned int Mesh::getVertexArray(bool depthOnly) const
+	{
+		if (m_pool) {
+			return m_pool->getVertexArray(depthOnly);
+		}
+		return depthOnly && m_depthVao ? m_depthVao.get() : m_vao.get();
+	}
+	void Mesh::drawRanges(const int* counts, const unsigned int* firstIndices, int numRanges, bool depthOnly) const
+	{
+		if (numRanges <= 0) {
+			return;
+		}
+		size_t indexSize = m_shortIndices ? sizeof(uint16_t) : sizeof(unsigned int);
+		m_rangeOffsets.resize(numRanges);
+		for (int i = 0; i < numRanges; i++)
+		{
+			m_rangeOffsets[i] = (const void*)((m_firstIndex + firstIndices[i]) * indexSize);
+		}
+		if (m_pool) {
+			m_rangeBaseVertices.assign(numRanges, (int)m_firstVertex);
+			m_pool->bind(depthOnly && m_pool->hasPositionStream());
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_INT, m_rangeOffsets.data(), numRanges, m_rangeBaseVertices.data());
+			return;
+		}
+		GLState::get().bindVertexArray(depthOnly && m_depthVao ? m_depthVao.get() : m_vao.get());
+		glMultiDrawElements(GL_TRIANGLES, counts, m_shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, m_rangeOffsets.data(), numRanges);
+	}
+	void Mesh::drawInstanced(int instanceCount, bool depthOnly) const
+	{
+		if (instanceCount <= 0) {
+			return;
+		}
+		if (m_pool) {
+			m_pool->bind(depthOnly && m_pool->hasPositionStream());
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, (const void*)(m_firstIndex * sizeof(unsigned int)), instanceCount, m_firstVertex);
+			return;
+		}
+		GLState::get().bindVertexArray(depthOnly && m_depthVao ? m_depthVao.get() : m_vao.get());
+		glDrawElementsInstanced(GL_TRIANGLES, m_numIndices, m_shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, NULL, instanceCount);
+	}
+	size_t Mesh::getBufferBytes() const
+	{
+		size_t bytes = (size_t)m_numVertices * m_format.getStride();
+		bytes += (size_t)m_numIndices * (m_shortIndices ? sizeof(uint16_t) : sizeof(unsigned int));
+		if (hasPositionStream()) {
+			bytes += (size_t)m_numVertices * m_format.getPositionSize();
+		}
+		return bytes;
+	}
+	bool Mesh::hasPositionStream() const
+	{
+		return m_pool ? m_pool->hasPositionStream() : (bool)m_depthVao;
+	}
+}
@@ -5,13 +5,15 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <vector>
+#include "glResource.h"
 
 namespace ew {
 	struct Vertex {
 		glm::vec3 pos;
 		glm::vec3 normal;
 		glm::vec2 uv;
-		glm::vec3 tangent;
+		//w is the bitangent sign, bitangent = cross(normal, tangent.xyz) * tangent.w
+		glm::vec4 tangent;
 	};
 
 	struct MeshData {
@@ -19,6 +21,40 @@ namespace ew {
 		std::vector<unsigned int> indices;
 	};
 
+	/// <summary>
+	/// How each Vertex attribute is stored on the GPU. Shaders read the same vec3/vec2 attributes in every format,
+	/// the packed ones are normalized integers or halves that the vertex fetch expands.
+	/// </summary>
+	struct VertexFormat {
+		//16-bit unorm inside the mesh bounds, the shader needs Mesh::getPositionDecode() folded into _Model
+		bool quantizedPositions = false;
+		//Normal and tangent as 10:10:10:2 snorm, 4 bytes each. The tangent sign goes in the 2 bit w.
+		bool packedNormals = true;
+		//Half float UVs
+		bool halfUVs = true;
+
+		//Plain floats, the same 48 byte layout as Vertex
+		static VertexFormat full() { return { false, false, false }; }
+		//Everything packed, 20 bytes
+		static VertexFormat compact() { return { true, true, true }; }
+		int getStride()const;
+		//Bytes per vertex in a position-only stream
+		int getPositionSize()const;
+	};
+
+	//Vertex encoding shared by Mesh and GeometryPool
+	/// <summary>
+	/// Smallest cube around the positions as a scale and offset, what quantized positions are stored relative to.
+	/// </summary>
+	glm::mat4 computePositionDecode(const Vertex* vertices, size_t numVertices);
+	void packVertices(const Vertex* vertices, size_t numVertices, const VertexFormat& format, const glm::mat4& positionDecode, std::vector<unsigned char>& out);
+	void packPositions(const Vertex* vertices, size_t numVertices, const VertexFormat& format, const glm::mat4& positionDecode, std::vector<unsigned char>& out);
+	//Points attributes 0-3 (or only 0) of the bound vertex array at the bound array buffer
+	void setVertexAttributes(const VertexFormat& format);
+	void setPositionAttribute(const VertexFormat& format, int stride);
+
+	class GeometryPool;
+
 	enum class DrawMode {
 		TRIANGLES = 0,
 		POINTS = 1
@@ -27,17 +63,91 @@ namespace ew {
 	class Mesh {
 	public:
 		Mesh() {};
-		Mesh(const MeshData& meshData);
-		void load(const MeshData& meshData);
+		Mesh(const MeshData& meshData, bool positionStream = false, VertexFormat format = VertexFormat());
+		Mesh(const MeshData& meshData, GeometryPool& pool);
+		~Mesh();
+		Mesh(const Mesh&) = delete;
+		Mesh& operator=(const Mesh&) = delete;
+		Mesh(Mesh&& other) noexcept;
+		Mesh& operator=(Mesh&& other) noexcept;
+		/// <summary>
+		/// Uploads the mesh in the given format. With positionStream, positions are also copied into a tightly packed
+		/// buffer with its own vertex array, so depth-only passes fetch 12 bytes per vertex (8 if quantized) instead of a whole vertex.
+		/// Indices are stored as 16-bit whenever every vertex can be addressed with them.
+		/// </summary>
+		void load(const MeshData& meshData, bool positionStream = false, VertexFormat format = VertexFormat());
+		//Same as above from raw arrays, e.g. straight out of a memory mapped cache
+		void load(const Vertex* vertices, size_t numVertices, const unsigned int* indices, size_t numIndices,
+			bool positionStream = false, VertexFormat format = VertexFormat());
+		/// <summary>
+		/// Suballocates the mesh from a shared pool in the pool's format instead of owning buffers. Draws only bind
+		/// the pool's vertex array and offset into it with a base vertex. The pool must outlive the mesh.
+		/// </summary>
+		void load(const MeshData& meshData, GeometryPool& pool);
+		void load(const Vertex* vertices, size_t numVertices, const unsigned int* indices, size_t numIndices, GeometryPool& pool);
 		void draw(DrawMode drawMode = DrawMode::TRIANGLES)const;
+		/// <summary>
+		/// Draws triangles with only position at location 0. Falls back to draw() without a position stream.
+		/// </summary>
+		void drawDepth()const;
+		/// <summary>
+		/// Draws several runs of triangles from the index buffer with one call, e.g. the meshlets that survived culling.
+		/// </summary>
+		void drawRanges(const int* counts, const unsigned int* firstIndices, int numRanges, bool depthOnly = false)const;
+		/// <summary>
+		/// Draws instanceCount copies in one call. The shader tells them apart with gl_InstanceID, e.g. to index an InstanceBuffer.
+		/// </summary>
+		void drawInstanced(int instanceCount, bool depthOnly = false)const;
+		/// <summary>
+		/// Draws the triangles without binding anything, getVertexArray() (or getVertexArray(true) for depth) must already be bound.
+		/// For callers that track bindings themselves, like DrawList.
+		/// </summary>
+		void drawBound()const;
+		//The vertex array draw() binds, or drawDepth() with depthOnly
+		unsigned int getVertexArray(bool depthOnly = false)const;
 		inline int getNumVertices()const { return m_numVertices; }
 		inline int getNumIndices()const { return m_numIndices; }
+		bool hasPositionStream()const;
+		inline bool isPooled()const { return m_pool != nullptr; }
+		//Where the mesh lives in its pool, for building indirect draws
+		inline GeometryPool* getPool()const { return m_pool; }
+		inline unsigned int getFirstVertex()const { return m_firstVertex; }
+		inline unsigned int getFirstIndex()const { return m_firstIndex; }
+		inline const VertexFormat& getVertexFormat()const { return m_format; }
+		/// <summary>
+		/// Maps quantized positions back to model space, identity unless the format quantizes them. Multiply it into _Model.
+		/// </summary>
+		inline const glm::mat4& getPositionDecode()const { return m_positionDecode; }
+		inline bool hasShortIndices()const { return m_shortIndices; }
+		size_t getBufferBytes()const;
+		//Model space bounds of the vertices, min is greater than max for an empty mesh
+		inline const glm::vec3& getBoundsMin()const { return m_boundsMin; }
+		inline const glm::vec3& getBoundsMax()const { return m_boundsMax; }
+		//Model space sphere around the vertices, xyz center and w radius
+		inline const glm::vec4& getBoundingSphere()const { return m_boundingSphere; }
 	private:
-		bool m_initialized = false;
-		unsigned int m_vao = 0;
-		unsigned int m_vbo = 0;
-		unsigned int m_ebo = 0;
+		void releasePoolRange();
+		void computeBounds(const Vertex* vertices, size_t numVertices);
+
+		VertexArray m_vao;
+		Buffer m_vbo;
+		Buffer m_ebo;
+		VertexArray m_depthVao;
+		Buffer m_positionVbo;
 		unsigned int m_numVertices = 0;
 		unsigned int m_numIndices = 0;
+		bool m_shortIndices = false;
+		VertexFormat m_format;
+		glm::mat4 m_positionDecode = glm::mat4(1.0f);
+		glm::vec3 m_boundsMin = glm::vec3(1.0f);
+		glm::vec3 m_boundsMax = glm::vec3(-1.0f);
+		glm::vec4 m_boundingSphere = glm::vec4(0.0f);
+		//Range inside m_pool when pooled, the owned handles above are empty then
+		GeometryPool* m_pool = nullptr;
+		unsigned int m_firstVertex = 0;
+		unsigned int m_firstIndex = 0;
+		//Byte offsets (and base vertices when pooled) for drawRanges, kept to avoid allocating every frame
+		mutable std::vector<const void*> m_rangeOffsets;
+		mutable std::vector<int> m_rangeBaseVertices;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "meshCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace ew {
+	static const uint32_t MESH_CACHE_MAGIC = 0x534D5745; // "EWMS"
+	static const uint32_t MESH_CACHE_VERSION = 3;
+
+	//Vertices and meshlets are stored as their in-memory structs
+	static_assert(sizeof(Vertex) == 48, "Bump MESH_CACHE_VERSION when Vertex changes");
+	static_assert(sizeof(Meshlet) == 40, "Bump MESH_CACHE_VERSION when Meshlet changes");
+	static_assert(std::is_trivially_copyable<Meshlet>::value, "Meshlets are mapped directly");
+
+	struct MeshCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t numSubmeshes;
+		uint32_t padding;
+		uint64_t numVertices;
+		uint64_t numIndices;
+		uint64_t numMeshlets;
+		uint64_t sourceSize;
+		uint64_t sourceHash;        // FNV-1a of the source model file
+		uint64_t submeshesOffset;
+		uint64_t verticesOffset;
+		uint64_t indicesOffset;
+		uint64_t meshletsOffset;
+		uint64_t fileSize;
+		uint64_t headerHash;        // FNV-1a of this header with this field zeroed
+	};
+
+	static uint64_t alignOffset(uint64_t offset) {
+		return (offset + 15) & ~uint64_t(15);
+	}
+
+	static uint64_t hashHeader(MeshCacheHeader header) {
+		header.headerHash = 0;
+		return hashBytes(&header, sizeof(header));
+	}
+
+	std::string getMeshCachePath(const char* sourcePath) {
+		return std::string(sourcePath) + ".ewmesh";
+	}
+
+	bool MeshCache::write(const char* sourcePath, const std::vector<MeshData>& meshes, const std::vector<std::vector<Meshlet>>& meshlets)
+	{
+		uint64_t sourceHash, sourceSize;
+		if (meshes.size() != meshlets.size() || !hashFile(sourcePath, sourceHash, sourceSize)) {
+			return false;
+		}
+
+		std::vector<MeshCacheSubmesh> submeshes(meshes.size());
+		uint64_t numVertices = 0, numIndices = 0, numMeshlets = 0;
+		for (size_t i = 0; i < meshes.size(); i++) {
+			MeshCacheSubmesh& submesh = submeshes[i];
+			submesh.firstVertex = (uint32_t)numVertices;
+			submesh.numVertices = (uint32_t)meshes[i].vertices.size();
+			submesh.firstIndex = (uint32_t)numIndices;
+			submesh.numIndices = (uint32_t)meshes[i].indices.size();
+			submesh.firstMeshlet = (uint32_t)numMeshlets;
+			submesh.numMeshlets = (uint32_t)meshlets[i].size();
+			glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+			if (!meshes[i].vertices.empty()) {
+				boundsMin = boundsMax = meshes[i].vertices[0].pos;
+				for (const Vertex& v : meshes[i].vertices) {
+					boundsMin = glm::min(boundsMin, v.pos);
+					boundsMax = glm::max(boundsMax, v.pos);
+				}
+			}
+			for (int axis = 0; axis < 3; axis++) {
+				submesh.boundsMin[axis] = boundsMin[axis];
+				submesh.boundsMax[axis] = boundsMax[axis];
+			}
+			numVertices += submesh.numVertices;
+			numIndices += submesh.numIndices;
+			numMeshlets += submesh.numMeshlets;
+		}
+
+		MeshCacheHeader header = {};
+		header.magic = MESH_CACHE_MAGIC;
+		header.version = MESH_CACHE_VERSION;
+		header.numSubmeshes = (uint32_t)meshes.size();
+		header.numVertices = numVertices;
+		header.numIndices = numIndices;
+		header.numMeshlets = numMeshlets;
+		header.sourceSize = sourceSize;
+		header.sourceHash = sourceHash;
+		header.submeshesOffset = alignOffset(sizeof(MeshCacheHeader));
+		header.verticesOffset = alignOffset(header.submeshesOffset + submeshes.size() * sizeof(MeshCacheSubmesh));
+		header.indicesOffset = alignOffset(header.verticesOffset + numVertices * sizeof(Vertex));
+		header.meshletsOffset = alignOffset(header.indicesOffset + numIndices * sizeof(unsigned int));
+		header.fileSize = header.meshletsOffset + numMeshlets * sizeof(Meshlet);
+		header.headerHash = hashHeader(header);
+
+		std::string cachePath = getMeshCachePath(sourcePath);
+		std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			printf("Failed to write mesh cache %s\n", cachePath.c_str());
+			return false;
+		}
+
+		const char padding[16] = {};
+		auto writeAt = [&](uint64_t offset, const void* data, size_t size) {
+			file.write(padding, (std::streamsize)(offset - (uint64_t)file.tellp()));
+			file.write(static_cast<const char*>(data), (std::streamsize)size);
+		};
+		writeAt(0, &header, sizeof(header));
+		writeAt(header.submeshesOffset, submeshes.data(), submeshes.size() * sizeof(MeshCacheSubmesh));
+		file.write(padding, (std::streamsize)(header.verticesOffset - (uint64_t)file.tellp()));
+		for (const MeshData& mesh : meshes) {
+			file.write(reinterpret_cast<const char*>(mesh.vertices.data()), (std::streamsize)(mesh.vertices.size() * sizeof(Vertex)));
+		}
+		file.write(padding, (std::streamsize)(header.indicesOffset - (uint64_t)file.tellp()));
+		for (const MeshData& mesh : meshes) {
+			file.write(reinterpret_cast<const char*>(mesh.indices.data()), (std::streamsize)(mesh.indices.size() * sizeof(unsigned int)));
+		}
+		file.write(padding, (std::streamsize)(header.meshletsOffset - (uint64_t)file.tellp()));
+		for (const std::vector<Meshlet>& list : meshlets) {
+			file.write(reinterpret_cast<const char*>(list.data()), (std::streamsize)(list.size() * sizeof(Meshlet)));
+		}
+
+		if (!file.good()) {
+			printf("Failed to write mesh cache %s\n", cachePath.c_str());
+			file.close();
+			std::remove(cachePath.c_str());
+			return false;
+		}
+		printf("Wrote mesh cache %s (%llu bytes)\n", cachePath.c_str(), (unsigned long long)header.fileSize);
+		return true;
+	}
+
+	bool MeshCache::open(const char* sourcePath)
+	{
+		close();
+
+		std::string cachePath = getMeshCachePath(sourcePath);
+		uint64_t sourceHash, sourceSize;
+		if (!hashFile(sourcePath, sourceHash, sourceSize) || !m_file.open(cachePath.c_str())) {
+			return false;
+		}
+
+		MeshCacheHeader header;
+		bool valid = m_file.size() >= sizeof(header);
+		if (valid) {
+			std::memcpy(&header, m_file.data(), sizeof(header));
+			valid = header.magic == MESH_CACHE_MAGIC
+				&& header.version == MESH_CACHE_VERSION
+				&& header.headerHash == hashHeader(header)
+				&& header.fileSize == m_file.size()
+				&& header.submeshesOffset % 16 == 0 && header.verticesOffset % 16 == 0
+				&& header.indicesOffset % 16 == 0 && header.meshletsOffset % 16 == 0
+				&& header.submeshesOffset + header.numSubmeshes * sizeof(MeshCacheSubmesh) <= header.verticesOffset
+				&& header.verticesOffset + header.numVertices * sizeof(Vertex) <= header.indicesOffset
+				&& header.indicesOffset + header.numIndices * sizeof(unsigned int) <= header.meshletsOffset
+				&& header.meshletsOffset + header.numMeshlets * sizeof(Meshlet) <= header.fileSize;
+		}
+		if (valid) {
+			//Every submesh must stay inside the shared arrays, and its indices inside its own vertices
+			const MeshCacheSubmesh* submeshes = reinterpret_cast<const MeshCacheSubmesh*>(m_file.data() + header.submeshesOffset);
+			const unsigned int* indices = reinterpret_cast<const unsigned int*>(m_file.data() + header.indicesOffset);
+			for (uint32_t i = 0; i < header.numSubmeshes && valid; i++) {
+				const MeshCacheSubmesh& submesh = submeshes[i];
+				valid = (uint64_t)submesh.firstVertex + submesh.numVertices <= header.numVertices
+					&& (uint64_t)submesh.firstIndex + submesh.numIndices <= header.numIndices
+					&& (uint64_t)submesh.firstMeshlet + submesh.numMeshlets <= header.numMeshlets;
+				for (uint32_t j = 0; j < submesh.numIndices && valid; j++) {
+					valid = indices[submesh.firstIndex + j] < submesh.numVertices;
+				}
+			}
+		}
+		if (!valid) {
+			printf("Mesh cache %s is corrupt or from another version\n", cachePath.c_str());
+			close();
+			return false;
+		}
+		if (header.sourceSize != sourceSize || header.sourceHash != sourceHash) {
+			printf("Mesh cache %s is stale\n", cachePath.c_str());
+			close();
+			return false;
+		}
+
+		m_numSubmeshes = header.numSubmeshes;
+		m_submeshes = reinterpret_cast<const MeshCacheSubmesh*>(m_file.data() + header.submeshesOffset);
+		m_vertices = reinterpret_cast<const Vertex*>(m_file.data() + header.verticesOffset);
+		m_indices = reinterpret_cast<const unsigned int*>(m_file.data() + header.indicesOffset);
+		m_meshlets = reinterpret_cast<const Meshlet*>(m_file.data() + header.meshletsOffset);
+		printf("Mapped mesh cache %s (%d submeshes)\n", cachePath.c_str(), m_numSubmeshes);
+		return true;
+	}
+
+	void MeshCache::close()
+	{
+		m_file.close();
+		m_numSubmeshes = 0;
+		m_submeshes = nullptr;
+		m_vertices = nullptr;
+		m_indices = nullptr;
+		m_meshlets = nullptr;
+	}
+}
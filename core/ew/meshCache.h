@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "mappedFile.h"
+#include "meshlet.h"
+
+namespace ew {
+	struct MeshCacheSubmesh {
+		uint32_t firstVertex;
+		uint32_t numVertices;
+		uint32_t firstIndex;
+		uint32_t numIndices;
+		uint32_t firstMeshlet;
+		uint32_t numMeshlets;
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	/// <summary>
+	/// Memory mapped .ewmesh file written next to a source model. Holds the optimized vertex and index buffers,
+	/// meshlets and a submesh table, so loading it is a page-in and a GPU upload instead of an import.
+	/// </summary>
+	class MeshCache {
+	public:
+		MeshCache() {};
+		/// <summary>
+		/// Maps the cache for a source model. Fails if it is missing, truncated, from another format version,
+		/// or if the source's size or checksum no longer match.
+		/// </summary>
+		bool open(const char* sourcePath);
+		void close();
+		/// <summary>
+		/// Writes the cache for a source model, overwriting any existing one. meshlets[i] belongs to meshes[i].
+		/// </summary>
+		static bool write(const char* sourcePath, const std::vector<MeshData>& meshes, const std::vector<std::vector<Meshlet>>& meshlets);
+
+		inline bool isOpen()const { return m_file.isOpen(); }
+		inline int getNumSubmeshes()const { return m_numSubmeshes; }
+		inline const MeshCacheSubmesh& getSubmesh(int index)const { return m_submeshes[index]; }
+		inline const Vertex* getVertices()const { return m_vertices; }
+		inline const unsigned int* getIndices()const { return m_indices; }
+		inline const Meshlet* getMeshlets()const { return m_meshlets; }
+	private:
+		MappedFile m_file;
+		int m_numSubmeshes = 0;
+		const MeshCacheSubmesh* m_submeshes = nullptr;
+		const Vertex* m_vertices = nullptr;
+		const unsigned int* m_indices = nullptr;
+		const Meshlet* m_meshlets = nullptr;
+	};
+
+	std::string getMeshCachePath(const char* sourcePath);
+}
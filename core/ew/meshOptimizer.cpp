@@ -0,0 +1,250 @@
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+
+namespace ew {
+	float getACMR(const std::vector<unsigned int>& indices, size_t numVertices, int cacheSize)
+	{
+		size_t numTriangles = indices.size() / 3;
+		if (numTriangles == 0) {
+			return 0.0f;
+		}
+		//A vertex is still cached if fewer than cacheSize misses happened since it was loaded
+		std::vector<unsigned int> cacheTime(numVertices, 0);
+		unsigned int time = cacheSize + 1;
+		size_t misses = 0;
+		for (unsigned int index : indices) {
+			if (time - cacheTime[index] > (unsigned int)cacheSize) {
+				cacheTime[index] = time++;
+				misses++;
+			}
+		}
+		return (float)misses / numTriangles;
+	}
+
+	float getACMR(const MeshData& meshData, int cacheSize)
+	{
+		return getACMR(meshData.indices, meshData.vertices.size(), cacheSize);
+	}
+
+	void optimizeVertexCache(std::vector<unsigned int>& indices, size_t numVertices, int cacheSize, std::vector<unsigned int>* clusterStarts)
+	{
+		if (clusterStarts) {
+			clusterStarts->clear();
+		}
+		size_t numTriangles = indices.size() / 3;
+		if (numTriangles == 0) {
+			return;
+		}
+
+		//Triangles around each vertex, and how many of them are still waiting to be emitted
+		std::vector<unsigned int> live(numVertices, 0);
+		for (unsigned int index : indices) {
+			live[index]++;
+		}
+		std::vector<unsigned int> offsets(numVertices + 1, 0);
+		for (size_t v = 0; v < numVertices; v++) {
+			offsets[v + 1] = offsets[v] + live[v];
+		}
+		std::vector<unsigned int> adjacency(indices.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++) {
+			adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+		}
+
+		std::vector<unsigned int> cacheTime(numVertices, 0);
+		std::vector<bool> emitted(numTriangles, false);
+		std::vector<unsigned int> deadEnds;
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> output;
+		output.reserve(indices.size());
+		unsigned int time = cacheSize + 1;
+		size_t cursor = 0;
+
+		//Fans around one vertex at a time, then moves to the neighbour that is most likely still cached
+		while (cursor < numVertices && live[cursor] == 0) {
+			cursor++;
+		}
+		long long fanning = cursor < numVertices ? (long long)cursor : -1;
+		if (clusterStarts && fanning >= 0) {
+			clusterStarts->push_back(0);
+		}
+		while (fanning >= 0) {
+			candidates.clear();
+			for (unsigned int k = offsets[fanning]; k < offsets[fanning + 1]; k++) {
+				unsigned int triangle = adjacency[k];
+				if (emitted[triangle]) {
+					continue;
+				}
+				for (int j = 0; j < 3; j++) {
+					unsigned int v = indices[triangle * 3 + j];
+					output.push_back(v);
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if (time - cacheTime[v] > (unsigned int)cacheSize) {
+						cacheTime[v] = time++;
+					}
+				}
+				emitted[triangle] = true;
+			}
+
+			//Prefer the oldest vertex that will stay in the cache while its remaining fan is emitted
+			long long next = -1;
+			int bestPriority = -1;
+			for (unsigned int v : candidates) {
+				if (live[v] == 0) {
+					continue;
+				}
+				int priority = 0;
+				if ((int)(time - cacheTime[v]) + 2 * (int)live[v] <= cacheSize) {
+					priority = (int)(time - cacheTime[v]);
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			//Dead end, back up through recently used vertices, then fall back to the next unfinished one in order
+			if (next < 0) {
+				while (!deadEnds.empty()) {
+					unsigned int v = deadEnds.back();
+					deadEnds.pop_back();
+					if (live[v] > 0) {
+						next = v;
+						break;
+					}
+				}
+				if (next < 0) {
+					while (cursor < numVertices && live[cursor] == 0) {
+						cursor++;
+					}
+					if (cursor < numVertices) {
+						next = (long long)cursor;
+					}
+				}
+				if (clusterStarts && next >= 0) {
+					clusterStarts->push_back((unsigned int)(output.size() / 3));
+				}
+			}
+			fanning = next;
+		}
+		indices.swap(output);
+	}
+
+	void optimizeVertexCache(MeshData& meshData, int cacheSize, std::vector<unsigned int>* clusterStarts)
+	{
+		optimizeVertexCache(meshData.indices, meshData.vertices.size(), cacheSize, clusterStarts);
+	}
+
+	void optimizeOverdraw(MeshData& meshData, const std::vector<unsigned int>& clusterStarts, int cacheSize, float threshold)
+	{
+		size_t numTriangles = meshData.indices.size() / 3;
+		if (clusterStarts.size() < 2 || numTriangles == 0) {
+			return;
+		}
+
+		//Area weighted centroid and normal of a run of triangles
+		auto accumulate = [&](size_t begin, size_t end, glm::vec3& centroid, glm::vec3& normal) {
+			centroid = glm::vec3(0.0f);
+			normal = glm::vec3(0.0f);
+			float area = 0.0f;
+			for (size_t t = begin; t < end; t++) {
+				const glm::vec3& a = meshData.vertices[meshData.indices[t * 3]].pos;
+				const glm::vec3& b = meshData.vertices[meshData.indices[t * 3 + 1]].pos;
+				const glm::vec3& c = meshData.vertices[meshData.indices[t * 3 + 2]].pos;
+				glm::vec3 n = glm::cross(b - a, c - a);
+				float triangleArea = glm::length(n);
+				centroid += (a + b + c) * (triangleArea / 3.0f);
+				normal += n;
+				area += triangleArea;
+			}
+			if (area > 0.0f) {
+				centroid /= area;
+			}
+		};
+
+		glm::vec3 meshCentroid, meshNormal;
+		accumulate(0, numTriangles, meshCentroid, meshNormal);
+
+		//Clusters that face away from the middle of the mesh are likely to occlude the rest, so they draw first
+		struct Cluster {
+			unsigned int begin;
+			unsigned int end;
+			float sortKey;
+		};
+		std::vector<Cluster> clusters;
+		clusters.reserve(clusterStarts.size());
+		for (size_t i = 0; i < clusterStarts.size(); i++) {
+			Cluster cluster;
+			cluster.begin = clusterStarts[i];
+			cluster.end = i + 1 < clusterStarts.size() ? clusterStarts[i + 1] : (unsigned int)numTriangles;
+			glm::vec3 centroid, normal;
+			accumulate(cluster.begin, cluster.end, centroid, normal);
+			float normalLength = glm::length(normal);
+			cluster.sortKey = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal / normalLength) : 0.0f;
+			clusters.push_back(cluster);
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+			return a.sortKey > b.sortKey;
+		});
+
+		std::vector<unsigned int> indices;
+		indices.reserve(meshData.indices.size());
+		for (const Cluster& cluster : clusters) {
+			indices.insert(indices.end(), meshData.indices.begin() + cluster.begin * 3, meshData.indices.begin() + cluster.end * 3);
+		}
+
+		//Cluster seams cost a few cache misses, don't trade away too much of the vertex cache pass
+		float acmrBefore = getACMR(meshData, cacheSize);
+		float acmrAfter = getACMR(indices, meshData.vertices.size(), cacheSize);
+		if (acmrAfter <= acmrBefore * threshold) {
+			meshData.indices.swap(indices);
+		}
+	}
+
+	void optimizeVertexFetch(MeshData& meshData)
+	{
+		std::vector<unsigned int> remap(meshData.vertices.size(), UINT_MAX);
+		std::vector<Vertex> vertices;
+		vertices.reserve(meshData.vertices.size());
+		for (unsigned int& index : meshData.indices) {
+			if (remap[index] == UINT_MAX) {
+				remap[index] = (unsigned int)vertices.size();
+				vertices.push_back(meshData.vertices[index]);
+			}
+			index = remap[index];
+		}
+		meshData.vertices.swap(vertices);
+	}
+
+	MeshOptimizeStats optimizeMesh(MeshData& meshData, int cacheSize)
+	{
+		MeshOptimizeStats stats;
+		for (unsigned int index : meshData.indices) {
+			if (index >= meshData.vertices.size()) {
+				printf("ERROR in optimizeMesh: Index %u out of range (%zu vertices)\n", index, meshData.vertices.size());
+				return stats;
+			}
+		}
+		if (meshData.indices.size() % 3 != 0) {
+			printf("ERROR in optimizeMesh: Index count (%zu) is not a triangle list\n", meshData.indices.size());
+			return stats;
+		}
+
+		stats.acmrBefore = getACMR(meshData, cacheSize);
+		std::vector<unsigned int> originalIndices = meshData.indices;
+		std::vector<unsigned int> clusterStarts;
+		optimizeVertexCache(meshData, cacheSize, &clusterStarts);
+		optimizeOverdraw(meshData, clusterStarts, cacheSize);
+		//Small meshes that were already in a good order can come out slightly worse
+		if (getACMR(meshData, cacheSize) > stats.acmrBefore) {
+			meshData.indices.swap(originalIndices);
+		}
+		optimizeVertexFetch(meshData);
+		stats.acmrAfter = getACMR(meshData, cacheSize);
+		return stats;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "mesh.h"
+
+namespace ew {
+	struct MeshOptimizeStats {
+		float acmrBefore = 0.0f;
+		float acmrAfter = 0.0f;
+	};
+
+	/// <summary>
+	/// Average cache miss ratio: vertex shader invocations per triangle with a FIFO post-transform cache.
+	/// 3 means no reuse at all, a regular grid approaches 0.5.
+	/// </summary>
+	float getACMR(const std::vector<unsigned int>& indices, size_t numVertices, int cacheSize = 16);
+	float getACMR(const MeshData& meshData, int cacheSize = 16);
+
+	/// <summary>
+	/// Reorders triangles for post-transform cache reuse (Tipsify, Sander et al. 2007). Linear time.
+	/// </summary>
+	/// <param name="clusterStarts">Optional, receives the first triangle of each run between the optimizer's restarts</param>
+	void optimizeVertexCache(std::vector<unsigned int>& indices, size_t numVertices, int cacheSize = 16, std::vector<unsigned int>* clusterStarts = nullptr);
+	void optimizeVertexCache(MeshData& meshData, int cacheSize = 16, std::vector<unsigned int>* clusterStarts = nullptr);
+
+	/// <summary>
+	/// View-independent overdraw reduction. Reorders the clusters left by optimizeVertexCache so outward facing
+	/// ones draw first, and keeps the new order only if the ACMR stays within threshold times the current one.
+	/// </summary>
+	void optimizeOverdraw(MeshData& meshData, const std::vector<unsigned int>& clusterStarts, int cacheSize = 16, float threshold = 1.05f);
+
+	/// <summary>
+	/// Reorders vertices by first use in the index buffer so vertex fetch walks memory linearly. Drops unused vertices.
+	/// </summary>
+	void optimizeVertexFetch(MeshData& meshData);
+
+	/// <summary>
+	/// Runs the vertex cache, overdraw and vertex fetch passes in order. Call it before uploading.
+	/// </summary>
+	MeshOptimizeStats optimizeMesh(MeshData& meshData, int cacheSize = 16);
+}
@@ -0,0 +1,224 @@
+#include "meshProcessing.h"
+#include "mappedFile.h"
+#include "../dh/parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace ew {
+	static size_t getTableSize(size_t count) {
+		size_t size = 16;
+		while (size < count * 2) {
+			size *= 2;
+		}
+		return size;
+	}
+
+	//Open addressing table over bit-identical keys, group[i] is the first i with the same key
+	template<typename Key>
+	static void groupKeys(const std::vector<Key>& keys, std::vector<unsigned int>& group) {
+		const unsigned int empty = ~0u;
+		std::vector<unsigned int> table(getTableSize(keys.size()), empty);
+		size_t mask = table.size() - 1;
+		group.resize(keys.size());
+		for (size_t i = 0; i < keys.size(); i++) {
+			size_t slot = hashBytes(&keys[i], sizeof(Key)) & mask;
+			while (table[slot] != empty && std::memcmp(&keys[table[slot]], &keys[i], sizeof(Key)) != 0) {
+				slot = (slot + 1) & mask;
+			}
+			if (table[slot] == empty) {
+				table[slot] = (unsigned int)i;
+			}
+			group[i] = table[slot];
+		}
+	}
+
+	size_t weldVertices(MeshData& meshData)
+	{
+		std::vector<unsigned int> group;
+		groupKeys(meshData.vertices, group);
+
+		//Keep the first vertex of each group, in their original order
+		std::vector<unsigned int> remap(meshData.vertices.size());
+		std::vector<Vertex> vertices;
+		vertices.reserve(meshData.vertices.size());
+		for (size_t i = 0; i < meshData.vertices.size(); i++) {
+			if (group[i] == i) {
+				remap[i] = (unsigned int)vertices.size();
+				vertices.push_back(meshData.vertices[i]);
+			}
+			else {
+				remap[i] = remap[group[i]];
+			}
+		}
+		for (unsigned int& index : meshData.indices) {
+			index = remap[index];
+		}
+		meshData.vertices.swap(vertices);
+		return meshData.vertices.size();
+	}
+
+	//Interior angle of a triangle at corner a
+	static float cornerAngle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+		glm::vec3 ab = b - a;
+		glm::vec3 ac = c - a;
+		float lengths = glm::length(ab) * glm::length(ac);
+		if (lengths <= 0.0f) {
+			return 0.0f;
+		}
+		return std::acos(std::min(std::max(glm::dot(ab, ac) / lengths, -1.0f), 1.0f));
+	}
+
+	void generateNormals(MeshData& meshData)
+	{
+		if (meshData.vertices.empty()) {
+			return;
+		}
+
+		//Positions are snapped to a fine grid first, seams generated with different trig calls rarely match bit for bit
+		glm::vec3 boundsMin = meshData.vertices[0].pos;
+		glm::vec3 boundsMax = boundsMin;
+		for (const Vertex& v : meshData.vertices) {
+			boundsMin = glm::min(boundsMin, v.pos);
+			boundsMax = glm::max(boundsMax, v.pos);
+		}
+		glm::vec3 size = boundsMax - boundsMin;
+		float cellSize = std::max(std::max(size.x, size.y), std::max(size.z, 1e-6f)) * 1e-5f;
+		std::vector<glm::ivec3> cells(meshData.vertices.size());
+		for (size_t i = 0; i < cells.size(); i++) {
+			cells[i] = glm::ivec3(glm::round((meshData.vertices[i].pos - boundsMin) / cellSize));
+		}
+		std::vector<unsigned int> group;
+		groupKeys(cells, group);
+
+		std::vector<glm::vec3> normals(meshData.vertices.size(), glm::vec3(0.0f));
+		for (size_t i = 0; i + 2 < meshData.indices.size(); i += 3) {
+			const unsigned int* triangle = &meshData.indices[i];
+			glm::vec3 p[3];
+			for (int j = 0; j < 3; j++) {
+				p[j] = meshData.vertices[triangle[j]].pos;
+			}
+			glm::vec3 faceNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+			float length = glm::length(faceNormal);
+			if (length <= 0.0f) {
+				continue;
+			}
+			faceNormal /= length;
+			for (int j = 0; j < 3; j++) {
+				normals[group[triangle[j]]] += faceNormal * cornerAngle(p[j], p[(j + 1) % 3], p[(j + 2) % 3]);
+			}
+		}
+		for (size_t i = 0; i < meshData.vertices.size(); i++) {
+			glm::vec3 normal = normals[group[i]];
+			float length = glm::length(normal);
+			meshData.vertices[i].normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+	}
+
+	void generateTangents(MeshData& meshData)
+	{
+		//Triangles whose uvs are mirrored have the opposite handedness. Like MikkTSpace, a vertex shared by
+		//both kinds is split so each copy only averages tangents of one handedness.
+		const unsigned int unassigned = ~0u;
+		size_t numVertices = meshData.vertices.size();
+		std::vector<float> vertexSigns(numVertices, 0.0f);
+		std::vector<unsigned int> mirrored(numVertices, unassigned);
+		std::vector<glm::vec3> tangents(numVertices, glm::vec3(0.0f));
+		std::vector<glm::vec3> bitangents(numVertices, glm::vec3(0.0f));
+		for (size_t i = 0; i + 2 < meshData.indices.size(); i += 3) {
+			unsigned int* triangle = &meshData.indices[i];
+			glm::vec3 pos[3];
+			glm::vec2 uv[3];
+			for (int j = 0; j < 3; j++) {
+				pos[j] = meshData.vertices[triangle[j]].pos;
+				uv[j] = meshData.vertices[triangle[j]].uv;
+			}
+			glm::vec3 edge1 = pos[1] - pos[0];
+			glm::vec3 edge2 = pos[2] - pos[0];
+			glm::vec2 duv1 = uv[1] - uv[0];
+			glm::vec2 duv2 = uv[2] - uv[0];
+			float determinant = duv1.x * duv2.y - duv2.x * duv1.y;
+			if (std::abs(determinant) <= 1e-12f) {
+				continue;
+			}
+			glm::vec3 tangent = (edge1 * duv2.y - edge2 * duv1.y) / determinant;
+			glm::vec3 bitangent = (edge2 * duv1.x - edge1 * duv2.x) / determinant;
+			float tangentLength = glm::length(tangent);
+			float bitangentLength = glm::length(bitangent);
+			if (tangentLength <= 0.0f || bitangentLength <= 0.0f) {
+				continue;
+			}
+			tangent /= tangentLength;
+			bitangent /= bitangentLength;
+
+			float sign = determinant < 0.0f ? -1.0f : 1.0f;
+			for (int j = 0; j < 3; j++) {
+				unsigned int index = triangle[j];
+				if (vertexSigns[index] == 0.0f) {
+					vertexSigns[index] = sign;
+				}
+				else if (vertexSigns[index] != sign) {
+					if (mirrored[index] == unassigned) {
+						Vertex copy = meshData.vertices[index];
+						mirrored[index] = (unsigned int)meshData.vertices.size();
+						meshData.vertices.push_back(copy);
+						vertexSigns.push_back(sign);
+						mirrored.push_back(unassigned);
+						tangents.push_back(glm::vec3(0.0f));
+						bitangents.push_back(glm::vec3(0.0f));
+					}
+					index = mirrored[index];
+					triangle[j] = index;
+				}
+				float weight = cornerAngle(pos[j], pos[(j + 1) % 3], pos[(j + 2) % 3]);
+				tangents[index] += tangent * weight;
+				bitangents[index] += bitangent * weight;
+			}
+		}
+
+		for (size_t i = 0; i < meshData.vertices.size(); i++) {
+			Vertex& vertex = meshData.vertices[i];
+			glm::vec3 tangent = tangents[i] - vertex.normal * glm::dot(vertex.normal, tangents[i]);
+			float length = glm::length(tangent);
+			if (length <= 1e-6f) {
+				//No usable uv gradient, any direction in the surface will do
+				glm::vec3 axis = std::abs(vertex.normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				tangent = axis - vertex.normal * glm::dot(vertex.normal, axis);
+				length = glm::length(tangent);
+			}
+			tangent = length > 0.0f ? tangent / length : glm::vec3(1.0f, 0.0f, 0.0f);
+			//The sign says which way the uv v axis runs relative to cross(normal, tangent)
+			float sign = glm::dot(glm::cross(vertex.normal, tangent), bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+			vertex.tangent = glm::vec4(tangent, sign);
+		}
+	}
+
+	MeshOptimizeStats processMesh(MeshData& meshData, const MeshProcessSettings& settings)
+	{
+		if (settings.weld) {
+			weldVertices(meshData);
+		}
+		if (settings.generateNormals) {
+			generateNormals(meshData);
+		}
+		if (settings.generateTangents) {
+			generateTangents(meshData);
+		}
+		if (settings.optimize) {
+			return optimizeMesh(meshData);
+		}
+		return MeshOptimizeStats();
+	}
+
+	std::vector<MeshOptimizeStats> processMeshes(std::vector<MeshData>& meshes, const std::vector<MeshProcessSettings>& settings)
+	{
+		//Each mesh is independent, bands of whole meshes go to each thread
+		std::vector<MeshOptimizeStats> stats(meshes.size());
+		dh::parallelFor(0, (int)meshes.size(), [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				stats[i] = processMesh(meshes[i], settings[i]);
+			}
+		});
+		return stats;
+	}
+}
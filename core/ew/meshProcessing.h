@@ -0,0 +1,36 @@
+#pragma once
+#include "mesh.h"
+#include "meshOptimizer.h"
+
+namespace ew {
+	struct MeshProcessSettings {
+		bool weld = true;               //Merge vertices whose attributes are bit-identical
+		bool generateNormals = false;   //Smooth normals shared by every vertex at a position
+		bool generateTangents = true;   //Needs uvs and normals
+		bool optimize = true;           //optimizeMesh once the vertices are final
+	};
+
+	/// <summary>
+	/// Merges identical vertices through a hash table and remaps the indices. Returns the new vertex count.
+	/// </summary>
+	size_t weldVertices(MeshData& meshData);
+
+	/// <summary>
+	/// Angle weighted normals, averaged over every vertex that shares a position so uv seams stay smooth.
+	/// </summary>
+	void generateNormals(MeshData& meshData);
+
+	/// <summary>
+	/// Per vertex tangents from the uv gradients, angle weighted and orthogonalized against the normal
+	/// the way MikkTSpace does, with the bitangent sign in w. Vertices shared by mirrored and unmirrored
+	/// triangles are split, so mirrored uv seams get the right handedness on both sides.
+	/// </summary>
+	void generateTangents(MeshData& meshData);
+
+	//Runs the enabled steps in order, the stats stay zero without optimize
+	MeshOptimizeStats processMesh(MeshData& meshData, const MeshProcessSettings& settings);
+	/// <summary>
+	/// Runs processMesh over several meshes on worker threads. settings[i] and the returned stats[i] belong to meshes[i].
+	/// </summary>
+	std::vector<MeshOptimizeStats> processMeshes(std::vector<MeshData>& meshes, const std::vector<MeshProcessSettings>& settings);
+}
@@ -0,0 +1,120 @@
+#include "meshlet.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace ew {
+	static Meshlet createMeshlet(const MeshData& meshData, unsigned int firstTriangle, unsigned int endTriangle) {
+		Meshlet meshlet;
+		meshlet.firstIndex = firstTriangle * 3;
+		meshlet.numIndices = (endTriangle - firstTriangle) * 3;
+
+		glm::vec3 boundsMin = meshData.vertices[meshData.indices[meshlet.firstIndex]].pos;
+		glm::vec3 boundsMax = boundsMin;
+		glm::vec3 normalSum(0.0f);
+		for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.numIndices; i += 3) {
+			const glm::vec3& a = meshData.vertices[meshData.indices[i]].pos;
+			const glm::vec3& b = meshData.vertices[meshData.indices[i + 1]].pos;
+			const glm::vec3& c = meshData.vertices[meshData.indices[i + 2]].pos;
+			boundsMin = glm::min(boundsMin, glm::min(a, glm::min(b, c)));
+			boundsMax = glm::max(boundsMax, glm::max(a, glm::max(b, c)));
+			normalSum += glm::cross(b - a, c - a);
+		}
+		meshlet.center = (boundsMin + boundsMax) * 0.5f;
+		for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.numIndices; i++) {
+			meshlet.radius = std::max(meshlet.radius, glm::length(meshData.vertices[meshData.indices[i]].pos - meshlet.center));
+		}
+
+		//The cone opens as wide as the triangle furthest from the average normal. Past 90 degrees some
+		//triangle always faces the viewer, so the cutoff stays at 1.
+		float axisLength = glm::length(normalSum);
+		if (axisLength <= 0.0f) {
+			return meshlet;
+		}
+		glm::vec3 axis = normalSum / axisLength;
+		float minDot = 1.0f;
+		for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.numIndices; i += 3) {
+			const glm::vec3& a = meshData.vertices[meshData.indices[i]].pos;
+			const glm::vec3& b = meshData.vertices[meshData.indices[i + 1]].pos;
+			const glm::vec3& c = meshData.vertices[meshData.indices[i + 2]].pos;
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			if (length > 0.0f) {
+				minDot = std::min(minDot, glm::dot(normal / length, axis));
+			}
+		}
+		if (minDot > 0.0f) {
+			meshlet.coneAxis = axis;
+			meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+		return meshlet;
+	}
+
+	std::vector<Meshlet> buildMeshlets(const MeshData& meshData, int maxVertices, int maxTriangles)
+	{
+		std::vector<Meshlet> meshlets;
+		unsigned int numTriangles = (unsigned int)(meshData.indices.size() / 3);
+		if (numTriangles == 0) {
+			return meshlets;
+		}
+
+		//Which meshlet last used each vertex, so shared vertices are only counted once
+		std::vector<unsigned int> lastMeshlet(meshData.vertices.size(), UINT_MAX);
+		unsigned int meshletId = 0;
+		unsigned int firstTriangle = 0;
+		int numVertices = 0;
+		for (unsigned int t = 0; t < numTriangles; t++) {
+			const unsigned int* triangle = &meshData.indices[t * 3];
+			int newVertices = 0;
+			for (int j = 0; j < 3; j++) {
+				bool repeated = (j > 0 && triangle[j] == triangle[0]) || (j > 1 && triangle[j] == triangle[1]);
+				if (lastMeshlet[triangle[j]] != meshletId && !repeated) {
+					newVertices++;
+				}
+			}
+			if (numVertices + newVertices > maxVertices || (int)(t - firstTriangle) >= maxTriangles) {
+				meshlets.push_back(createMeshlet(meshData, firstTriangle, t));
+				meshletId++;
+				firstTriangle = t;
+				numVertices = 0;
+			}
+			for (int j = 0; j < 3; j++) {
+				if (lastMeshlet[triangle[j]] != meshletId) {
+					lastMeshlet[triangle[j]] = meshletId;
+					numVertices++;
+				}
+			}
+		}
+		meshlets.push_back(createMeshlet(meshData, firstTriangle, numTriangles));
+		return meshlets;
+	}
+
+	int cullMeshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum, const glm::vec3& cameraPosition, bool backfaceCulling,
+		std::vector<int>& counts, std::vector<unsigned int>& firstIndices)
+	{
+		int numVisible = 0;
+		bool extendLast = false;
+		for (const Meshlet& meshlet : meshlets) {
+			bool visible = frustum.intersectsSphere(meshlet.center, meshlet.radius);
+			if (visible && backfaceCulling && meshlet.coneCutoff < 1.0f) {
+				glm::vec3 toCenter = meshlet.center - cameraPosition;
+				visible = glm::dot(toCenter, meshlet.coneAxis) < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+			}
+			if (!visible) {
+				extendLast = false;
+				continue;
+			}
+
+			numVisible++;
+			if (extendLast) {
+				counts.back() += meshlet.numIndices;
+			}
+			else {
+				counts.push_back(meshlet.numIndices);
+				firstIndices.push_back(meshlet.firstIndex);
+			}
+			extendLast = true;
+		}
+		return numVisible;
+	}
+}
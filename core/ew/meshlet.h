@@ -0,0 +1,33 @@
+#pragma once
+#include "mesh.h"
+#include "frustum.h"
+
+namespace ew {
+	/// <summary>
+	/// A run of triangles in a mesh's index buffer, small enough to be culled on its own.
+	/// </summary>
+	struct Meshlet {
+		unsigned int firstIndex = 0;
+		unsigned int numIndices = 0;
+		//Bounding sphere
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = 0.0f;
+		//Every triangle faces away from a viewer at p when dot(center - p, coneAxis) >= coneCutoff * |center - p| + radius.
+		//A cutoff of 1 never culls.
+		glm::vec3 coneAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+		float coneCutoff = 1.0f;
+	};
+
+	/// <summary>
+	/// Splits the index buffer into meshlets without reordering it, so run optimizeMesh first for tight clusters.
+	/// </summary>
+	std::vector<Meshlet> buildMeshlets(const MeshData& meshData, int maxVertices = 64, int maxTriangles = 124);
+
+	/// <summary>
+	/// Appends the meshlets that can be visible as draw ranges for Mesh::drawRanges, merging neighbouring survivors into one range.
+	/// Frustum and cameraPosition are in the mesh's space. Returns the number of meshlets kept.
+	/// </summary>
+	/// <param name="backfaceCulling">Cone test against cameraPosition, only valid for perspective views</param>
+	int cullMeshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum, const glm::vec3& cameraPosition, bool backfaceCulling,
+		std::vector<int>& counts, std::vector<unsigned int>& firstIndices);
+}
@@ -3,27 +3,130 @@
 */
 
 #include "model.h"
+#include "meshOptimizer.h"
+#include "meshCache.h"
+#include "meshProcessing.h"
+#include "culling.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
+#include <assimp/config.h>
 
 #include <assimp/scene.h>
 #include <glm/glm.hpp>
+#include <cstdio>
 
 namespace ew {
-	ew::Mesh processAiMesh(aiMesh* aiMesh);
+	ew::MeshData processAiMesh(aiMesh* aiMesh);
 
-	Model::Model(const std::string& filePath)
+	Model::Model(const std::string& filePath, bool positionStream)
 	{
+		load(filePath, positionStream, nullptr);
+	}
+
+	Model::Model(const std::string& filePath, GeometryPool& pool)
+	{
+		load(filePath, false, &pool);
+	}
+
+	void Model::load(const std::string& filePath, bool positionStream, GeometryPool* pool)
+	{
+		//Later runs upload straight from the mapped cache
+		MeshCache cache;
+		if (cache.open(filePath.c_str())) {
+			for (int i = 0; i < cache.getNumSubmeshes(); i++)
+			{
+				const MeshCacheSubmesh& submesh = cache.getSubmesh(i);
+				m_meshes.emplace_back();
+				const Vertex* vertices = cache.getVertices() + submesh.firstVertex;
+				const unsigned int* indices = cache.getIndices() + submesh.firstIndex;
+				if (pool) {
+					m_meshes.back().load(vertices, submesh.numVertices, indices, submesh.numIndices, *pool);
+				}
+				else {
+					m_meshes.back().load(vertices, submesh.numVertices, indices, submesh.numIndices, positionStream);
+				}
+				m_meshlets.emplace_back(cache.getMeshlets() + submesh.firstMeshlet, cache.getMeshlets() + submesh.firstMeshlet + submesh.numMeshlets);
+				m_numMeshlets += (int)submesh.numMeshlets;
+				addBounds(glm::vec3(submesh.boundsMin[0], submesh.boundsMin[1], submesh.boundsMin[2]),
+					glm::vec3(submesh.boundsMax[0], submesh.boundsMax[1], submesh.boundsMax[2]));
+			}
+			return;
+		}
+
+		//Points and lines are dropped, everything after import assumes a plain triangle list
 		Assimp::Importer importer;
-		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate);
+		importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_SortByPType);
+		if (aiScene == nullptr) {
+			printf("Failed to load model %s: %s\n", filePath.c_str(), importer.GetErrorString());
+			return;
+		}
+		std::vector<ew::MeshData> meshes(aiScene->mNumMeshes);
+		std::vector<MeshProcessSettings> settings(aiScene->mNumMeshes);
 		for (size_t i = 0; i < aiScene->mNumMeshes; i++)
 		{
 			aiMesh* aiMesh = aiScene->mMeshes[i];
-			m_meshes.push_back(processAiMesh(aiMesh));
+			meshes[i] = processAiMesh(aiMesh);
+			//Only fill in what the file doesn't have
+			settings[i].generateNormals = !aiMesh->HasNormals();
+			settings[i].generateTangents = !aiMesh->HasTangentsAndBitangents();
+		}
+
+		std::vector<MeshOptimizeStats> stats = processMeshes(meshes, settings);
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			printf("Processed mesh %s: %u -> %zu vertices, ACMR %.3f -> %.3f\n", aiScene->mMeshes[i]->mName.C_str(),
+				aiScene->mMeshes[i]->mNumVertices, meshes[i].vertices.size(), stats[i].acmrBefore, stats[i].acmrAfter);
+			m_meshlets.push_back(buildMeshlets(meshes[i]));
+			m_numMeshlets += (int)m_meshlets.back().size();
+		}
+		MeshCache::write(filePath.c_str(), meshes, m_meshlets);
+
+		for (const ew::MeshData& meshData : meshes)
+		{
+			if (pool) {
+				m_meshes.push_back(ew::Mesh(meshData, *pool));
+			}
+			else {
+				m_meshes.push_back(ew::Mesh(meshData, positionStream));
+			}
+			for (const Vertex& v : meshData.vertices)
+			{
+				addBounds(v.pos, v.pos);
+			}
 		}
 	}
 
-	void Model::draw()
+	void Model::addBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		if (m_boundsMin.x > m_boundsMax.x) {
+			m_boundsMin = boundsMin;
+			m_boundsMax = boundsMax;
+			return;
+		}
+		m_boundsMin = glm::min(m_boundsMin, boundsMin);
+		m_boundsMax = glm::max(m_boundsMax, boundsMax);
+	}
+
+	glm::vec4 Model::getBoundingSphere()const
+	{
+		if (m_boundsMin.x > m_boundsMax.x) {
+			return glm::vec4(0.0f);
+		}
+		return ew::getBoundingSphere(m_boundsMin, m_boundsMax);
+	}
+
+	size_t Model::getBufferBytes()const
+	{
+		size_t bytes = 0;
+		for (const ew::Mesh& mesh : m_meshes)
+		{
+			bytes += mesh.getBufferBytes();
+		}
+		return bytes;
+	}
+
+	void Model::draw()const
 	{
 		for (size_t i = 0; i < m_meshes.size(); i++)
 		{
@@ -31,16 +134,49 @@ namespace ew {
 		}
 	}
 
+	void Model::drawDepth()const
+	{
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].drawDepth();
+		}
+	}
+
+	void Model::drawInstanced(int instanceCount, bool depthOnly)const
+	{
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].drawInstanced(instanceCount, depthOnly);
+		}
+	}
+
+	int Model::drawCulled(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& cameraPosition)const
+	{
+		//Cull in model space, the planes come out of the full clip matrix and the camera is brought back through the model matrix
+		Frustum frustum(viewProjection * model);
+		glm::vec3 localCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+		int numDrawn = 0;
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_drawCounts.clear();
+			m_drawFirstIndices.clear();
+			numDrawn += cullMeshlets(m_meshlets[i], frustum, localCamera, true, m_drawCounts, m_drawFirstIndices);
+			m_meshes[i].drawRanges(m_drawCounts.data(), m_drawFirstIndices.data(), (int)m_drawCounts.size());
+		}
+		return numDrawn;
+	}
+
 	glm::vec3 convertAIVec3(const aiVector3D& v) {
 		return glm::vec3(v.x, v.y, v.z);
 	}
 
 	//Utility functions local to this file
-	ew::Mesh processAiMesh(aiMesh* aiMesh) {
+	ew::MeshData processAiMesh(aiMesh* aiMesh) {
 		ew::MeshData meshData;
+		meshData.vertices.resize(aiMesh->mNumVertices);
 		for (size_t i = 0; i < aiMesh->mNumVertices; i++)
 		{
-			ew::Vertex vertex;
+			ew::Vertex& vertex = meshData.vertices[i];
 			vertex.pos = convertAIVec3(aiMesh->mVertices[i]);
 			if (aiMesh->HasNormals()) {
 				vertex.normal = convertAIVec3(aiMesh->mNormals[i]);
@@ -49,19 +185,26 @@ namespace ew {
 				vertex.uv = glm::vec2(convertAIVec3(aiMesh->mTextureCoords[0][i]));
 			}
 			if (aiMesh->HasTangentsAndBitangents()) {
-				vertex.tangent = (convertAIVec3(aiMesh->mTangents[i]));
+				//The file's bitangent only contributes its handedness
+				glm::vec3 tangent = convertAIVec3(aiMesh->mTangents[i]);
+				float sign = glm::dot(glm::cross(vertex.normal, tangent), convertAIVec3(aiMesh->mBitangents[i])) < 0.0f ? -1.0f : 1.0f;
+				vertex.tangent = glm::vec4(tangent, sign);
 			}
-			meshData.vertices.push_back(vertex);
 		}
 		//Convert faces to indices
+		meshData.indices.reserve((size_t)aiMesh->mNumFaces * 3);
 		for (size_t i = 0; i < aiMesh->mNumFaces; i++)
 		{
-			for (size_t j = 0; j < aiMesh->mFaces[i].mNumIndices; j++)
+			//Degenerate faces can still come out of triangulation as points or lines
+			if (aiMesh->mFaces[i].mNumIndices != 3) {
+				continue;
+			}
+			for (size_t j = 0; j < 3; j++)
 			{
 				meshData.indices.push_back(aiMesh->mFaces[i].mIndices[j]);
 			}
 		}
-		return ew::Mesh(meshData);
+		return meshData;
 	}
 
 }
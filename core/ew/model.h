@@ -5,14 +5,50 @@
 #pragma once
 #include "mesh.h"
 #include "shader.h"
+#include "meshlet.h"
+#include "geometryPool.h"
 #include <vector>
 
 namespace ew {
 	class Model {
 	public:
-		Model(const std::string& filePath);
-		void draw();
+		/// <summary>
+		/// Imports through assimp the first time, then from the .ewmesh cache written next to the file.
+		/// positionStream keeps a position-only copy of each mesh for drawDepth().
+		/// </summary>
+		Model(const std::string& filePath, bool positionStream = false);
+		/// <summary>
+		/// Same, with every mesh suballocated from pool. The pool must outlive the model.
+		/// </summary>
+		Model(const std::string& filePath, GeometryPool& pool);
+		void draw()const;
+		void drawDepth()const;
+		//Every mesh once with instanceCount instances, see Mesh::drawInstanced
+		void drawInstanced(int instanceCount, bool depthOnly = false)const;
+		/// <summary>
+		/// Draws only the meshlets that pass the frustum and backface cone tests. Returns how many were drawn.
+		/// </summary>
+		/// <param name="model">The model matrix the shader is using</param>
+		int drawCulled(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& cameraPosition)const;
+		inline int getNumMeshlets()const { return m_numMeshlets; }
+		inline const std::vector<ew::Mesh>& getMeshes()const { return m_meshes; }
+		//GPU memory held by the vertex and index buffers of every mesh
+		size_t getBufferBytes()const;
+		//Model space bounds over every mesh, min is greater than max for an empty model
+		inline const glm::vec3& getBoundsMin()const { return m_boundsMin; }
+		inline const glm::vec3& getBoundsMax()const { return m_boundsMax; }
+		//Model space sphere through the corners of the bounds, xyz center and w radius
+		glm::vec4 getBoundingSphere()const;
 	private:
+		void load(const std::string& filePath, bool positionStream, GeometryPool* pool);
+		void addBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
 		std::vector<ew::Mesh> m_meshes;
+		std::vector<std::vector<Meshlet>> m_meshlets;
+		int m_numMeshlets = 0;
+		glm::vec3 m_boundsMin = glm::vec3(1.0f);
+		glm::vec3 m_boundsMax = glm::vec3(-1.0f);
+		mutable std::vector<int> m_drawCounts;
+		mutable std::vector<unsigned int> m_drawFirstIndices;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "renderQueue.h"
+#include "glState.h"
+#include "external/glad.h"
+#include <algorithm>
+#include <string>
+#include <cstring>
+
+namespace ew {
+	static_assert(sizeof(DrawElementsIndirectCommand) == 20, "Indirect commands must be tightly packed");
+	static_assert(sizeof(DrawData) == 8, "DrawData must match the std430 layout in the shaders");
+
+	bool RenderQueue::isSupported()
+	{
+		if (GLAD_GL_VERSION_4_6) {
+			return true;
+		}
+		int numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		for (int i = 0; i < numExtensions; i++) {
+			if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_shader_draw_parameters") == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void RenderQueue::clear()
+	{
+		m_packets.clear();
+		m_pools.clear();
+		m_dirty = true;
+	}
+
+	bool RenderQueue::add(const Mesh& mesh, unsigned int transformIndex, unsigned int materialIndex, unsigned int sortDepth)
+	{
+		if (!mesh.isPooled()) {
+			return false;
+		}
+		size_t poolRank = 0;
+		while (poolRank < m_pools.size() && m_pools[poolRank] != mesh.getPool()) {
+			poolRank++;
+		}
+		if (poolRank == m_pools.size()) {
+			m_pools.push_back(mesh.getPool());
+		}
+		DrawPacket packet;
+		packet.pool = mesh.getPool();
+		packet.firstIndex = mesh.getFirstIndex();
+		packet.numIndices = (unsigned int)mesh.getNumIndices();
+		packet.firstVertex = mesh.getFirstVertex();
+		packet.data.transformIndex = transformIndex;
+		packet.data.materialIndex = materialIndex;
+		packet.bounds = mesh.getBoundingSphere();
+		//Pool (8 bits), first index (32), depth (24). Past 256 pools ranks collide, which only splits batches
+		packet.key = ((uint64_t)std::min(poolRank, (size_t)0xFF) << 56) | ((uint64_t)packet.firstIndex << 24) | (sortDepth & 0xFFFFFF);
+		m_packets.push_back(packet);
+		m_dirty = true;
+		return true;
+	}
+
+	bool RenderQueue::add(const Model& model, unsigned int transformIndex, unsigned int materialIndex, unsigned int sortDepth)
+	{
+		bool added = true;
+		for (const Mesh& mesh : model.getMeshes()) {
+			added &= add(mesh, transformIndex, materialIndex, sortDepth);
+		}
+		return added;
+	}
+
+	void RenderQueue::upload()
+	{
+		//One multi-draw per pool, so its draws have to be next to each other, and instances of a mesh too
+		m_order.clear();
+		for (size_t i = 0; i < m_packets.size(); i++) {
+			m_order.push_back({ m_packets[i].key, (unsigned int)i });
+		}
+		radixSort(m_order, m_scratch);
+
+		m_commands.clear();
+		m_drawData.clear();
+		m_batches.clear();
+		m_cullData.clear();
+		m_drawData.reserve(m_packets.size());
+		m_cullData.reserve(m_packets.size());
+		for (const SortItem& item : m_order) {
+			const DrawPacket& packet = m_packets[item.index];
+			if (m_batches.empty() || m_batches.back().pool != packet.pool) {
+				m_batches.push_back({ packet.pool, (int)m_commands.size(), 0 });
+			}
+			DrawElementsIndirectCommand* last = m_commands.size() > (size_t)m_batches.back().firstCommand ? &m_commands.back() : nullptr;
+			if (last && last->firstIndex == packet.firstIndex && last->count == packet.numIndices && last->baseVertex == (int)packet.firstVertex) {
+				//Instances of one command read consecutive draw data
+				last->instanceCount++;
+			}
+			else {
+				DrawElementsIndirectCommand command;
+				command.count = packet.numIndices;
+				command.instanceCount = 1;
+				command.firstIndex = packet.firstIndex;
+				command.baseVertex = (int)packet.firstVertex;
+				command.baseInstance = (unsigned int)m_drawData.size();
+				m_commands.push_back(command);
+				m_batches.back().numCommands++;
+			}
+			m_cullData.push_back({ packet.bounds, (unsigned int)m_commands.size() - 1, m_commands.back().baseInstance,
+				packet.data.transformIndex, packet.data.materialIndex });
+			m_drawData.push_back(packet.data);
+		}
+
+		if (!m_commandBuffer) {
+			m_commandBuffer = Buffer::create();
+			m_drawDataBuffer = Buffer::create();
+		}
+		//Orphaned every upload so a queue rebuilt each frame doesn't wait on the previous frame's draws
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer.get());
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * m_commands.size(), m_commands.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer.get());
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawData) * m_drawData.size(), m_drawData.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_dirty = false;
+		m_cullDataDirty = true;
+		m_culled = false;
+	}
+
+	void RenderQueue::uploadCullData()
+	{
+		static_assert(sizeof(CullData) == 32, "CullData must match the std430 layout in the cull shader");
+		if (!m_cullDataBuffer) {
+			m_cullDataBuffer = Buffer::create();
+			m_emptyCommandBuffer = Buffer::create();
+			m_culledCommandBuffer = Buffer::create();
+			m_culledDrawDataBuffer = Buffer::create();
+		}
+		std::vector<DrawElementsIndirectCommand> emptyCommands = m_commands;
+		for (DrawElementsIndirectCommand& command : emptyCommands) {
+			command.instanceCount = 0;
+		}
+		size_t commandsSize = sizeof(DrawElementsIndirectCommand) * m_commands.size();
+		//Buffer::create() only reserves names, binding is what makes them buffers the named calls below can use
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_cullDataBuffer.get());
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(CullData) * m_cullData.size(), m_cullData.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_emptyCommandBuffer.get());
+		glBufferData(GL_SHADER_STORAGE_BUFFER, commandsSize, emptyCommands.data(), GL_DYNAMIC_DRAW);
+		//Only ever written by the cull shader
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_culledCommandBuffer.get());
+		glBufferData(GL_SHADER_STORAGE_BUFFER, commandsSize, nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_culledDrawDataBuffer.get());
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawData) * m_drawData.size(), nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_cullDataDirty = false;
+	}
+
+	void RenderQueue::cull(const Shader& cullShader, const GpuCullSettings& settings)
+	{
+		if (m_dirty) {
+			upload();
+		}
+		if (m_commands.empty()) {
+			return;
+		}
+		if (m_cullDataDirty) {
+			uploadCullData();
+		}
+		//Survivors count themselves into their command's instances, so every cull starts from none
+		glCopyNamedBufferSubData(m_emptyCommandBuffer.get(), m_culledCommandBuffer.get(), 0, 0, sizeof(DrawElementsIndirectCommand) * m_commands.size());
+
+		cullShader.use();
+		for (int i = 0; i < 6; i++) {
+			cullShader.setVec4("_Planes[" + std::to_string(i) + "]", settings.frustum.planes[i]);
+		}
+		cullShader.setInt("_NumDraws", (int)m_cullData.size());
+		bool useHiZ = settings.hiZ && settings.hiZ->isBuilt();
+		cullShader.setInt("_UseHiZ", useHiZ);
+		if (useHiZ) {
+			GLState::get().bindTexture(0, settings.hiZ->getTexture());
+			cullShader.setInt("_HiZ", 0);
+			cullShader.setMat4("_HiZViewProjection", settings.hiZViewProjection);
+		}
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_culledDrawDataBuffer.get());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_DATA_BINDING, m_cullDataBuffer.get());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_COMMAND_BINDING, m_culledCommandBuffer.get());
+		cullShader.dispatch(((unsigned int)m_cullData.size() + CULL_LOCAL_SIZE - 1) / CULL_LOCAL_SIZE);
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+		m_culled = true;
+	}
+
+	void RenderQueue::submit(bool depthOnly)
+	{
+		if (m_dirty) {
+			upload();
+		}
+		if (m_commands.empty()) {
+			return;
+		}
+		//Culled draws keep their commands' layout, only instance counts and the draw data behind them change
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_culled ? m_culledDrawDataBuffer.get() : m_drawDataBuffer.get());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_culled ? m_culledCommandBuffer.get() : m_commandBuffer.get());
+		for (const Batch& batch : m_batches) {
+			batch.pool->bind(depthOnly);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+				(const void*)(batch.firstCommand * sizeof(DrawElementsIndirectCommand)), batch.numCommands, 0);
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "mesh.h"
+#include "model.h"
+#include "geometryPool.h"
+#include "glResource.h"
+#include "sortKey.h"
+#include "shader.h"
+#include "frustum.h"
+#include "hiZPyramid.h"
+#include <vector>
+
+namespace ew {
+	//Matches the command layout glMultiDrawElementsIndirect reads
+	struct DrawElementsIndirectCommand {
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int firstIndex;
+		int baseVertex;
+		unsigned int baseInstance;
+	};
+
+	/// <summary>
+	/// What one queued draw tells the shader, matching this std430 block:
+	/// struct DrawData { uint transformIndex; uint materialIndex; };
+	/// layout(std430, binding = 1) readonly buffer Draws { DrawData _Draws[]; };
+	/// Read it with _Draws[gl_BaseInstanceARB + gl_InstanceID] and GL_ARB_shader_draw_parameters,
+	/// which GL 4.5 drivers such as llvmpipe have, or gl_BaseInstance in GLSL 4.60.
+	/// </summary>
+	struct DrawData {
+		unsigned int transformIndex = 0;
+		unsigned int materialIndex = 0;
+	};
+
+	/// <summary>
+	/// What RenderQueue::cull tests draws against. Without a pyramid only the frustum culls.
+	/// </summary>
+	struct GpuCullSettings {
+		Frustum frustum;
+		const HiZPyramid* hiZ = nullptr;
+		//The view projection the pyramid's depth was drawn with, usually the previous frame's
+		glm::mat4 hiZViewProjection = glm::mat4(1.0f);
+	};
+
+	/// <summary>
+	/// Collects draws of pooled meshes over a frame and submits each pool's share with a single glMultiDrawElementsIndirect.
+	/// Draws are radix sorted by pool, then mesh, then sortDepth, so every draw of a mesh becomes one command with more instances.
+	/// Transforms and materials are indices into buffers the caller binds, e.g. an InstanceBuffer at binding 0.
+	/// cull() can leave visibility to a compute shader, which writes the draws that survive straight into the indirect buffers.
+	/// </summary>
+	class RenderQueue {
+	public:
+		static const int DRAW_DATA_BINDING = 1;
+		static const int CULL_DATA_BINDING = 2;
+		static const int CULL_COMMAND_BINDING = 3;
+		static const int CULL_LOCAL_SIZE = 64;
+
+		RenderQueue() {};
+		/// <summary>
+		/// Whether the current context can run shaders that read the draw data, see DrawData.
+		/// </summary>
+		static bool isSupported();
+		void clear();
+		/// <summary>
+		/// Returns false for meshes that aren't in a GeometryPool, those still need Mesh::draw.
+		/// Instances of a mesh are drawn in ascending sortDepth, e.g. quantizeDepth() of the view distance for front to back.
+		/// </summary>
+		bool add(const Mesh& mesh, unsigned int transformIndex, unsigned int materialIndex = 0, unsigned int sortDepth = 0);
+		bool add(const Model& model, unsigned int transformIndex, unsigned int materialIndex = 0, unsigned int sortDepth = 0);
+		/// <summary>
+		/// Uploads anything queued since the last submit, then draws the whole queue.
+		/// Submitting again, e.g. for a depth pass, reuses the uploaded buffers.
+		/// </summary>
+		void submit(bool depthOnly = false);
+		/// <summary>
+		/// Tests every queued draw's bounding sphere on the GPU, submit() then draws only the survivors until the queue changes.
+		/// The transforms the draws index must be bound at binding 0. Nothing is read back, so the CPU never waits on it.
+		/// cullShader reads draws and writes commands in the layout of assets/cullDraws.comp.
+		/// </summary>
+		void cull(const Shader& cullShader, const GpuCullSettings& settings);
+		inline int getNumDraws()const { return (int)m_packets.size(); }
+		//Commands in the last upload, at most one per draw
+		inline int getNumCommands()const { return (int)m_commands.size(); }
+	private:
+		struct DrawPacket {
+			GeometryPool* pool;
+			unsigned int firstIndex;
+			unsigned int numIndices;
+			unsigned int firstVertex;
+			DrawData data;
+			glm::vec4 bounds;
+			uint64_t key;
+		};
+		//One per draw in command order, matching the std430 struct cull shaders read
+		struct CullData {
+			glm::vec4 bounds; //Model space sphere
+			unsigned int commandIndex;
+			unsigned int baseInstance;
+			unsigned int transformIndex;
+			unsigned int materialIndex;
+		};
+		//Consecutive commands that draw from the same pool
+		struct Batch {
+			GeometryPool* pool;
+			int firstCommand;
+			int numCommands;
+		};
+		void upload();
+		void uploadCullData();
+
+		std::vector<DrawPacket> m_packets;
+		std::vector<GeometryPool*> m_pools; //Seen since the last clear, their order is the top of the sort key
+		std::vector<SortItem> m_order;
+		std::vector<SortItem> m_scratch;
+		std::vector<DrawElementsIndirectCommand> m_commands;
+		std::vector<DrawData> m_drawData;
+		std::vector<Batch> m_batches;
+		Buffer m_commandBuffer;
+		Buffer m_drawDataBuffer;
+		bool m_dirty = false;
+		//Cull inputs, and the commands and draw data the cull shader writes
+		std::vector<CullData> m_cullData;
+		Buffer m_cullDataBuffer;
+		Buffer m_emptyCommandBuffer; //m_commands with no instances, copied over the culled commands before every cull
+		Buffer m_culledCommandBuffer;
+		Buffer m_culledDrawDataBuffer;
+		bool m_cullDataDirty = false;
+		bool m_culled = false;
+	};
+}
@@ -3,8 +3,10 @@
 */
 
 #include "shader.h"
+#include "glState.h"
 #include <fstream>
 #include <sstream>
+#include <utility>
 #include "external/glad.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -32,7 +34,7 @@ namespace ew {
 	/// <param name="shaderType">Expects GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, etc.</param>
 	/// <param name="sourceCode">GLSL source code for the shader stage</param>
 	/// <returns></returns>
-	static unsigned int createShader(GLenum shaderType, const char* sourceCode) {
+	unsigned int createShader(unsigned int shaderType, const char* sourceCode) {
 		//Create a new vertex shader object
 		unsigned int shader = glCreateShader(shaderType);
 		//Supply the shader object with source code
@@ -59,7 +61,20 @@ namespace ew {
 	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
 		unsigned int vertexShader = createShader(GL_VERTEX_SHADER, vertexShaderSource);
 		unsigned int fragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+		unsigned int shaderProgram = linkShaderProgram(vertexShader, fragmentShader);
+		//The linked program now contains our compiled code, so we can delete these intermediate objects
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return shaderProgram;
+	}
 
+	/// <summary>
+	/// Links already compiled stages into a program. The stages are left alone so they can be linked into other programs.
+	/// </summary>
+	/// <param name="vertexShader">Compiled vertex shader object</param>
+	/// <param name="fragmentShader">Compiled fragment shader object</param>
+	/// <returns></returns>
+	unsigned int linkShaderProgram(unsigned int vertexShader, unsigned int fragmentShader) {
 		unsigned int shaderProgram = glCreateProgram();
 		//Attach each stage
 		glAttachShader(shaderProgram, vertexShader);
@@ -73,9 +88,30 @@ namespace ew {
 			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
 			printf("Failed to link shader program: %s", infoLog);
 		}
-		//The linked program now contains our compiled code, so we can delete these intermediate objects
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
+		//Detached stages are freed as soon as their owner deletes them
+		glDetachShader(shaderProgram, vertexShader);
+		glDetachShader(shaderProgram, fragmentShader);
+		return shaderProgram;
+	}
+	/// <summary>
+	/// Compiles and links a program with only a compute stage
+	/// </summary>
+	/// <param name="computeShaderSource">GLSL source code for the compute shader</param>
+	/// <returns></returns>
+	unsigned int createComputeProgram(const char* computeShaderSource) {
+		unsigned int computeShader = createShader(GL_COMPUTE_SHADER, computeShaderSource);
+		unsigned int shaderProgram = glCreateProgram();
+		glAttachShader(shaderProgram, computeShader);
+		glLinkProgram(shaderProgram);
+		int success;
+		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+			printf("Failed to link compute program: %s", infoLog);
+		}
+		glDetachShader(shaderProgram, computeShader);
+		glDeleteShader(computeShader);
 		return shaderProgram;
 	}
 	/// <summary>
@@ -87,23 +123,41 @@ namespace ew {
 	{
 		std::string vertexShaderSource = ew::loadShaderSourceFromFile(vertexShader.c_str());
 		std::string fragmentShaderSource = ew::loadShaderSourceFromFile(fragmentShader.c_str());
-		m_id = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+		m_program.reset(ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str()));
+	}
+	/// <summary>
+	/// Creates a shader instance with a compute stage
+	/// </summary>
+	/// <param name="computeShader">File path to compute shader</param>
+	Shader::Shader(const std::string& computeShader)
+	{
+		std::string computeShaderSource = ew::loadShaderSourceFromFile(computeShader.c_str());
+		m_program.reset(ew::createComputeProgram(computeShaderSource.c_str()));
+	}
+	Shader::Shader(Program&& program)
+		: m_program(std::move(program))
+	{
 	}
 	void Shader::use()const
 	{
-		glUseProgram(m_id);
+		GLState::get().useProgram(m_program.get());
+	}
+	void Shader::dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ) const
+	{
+		use();
+		glDispatchCompute(groupsX, groupsY, groupsZ);
 	}
 	void Shader::setInt(const std::string& name, int v) const
 	{
-		glUniform1i(glGetUniformLocation(m_id, name.c_str()), v);
+		glUniform1i(glGetUniformLocation(m_program.get(), name.c_str()), v);
 	}
 	void Shader::setFloat(const std::string& name, float v) const
 	{
-		glUniform1f(glGetUniformLocation(m_id, name.c_str()), v);
+		glUniform1f(glGetUniformLocation(m_program.get(), name.c_str()), v);
 	}
 	void Shader::setVec2(const std::string& name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(m_id, name.c_str()), x, y);
+		glUniform2f(glGetUniformLocation(m_program.get(), name.c_str()), x, y);
 	}
 	void Shader::setVec2(const std::string& name, const glm::vec2& v) const
 	{
@@ -111,7 +165,7 @@ namespace ew {
 	}
 	void Shader::setVec3(const std::string& name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(m_id, name.c_str()), x, y, z);
+		glUniform3f(glGetUniformLocation(m_program.get(), name.c_str()), x, y, z);
 	}
 	void Shader::setVec3(const std::string& name, const glm::vec3& v) const
 	{
@@ -119,7 +173,7 @@ namespace ew {
 	}
 	void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(m_id, name.c_str()), x, y, z, w);
+		glUniform4f(glGetUniformLocation(m_program.get(), name.c_str()), x, y, z, w);
 	}
 	void Shader::setVec4(const std::string& name, const glm::vec4& v) const
 	{
@@ -127,7 +181,7 @@ namespace ew {
 	}
 	void Shader::setMat4(const std::string& name, const glm::mat4& m) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(m));
+		glUniformMatrix4fv(glGetUniformLocation(m_program.get(), name.c_str()), 1, GL_FALSE, glm::value_ptr(m));
 	}
 }
 
@@ -5,14 +5,28 @@
 #pragma once
 #include <string>
 #include <glm/glm.hpp>
+#include "glResource.h"
 
 namespace ew {
 	std::string loadShaderSourceFromFile(const std::string& filePath);
 	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+	unsigned int createShader(unsigned int shaderType, const char* sourceCode);
+	unsigned int linkShaderProgram(unsigned int vertexShader, unsigned int fragmentShader);
+	unsigned int createComputeProgram(const char* computeShaderSource);
 	class Shader {
 	public:
 		Shader(const std::string& vertexShader, const std::string& fragmentShader);
+		/// <summary>
+		/// Compute shader from a single file, run it with dispatch()
+		/// </summary>
+		explicit Shader(const std::string& computeShader);
+		/// <summary>
+		/// Takes ownership of an already linked program
+		/// </summary>
+		explicit Shader(Program&& program);
 		void use()const;
+		//Uses the program and runs a compute shader over the given number of work groups
+		void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1)const;
 		void setInt(const std::string& name, int v) const;
 		void setFloat(const std::string& name, float v) const;
 		void setVec2(const std::string& name, float x, float y) const;
@@ -22,7 +36,8 @@ namespace ew {
 		void setVec4(const std::string& name, float x, float y, float z, float w) const;
 		void setVec4(const std::string& name, const glm::vec4& v) const;
 		void setMat4(const std::string& name, const glm::mat4& m) const;
+		inline unsigned int getProgram()const { return m_program.get(); }
 	private:
-		unsigned int m_id; //Shader program handle
+		Program m_program; //Shader program handle, shaders are move-only
 	};
 }
\ No newline at end of file
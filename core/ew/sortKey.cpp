@@ -0,0 +1,60 @@
+#include "sortKey.h"
+#include <algorithm>
+
+namespace ew {
+	uint64_t makeSortKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depth)
+	{
+		return ((uint64_t)(pass & 0xF) << 60)
+			| ((uint64_t)(shader & 0x3FF) << 50)
+			| ((uint64_t)(material & 0x3FFF) << 36)
+			| ((uint64_t)(mesh & 0xFFF) << 24)
+			| (uint64_t)(depth & 0xFFFFFF);
+	}
+
+	unsigned int quantizeDepth(float depth, float nearPlane, float farPlane)
+	{
+		float t = farPlane > nearPlane ? (depth - nearPlane) / (farPlane - nearPlane) : 0.0f;
+		t = std::min(std::max(t, 0.0f), 1.0f);
+		return (unsigned int)(t * (float)0xFFFFFF);
+	}
+
+	void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+	{
+		size_t n = items.size();
+		if (n < 2) {
+			return;
+		}
+		scratch.resize(n);
+
+		//Histograms for all eight bytes in one pass over the keys
+		size_t counts[8][256] = {};
+		for (const SortItem& item : items) {
+			for (int b = 0; b < 8; b++) {
+				counts[b][(item.key >> (b * 8)) & 0xFF]++;
+			}
+		}
+
+		SortItem* src = items.data();
+		SortItem* dst = scratch.data();
+		for (int b = 0; b < 8; b++) {
+			size_t* count = counts[b];
+			//Every key has the same byte here, the order wouldn't change
+			if (count[(src[0].key >> (b * 8)) & 0xFF] == n) {
+				continue;
+			}
+			size_t offset = 0;
+			for (int i = 0; i < 256; i++) {
+				size_t c = count[i];
+				count[i] = offset;
+				offset += c;
+			}
+			for (size_t i = 0; i < n; i++) {
+				dst[count[(src[i].key >> (b * 8)) & 0xFF]++] = src[i];
+			}
+			std::swap(src, dst);
+		}
+		if (src != items.data()) {
+			items.swap(scratch);
+		}
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace ew {
+	/// <summary>
+	/// Packs draw state into one integer so sorting by it groups draws that share state.
+	/// From the top: pass (4 bits), shader (10), material (14), mesh (12), depth (24). Values wider than their field are masked.
+	/// </summary>
+	uint64_t makeSortKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depth);
+	/// <summary>
+	/// Maps a view space distance linearly onto the 24 depth bits, nearer is smaller so ascending keys draw front to back.
+	/// </summary>
+	unsigned int quantizeDepth(float depth, float nearPlane, float farPlane);
+
+	struct SortItem {
+		uint64_t key;
+		unsigned int index; //What the key belongs to, e.g. a position in the caller's draw list
+	};
+
+	/// <summary>
+	/// Stable LSD radix sort by key, one byte per pass. Passes where every key has the same byte are skipped,
+	/// so keys that only differ in a few fields cost only a few passes. scratch is resized to match.
+	/// </summary>
+	void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+}
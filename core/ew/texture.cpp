@@ -3,6 +3,7 @@
 */
 
 #include "texture.h"
+#include "glState.h"
 #include "external/glad.h"
 #include "external/stb_image.h"
 
@@ -19,20 +20,19 @@ static int getTextureFormat(int numComponents) {
 	}
 }
 namespace ew {
-	unsigned int loadTexture(const char* filePath) {
+	Texture loadTexture(const char* filePath) {
 		return loadTexture(filePath, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, true);
 	}
-	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap) {
+	Texture loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap) {
 		int width, height, numComponents;
 		unsigned char* data = stbi_load(filePath, &width, &height, &numComponents, 0);
 		if (data == NULL) {
 			printf("Failed to load image %s", filePath);
 			stbi_image_free(data);
-			return 0;
+			return Texture();
 		}
-		unsigned int texture;
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
+		Texture texture = Texture::create();
+		glBindTexture(GL_TEXTURE_2D, texture.get());
 		int format = getTextureFormat(numComponents);
 		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
@@ -49,6 +49,8 @@ namespace ew {
 		}
 
 		glBindTexture(GL_TEXTURE_2D, 0);
+		//That was whichever unit is active, which the state cache can't tell
+		GLState::get().invalidate();
 		stbi_image_free(data);
 		return texture;
 	}
@@ -3,8 +3,10 @@
 */
 
 #pragma once
+#include "glResource.h"
 
 namespace ew {
-	unsigned int loadTexture(const char* filePath);
-	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap);
+	//Returns an empty handle if the image can't be loaded
+	Texture loadTexture(const char* filePath);
+	Texture loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap);
 }
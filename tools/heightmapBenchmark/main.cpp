@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "dh/heightMap.h"
+#include "dh/parallel.h"
+
+// Times CPU heightmap mesh generation on synthetic maps, with the scalar and the AVX2 normals where the CPU has it.
+// Usage: heightmapBenchmark [maxSize], maxSize defaults to 2048. Each doubling needs about 4x the memory,
+// 8192 takes about 4.5 GB.
+int main(int argc, char** argv) {
+    int maxSize = argc > 1 ? atoi(argv[1]) : 2048;
+    if (maxSize < 512 || maxSize > 8192) {
+        printf("maxSize must be between 512 and 8192\n");
+        return 1;
+    }
+
+    printf("==== Heightmap mesh benchmark (%d threads, AVX2 %s) ====\n", dh::getNumWorkerThreads(),
+        dh::isHeightmapAvx2Supported() ? "supported" : "not supported");
+    for (int size = 512; size <= maxSize; size *= 2) {
+        std::vector<float> heights((size_t)size * size);
+        for (int z = 0; z < size; z++) {
+            for (int x = 0; x < size; x++) {
+                heights[(size_t)z * size + x] = 0.5f + 0.25f * sinf(x * 0.01f) * cosf(z * 0.013f);
+            }
+        }
+
+        for (int simd = 0; simd < (dh::isHeightmapAvx2Supported() ? 2 : 1); simd++) {
+            dh::setHeightmapAvx2Enabled(simd == 1);
+            // Best of three, the first run also pays for faulting in the output
+            double best = 1e30;
+            size_t numVertices = 0;
+            for (int run = 0; run < 3; run++) {
+                auto startTime = std::chrono::steady_clock::now();
+                ew::MeshData meshData = dh::createHeightmapMeshData(heights, size, size);
+                best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+                numVertices = meshData.vertices.size();
+            }
+            printf("%5d^2 %-6s: %8.1f ms, %6.1f Mverts/s\n", size, simd ? "AVX2" : "scalar", best, numVertices / (best * 1000.0));
+        }
+    }
+    dh::setHeightmapAvx2Enabled(true);
+    return 0;
+}